@@ -12,7 +12,8 @@ namespace bios {
 
 class Bios : public memory::Addressable<memory::BIOS_SIZE> {
  public:
-  explicit Bios(fs::path const& path);
+  explicit Bios(fs::path const& path, byte* storage);
+  const std::array<byte, memory::BIOS_SIZE>& data() const { return *m_data; }
 };
 
 }  // namespace bios
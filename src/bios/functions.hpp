@@ -26,18 +26,18 @@ inline bool dont_log(cpu::Cpu& cpu) {
 }
 
 inline bool dbg_output_char(cpu::Cpu& cpu) {
-  cpu.m_tty_out_log += static_cast<char>(cpu.gpr(4));
+  cpu.m_bios_log.on_tty_output(cpu.cycles(), static_cast<char>(cpu.gpr(4)));
   return false;
 }
 
 inline bool dbg_output_string(cpu::Cpu& cpu) {
   for (u8 i = 0; i < 80; ++i) {
-    char c = cpu.bus().read8(cpu.gpr(4) + i);
+    char c = cpu.bus().read<u8>(cpu.gpr(4) + i);
     if (c == 0) {
-      cpu.m_tty_out_log += '\n';
+      cpu.m_bios_log.on_tty_output(cpu.cycles(), '\n');
       return false;
     }
-    cpu.m_tty_out_log += c;
+    cpu.m_bios_log.on_tty_output(cpu.cycles(), c);
   }
   return false;
 }
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <bus/bus.hpp>
+#include <util/types.hpp>
+
+#include <array>
+#include <optional>
+
+// High-level emulation of BIOS functions.
+// Some of the A0 table routines that games call a lot (to copy/clear memory and handle strings) are run
+// natively instead of executing the BIOS code an instruction at a time. Opt-in, since only their
+// documented behavior is replicated.
+
+namespace bios::hle {
+
+// Arguments of a call (a0-a3)
+using Args = std::array<u32, 4>;
+
+struct Result {
+  u32 ret;     // Value returned in v0
+  u32 cycles;  // Roughly how long the BIOS version takes
+};
+
+// Rough cost of the BIOS versions: a call, and a loop iteration of a few instructions per byte
+constexpr u32 CALL_CYCLES = 20;
+constexpr u32 BYTE_CYCLES = 8;
+
+constexpr u32 cycles_for(u32 bytes) {
+  return CALL_CYCLES + bytes * BYTE_CYCLES;
+}
+
+// A(2Ah) memcpy(dst, src, len)
+inline Result memcpy(bus::Bus& bus, const Args& args) {
+  const auto [dst, src, len, _] = args;
+
+  // Refuses to copy to null or a negative length, but returns dst regardless
+  if (dst == 0 || static_cast<s32>(len) <= 0)
+    return { dst, CALL_CYCLES };
+
+  for (u32 n = 0; n < len; ++n)
+    bus.write<u8>(dst + n, bus.read<u8>(src + n));
+  return { dst, cycles_for(len) };
+}
+
+// A(2Bh) memset(dst, fillbyte, len)
+inline Result memset(bus::Bus& bus, const Args& args) {
+  const auto [dst, fillbyte, len, _] = args;
+
+  if (dst == 0 || static_cast<s32>(len) <= 0)
+    return { 0, CALL_CYCLES };
+
+  for (u32 n = 0; n < len; ++n)
+    bus.write<u8>(dst + n, static_cast<u8>(fillbyte));
+  return { dst, cycles_for(len) };
+}
+
+// A(28h) bzero(dst, len)
+inline Result bzero(bus::Bus& bus, const Args& args) {
+  return memset(bus, { args[0], 0, args[1], 0 });
+}
+
+// A(1Bh) strlen(src)
+inline Result strlen(bus::Bus& bus, const Args& args) {
+  const auto src = args[0];
+
+  if (src == 0)
+    return { 0, CALL_CYCLES };
+
+  u32 len = 0;
+  while (bus.read<u8>(src + len) != 0)
+    ++len;
+  return { len, cycles_for(len) };
+}
+
+// A(17h) strcmp(str1, str2)
+inline Result strcmp(bus::Bus& bus, const Args& args) {
+  const auto [str1, str2, _1, _2] = args;
+
+  // Null strings are smaller than any other
+  if (str1 == 0 || str2 == 0)
+    return { static_cast<u32>((str1 != 0) - (str2 != 0)), CALL_CYCLES };
+
+  for (u32 n = 0;; ++n) {
+    const u8 c1 = bus.read<u8>(str1 + n);
+    const u8 c2 = bus.read<u8>(str2 + n);
+
+    if (c1 != c2 || c1 == 0)
+      return { static_cast<u32>(c1 - c2), cycles_for(n + 1) };
+  }
+}
+
+// A(19h) strcpy(dst, src)
+inline Result strcpy(bus::Bus& bus, const Args& args) {
+  const auto [dst, src, _1, _2] = args;
+
+  if (dst == 0 || src == 0)
+    return { 0, CALL_CYCLES };
+
+  u32 n = 0;
+  u8 c;
+  do {
+    c = bus.read<u8>(src + n);
+    bus.write<u8>(dst + n, c);
+    ++n;
+  } while (c != 0);
+  return { dst, cycles_for(n) };
+}
+
+// Runs function func of the table at vector (0xA0, 0xB0 or 0xC0) natively, if it's implemented
+inline std::optional<Result> call(bus::Bus& bus, u32 vector, u8 func, const Args& args) {
+  if (vector != 0xA0)
+    return {};
+
+  switch (func) {
+    case 0x17: return strcmp(bus, args);
+    case 0x19: return strcpy(bus, args);
+    case 0x1B: return strlen(bus, args);
+    case 0x28: return bzero(bus, args);
+    case 0x2A: return memcpy(bus, args);
+    case 0x2B: return memset(bus, args);
+    default: return {};
+  }
+}
+
+}  // namespace bios::hle
@@ -5,6 +5,7 @@
 #include <io/cdrom_drive.hpp>
 #include <io/joypad.hpp>
 #include <io/timers.hpp>
+#include <memory/arena.hpp>
 #include <memory/dma.hpp>
 #include <memory/expansion.hpp>
 #include <memory/map.hpp>
@@ -12,241 +13,451 @@
 #include <spu/spu.hpp>
 #include <util/log.hpp>
 
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <utility>
+
 namespace bus {
 
-// TODO: refactor IO reads/writes
+// Every device on the bus, along with the access widths it supports. The dispatch tables of each access
+// width and direction are generated from this list at compile time, a device is only ever called with
+// the widths it declares.
+// Handlers get the address relative to the start of the region.
+struct Regions {
+  // Access widths, as flags (the size of the access in bytes)
+  static constexpr u8 W8 = 1;
+  static constexpr u8 W16 = 2;
+  static constexpr u8 W32 = 4;
 
-u32 Bus::read32(u32 addr) const {
-  addr = memory::mask_region(addr) & 0x1FFFFFFC;
+  struct Ram {
+    static constexpr memory::Range range = memory::map::RAM_MIRRORS;
+    static constexpr u8 read_widths = W8 | W16 | W32;
+    static constexpr u8 write_widths = W8 | W16 | W32;
 
-  address addr_rebased;
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      return bus.m_ram.read<T>(offset & (memory::RAM_SIZE - 1));
+    }
+    template <typename T>
+    static void write(Bus& bus, address offset, T val) {
+      bus.m_ram.write<T>(offset & (memory::RAM_SIZE - 1), val);
+    }
+  };
 
-  if (memory::map::RAM.contains(addr, addr_rebased))
-    return m_ram.read<u32>(addr_rebased);
-  if (memory::map::SCRATCHPAD.contains(addr, addr_rebased))
-    return m_scratchpad.read<u32>(addr_rebased);
-  if (memory::map::IRQ_CONTROL.contains(addr, addr_rebased)) {
-    auto val = m_interrupts.read<u32>(addr_rebased);
-    LOG_TRACE("{} 32-bit read of 0x{:08X}", addr_rebased == 0 ? "I_STAT" : "I_MASK", val);
-    return val;
-  }
-  if (memory::map::BIOS.contains(addr, addr_rebased))
-    return m_bios.read<u32>(addr_rebased);
-  if (memory::map::DMA.contains(addr, addr_rebased))
-    return m_dma.read<u32>(addr_rebased);
-  if (memory::map::GPU.contains(addr, addr_rebased))
-    return m_gpu.read_reg(addr_rebased);
-  if (memory::map::TIMERS.contains(addr, addr_rebased))
-    return static_cast<u32>(m_timers.read_reg(addr_rebased));
-  if (memory::map::EXPANSION_1.contains(addr, addr_rebased))
-    return m_expansion.read<u32>(addr_rebased);
-
-  LOG_ERROR("Unknown 32-bit read at 0x{:08X}", addr);
-  assert(0);
-  return 0;
-}
+  struct Scratchpad {
+    static constexpr memory::Range range = memory::map::SCRATCHPAD;
+    static constexpr u8 read_widths = W8 | W16 | W32;
+    static constexpr u8 write_widths = W8 | W16 | W32;
 
-u16 Bus::read16(u32 addr) const {
-  addr = memory::mask_region(addr) & 0x1FFFFFFE;
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      return bus.m_scratchpad.read<T>(offset);
+    }
+    template <typename T>
+    static void write(Bus& bus, address offset, T val) {
+      bus.m_scratchpad.write<T>(offset, val);
+    }
+  };
 
-  address addr_rebased;
+  struct Bios {
+    static constexpr memory::Range range = memory::map::BIOS;
+    static constexpr u8 read_widths = W8 | W16 | W32;
+    static constexpr u8 write_widths = 0;
 
-  if (memory::map::RAM.contains(addr, addr_rebased))
-    return m_ram.read<u16>(addr_rebased);
-  if (memory::map::SCRATCHPAD.contains(addr, addr_rebased))
-    return m_scratchpad.read<u16>(addr_rebased);
-  if (memory::map::SPU.contains(addr, addr_rebased)) {
-    // NOTE: TRACE level because it's used a lot in BIOS init.
-    LOG_TRACE("Stubbed 16-bit read of SPU register at 0x{:08X}", addr);
-    return m_spu.read<u16>(addr_rebased);
-  }
-  if (memory::map::IRQ_CONTROL.contains(addr, addr_rebased)) {
-    auto val = m_interrupts.read<u16>(addr_rebased);
-    LOG_TRACE("{} 16-bit read of 0x{:04X}", addr_rebased == 0 ? "I_STAT" : "I_MASK", val);
-    return val;
-  }
-  if (memory::map::JOYPAD.contains(addr, addr_rebased)) {
-    auto val = (u16)m_joypad.read8(addr_rebased) | (u16)m_joypad.read8(addr_rebased + 1) << 8;
-    LOG_TRACE_JOYPAD("{} 16-bit read of 0x{:04X}", io::Joypad::addr_to_reg_name(addr_rebased), val);
-    return val;
-  }
-  if (memory::map::EXPANSION_1.contains(addr, addr_rebased))
-    return m_expansion.read<u16>(addr_rebased);
-  if (memory::map::SIO.contains(addr, addr_rebased)) {
-    LOG_WARN("Unhandled 16-bit read of SIO register at 0x{:04X}", addr);
-    return 0;
-  }
-  if (memory::map::BIOS.contains(addr, addr_rebased))
-    return m_bios.read<u16>(addr_rebased);
-  if (memory::map::TIMERS.contains(addr, addr_rebased))
-    return m_timers.read_reg(addr_rebased);
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      return bus.m_bios.read<T>(offset);
+    }
+  };
 
-  LOG_ERROR("Unknown 16-bit read at 0x{:08X}", addr);
-  assert(0);
-  return 0;
-}
+  struct Expansion1 {
+    static constexpr memory::Range range = memory::map::EXPANSION_1;
+    static constexpr u8 read_widths = W8 | W16 | W32;
+    static constexpr u8 write_widths = 0;
 
-u8 Bus::read8(u32 addr) const {
-  addr = memory::mask_region(addr);
-
-  address addr_rebased;
-
-  if (memory::map::RAM.contains(addr, addr_rebased))
-    return m_ram.read<u8>(addr_rebased);
-  if (memory::map::SCRATCHPAD.contains(addr, addr_rebased))
-    return m_scratchpad.read<u8>(addr_rebased);
-  if (memory::map::BIOS.contains(addr, addr_rebased))
-    return m_bios.read<u8>(addr_rebased);
-  if (memory::map::JOYPAD.contains(addr, addr_rebased)) {
-    auto val = m_joypad.read8(addr_rebased);
-    LOG_TRACE_JOYPAD("{} 8-bit read of 0x{:02X}", io::Joypad::addr_to_reg_name(addr_rebased), val);
-    return val;
-  }
-  if (memory::map::EXPANSION_1.contains(addr, addr_rebased))
-    return m_expansion.read<u8>(addr_rebased);
-  if (memory::map::EXPANSION_2.contains(addr, addr_rebased)) {
-    LOG_WARN("Unhandled 8-bit read of EXPANSION_2 register at 0x{:08X}", addr);
-    return 0;
-  }
-  if (memory::map::CDROM.contains(addr, addr_rebased))
-    return m_cdrom.read_reg(addr_rebased);
-  if (memory::map::DMA.contains(addr, addr_rebased))
-    return m_dma.read<u8>(addr_rebased);
-  if (memory::map::SIO.contains(addr, addr_rebased)) {
-    LOG_WARN("Unhandled 8-bit read of SIO register at 0x{:08X}", addr);
-    return 0;
-  }
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      return bus.m_expansion.read<T>(offset);
+    }
+  };
 
-  LOG_ERROR("Unknown 8-bit read at 0x{:08X} ", addr);
-  assert(0);
-  return 0;
-}
+  struct Expansion2 {
+    static constexpr memory::Range range = memory::map::EXPANSION_2;
+    static constexpr u8 read_widths = W8;
+    static constexpr u8 write_widths = W8;
 
-void Bus::write32(u32 addr, u32 val) {
-  addr = memory::mask_region(addr) & 0x1FFFFFFC;
+    template <typename T>
+    static T read(const Bus&, address offset) {
+      LOG_WARN("Unhandled 8-bit read of EXPANSION_2 register at 0x{:08X}", range.start() + offset);
+      return 0;
+    }
+    template <typename T>
+    static void write(Bus&, address offset, T val) {
+      LOG_WARN("Unhandled 8-bit write to EXPANSION_2 register: 0x{:02X} at 0x{:08X}", val,
+               range.start() + offset);
+    }
+  };
 
-  address addr_rebased;
+  struct MemControl1 {
+    static constexpr memory::Range range = memory::map::MEM_CONTROL1;
+    static constexpr u8 read_widths = 0;
+    static constexpr u8 write_widths = W32;
 
-  if (memory::map::RAM.contains(addr, addr_rebased))
-    return m_ram.write<u32>(addr_rebased, val);
-  if (memory::map::SCRATCHPAD.contains(addr, addr_rebased))
-    return m_scratchpad.write<u32>(addr_rebased, val);
-  if (memory::map::SPU.contains(addr, addr_rebased)) {
-    LOG_WARN("Stubbed 32-bit write to SPU register: 0x{:08X} at 0x{:08X}", val, addr);
-    return m_spu.write<u32>(addr_rebased, val);
-  }
-  if (memory::map::IRQ_CONTROL.contains(addr, addr_rebased)) {
-    LOG_TRACE("{} 32-bit write of 0x{:08X}", addr_rebased == 0 ? "I_STAT" : "I_MASK", val);
-    return m_interrupts.write<u32>(addr_rebased, val);
-  }
-  if (memory::map::MEM_CONTROL1.contains(addr, addr_rebased)) {
-    switch (addr_rebased) {
-      case 0x0:
-        if (val != 0x1F000000)
-          LOG_CRITICAL("Unhandled EXPANSION_1 base address: 0x{:08X}", val);
-        return;
-      case 0x4:
-        if (val != 0x1F802000)
-          LOG_CRITICAL("Unhandled EXPANSION_2 base address: 0x{:08X}", val);
-        return;
-      case 0x8:   // Expansion 1 Delay/Size
-      case 0xC:   // Expansion 3 Delay/Size
-      case 0x10:  // BIOS ROM Delay/Size
-      case 0x14:  // SPU_DELAY Delay/Size
-      case 0x18:  // CDROM_DELAY Delay/Size
-      case 0x1C:  // Expansion 2 Delay/Size
-      case 0x20:  // COM_DELAY
-        if (val != 0)
-          LOG_DEBUG("Unhandled non-0 32-bit write to MEM_CONTROL1: 0x{:08X} at 0x{:08X}", val, addr);
-        return;
-      default:
-        LOG_DEBUG("Unhandled 32-bit write to MEM_CONTROL1: 0x{:08X} at 0x{:08X}", val, addr);
-        return;
+    template <typename T>
+    static void write(Bus& bus, address offset, T val) {
+      switch (offset) {
+        case 0x0:
+          if (val != 0x1F000000)
+            LOG_CRITICAL("Unhandled EXPANSION_1 base address: 0x{:08X}", val);
+          return;
+        case 0x4:
+          if (val != 0x1F802000)
+            LOG_CRITICAL("Unhandled EXPANSION_2 base address: 0x{:08X}", val);
+          return;
+        case 0x8:   // Expansion 1 Delay/Size
+        case 0xC:   // Expansion 3 Delay/Size
+        case 0x10:  // BIOS ROM Delay/Size
+        case 0x14:  // SPU_DELAY Delay/Size
+        case 0x18:  // CDROM_DELAY Delay/Size
+        case 0x1C:  // Expansion 2 Delay/Size
+          return bus.m_timings.set_delay(static_cast<DelayRegion>((offset - 0x8) / 4), val);
+        case 0x20:  // COM_DELAY
+          return bus.m_timings.set_common_delay(val);
+        default:
+          LOG_DEBUG("Unhandled 32-bit write to MEM_CONTROL1: 0x{:08X} at 0x{:08X}", val,
+                    range.start() + offset);
+          return;
+      }
     }
-  }
-  if (memory::map::MEM_CONTROL2.contains(addr, addr_rebased)) {
-    return;  // RAM_SIZE, ignore
-  }
-  if (memory::map::MEM_CONTROL3.contains(addr, addr_rebased)) {
-    return;  // Cache Control, ignore
-  }
-  if (memory::map::DMA.contains(addr, addr_rebased))
-    return m_dma.write<u32>(addr_rebased, val);
-  if (memory::map::GPU.contains(addr, addr_rebased))
-    return m_gpu.write_reg(addr_rebased, val);
-  if (memory::map::TIMERS.contains(addr, addr_rebased)) {
-    m_timers.write_reg(addr_rebased, static_cast<u16>(val));
-    return;
-  }
+  };
 
-  LOG_ERROR("Unknown 32-bit write of 0x{:08X} at 0x{:08X} ", val, addr);
-  assert(0);
-}
+  struct MemControl2 {
+    static constexpr memory::Range range = memory::map::MEM_CONTROL2;
+    static constexpr u8 read_widths = 0;
+    static constexpr u8 write_widths = W32;
+
+    template <typename T>
+    static void write(Bus&, address, T) {}  // RAM_SIZE, ignore
+  };
 
-void Bus::write16(u32 addr, u16 val) {
-  addr = memory::mask_region(addr) & 0x1FFFFFFE;
+  struct MemControl3 {
+    static constexpr memory::Range range = memory::map::MEM_CONTROL3;
+    static constexpr u8 read_widths = 0;
+    static constexpr u8 write_widths = W32;
 
-  address addr_rebased;
+    template <typename T>
+    static void write(Bus&, address, T) {}  // Cache Control, ignore
+  };
+
+  struct Joypad {
+    static constexpr memory::Range range = memory::map::JOYPAD;
+    static constexpr u8 read_widths = W8 | W16;
+    static constexpr u8 write_widths = W8 | W16;
+
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      if constexpr (sizeof(T) == 1) {
+        const auto val = bus.m_joypad.read8(offset);
+        LOG_TRACE_JOYPAD("{} 8-bit read of 0x{:02X}", io::Joypad::addr_to_reg_name(offset), val);
+        return val;
+      } else {
+        const auto val = (u16)bus.m_joypad.read8(offset) | (u16)bus.m_joypad.read8(offset + 1) << 8;
+        LOG_TRACE_JOYPAD("{} 16-bit read of 0x{:04X}", io::Joypad::addr_to_reg_name(offset), val);
+        return val;
+      }
+    }
+    template <typename T>
+    static void write(Bus& bus, address offset, T val) {
+      if constexpr (sizeof(T) == 1) {
+        LOG_TRACE_JOYPAD("8-bit write of {:02X} to {}", val, io::Joypad::addr_to_reg_name(offset));
+        bus.m_joypad.write8(offset, val);
+      } else {
+        LOG_TRACE_JOYPAD("16-bit write of {:04X} to {}", val, io::Joypad::addr_to_reg_name(offset));
+        bus.m_joypad.write8(offset, val & 0xFF);
+        bus.m_joypad.write8(offset + 1, (val >> 8) & 0xFF);
+      }
+    }
+  };
+
+  struct Sio {
+    static constexpr memory::Range range = memory::map::SIO;
+    static constexpr u8 read_widths = W8 | W16;
+    static constexpr u8 write_widths = W16;
+
+    template <typename T>
+    static T read(const Bus&, address offset) {
+      LOG_WARN("Unhandled {}-bit read of SIO register at 0x{:08X}", sizeof(T) * 8,
+               range.start() + offset);
+      return 0;
+    }
+    template <typename T>
+    static void write(Bus&, address offset, T val) {
+      LOG_WARN("Unhandled 16-bit write to SIO register: 0x{:04X} at 0x{:08X}", val,
+               range.start() + offset);
+    }
+  };
+
+  struct IrqControl {
+    static constexpr memory::Range range = memory::map::IRQ_CONTROL;
+    static constexpr u8 read_widths = W16 | W32;
+    static constexpr u8 write_widths = W16 | W32;
+
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      const auto val = bus.m_interrupts.read<T>(offset);
+      LOG_TRACE("{} {}-bit read of 0x{:08X}", offset == 0 ? "I_STAT" : "I_MASK", sizeof(T) * 8, val);
+      return val;
+    }
+    template <typename T>
+    static void write(Bus& bus, address offset, T val) {
+      LOG_TRACE("{} {}-bit write of 0x{:08X}", offset == 0 ? "I_STAT" : "I_MASK", sizeof(T) * 8, val);
+      bus.m_interrupts.write<T>(offset, val);
+    }
+  };
 
-  if (memory::map::RAM.contains(addr, addr_rebased))
-    return m_ram.write<u16>(addr_rebased, val);
-  if (memory::map::SCRATCHPAD.contains(addr, addr_rebased))
-    return m_scratchpad.write<u16>(addr_rebased, val);
-  if (memory::map::TIMERS.contains(addr, addr_rebased)) {
-    m_timers.write_reg(addr_rebased, val);
-    return;
+  struct Dma {
+    static constexpr memory::Range range = memory::map::DMA;
+    static constexpr u8 read_widths = W8 | W32;
+    static constexpr u8 write_widths = W8 | W32;
+
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      return bus.m_dma.read<T>(offset);
+    }
+    template <typename T>
+    static void write(Bus& bus, address offset, T val) {
+      bus.m_dma.write<T>(offset, val);
+    }
+  };
+
+  struct Timers {
+    static constexpr memory::Range range = memory::map::TIMERS;
+    static constexpr u8 read_widths = W16 | W32;
+    static constexpr u8 write_widths = W16 | W32;
+
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      return static_cast<T>(bus.m_timers.read_reg(offset));
+    }
+    template <typename T>
+    static void write(Bus& bus, address offset, T val) {
+      bus.m_timers.write_reg(offset, static_cast<u16>(val));
+    }
+  };
+
+  struct Cdrom {
+    static constexpr memory::Range range = memory::map::CDROM;
+    static constexpr u8 read_widths = W8;
+    static constexpr u8 write_widths = W8;
+
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      return bus.m_cdrom.read_reg(offset);
+    }
+    template <typename T>
+    static void write(Bus& bus, address offset, T val) {
+      bus.m_cdrom.write_reg(offset, val);
+    }
+  };
+
+  struct Gpu {
+    static constexpr memory::Range range = memory::map::GPU;
+    static constexpr u8 read_widths = W32;
+    static constexpr u8 write_widths = W32;
+
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      return bus.m_gpu.read_reg(offset);
+    }
+    template <typename T>
+    static void write(Bus& bus, address offset, T val) {
+      bus.m_gpu.write_reg(offset, val);
+    }
+  };
+
+  struct Spu {
+    static constexpr memory::Range range = memory::map::SPU;
+    static constexpr u8 read_widths = W16;
+    static constexpr u8 write_widths = W16 | W32;
+
+    template <typename T>
+    static T read(const Bus& bus, address offset) {
+      // NOTE: TRACE level because it's used a lot in BIOS init.
+      LOG_TRACE("Stubbed 16-bit read of SPU register at 0x{:08X}", range.start() + offset);
+      return bus.m_spu.read<T>(offset);
+    }
+    template <typename T>
+    static void write(Bus& bus, address offset, T val) {
+      const auto addr = range.start() + offset;
+      if constexpr (sizeof(T) == 2)  // NOTE: TRACE level because it's used a lot in BIOS init.
+        LOG_TRACE("Stubbed 16-bit write to SPU register: 0x{:04X} at 0x{:08X}", val, addr);
+      else
+        LOG_WARN("Stubbed 32-bit write to SPU register: 0x{:08X} at 0x{:08X}", val, addr);
+      bus.m_spu.write<T>(offset, val);
+    }
+  };
+
+  using List = std::tuple<Ram,
+                          Scratchpad,
+                          Bios,
+                          Expansion1,
+                          Expansion2,
+                          MemControl1,
+                          MemControl2,
+                          MemControl3,
+                          Joypad,
+                          Sio,
+                          IrqControl,
+                          Dma,
+                          Timers,
+                          Cdrom,
+                          Gpu,
+                          Spu>;
+  static constexpr size_t COUNT = std::tuple_size<List>::value;
+
+  template <typename T>
+  using ReadHandler = T (*)(const Bus& bus, address offset);
+  template <typename T>
+  using WriteHandler = void (*)(Bus& bus, address offset, T val);
+
+  // Handlers of the accesses of a width, in address order. Handlers are null if the region doesn't
+  // support the width.
+  template <typename Handler>
+  struct Entry {
+    address start;
+    address end;
+    Handler handler;
+  };
+  template <typename Handler>
+  using Table = std::array<Entry<Handler>, COUNT>;
+
+  template <typename Region, typename T>
+  static constexpr ReadHandler<T> read_handler() {
+    if constexpr ((Region::read_widths & sizeof(T)) != 0)
+      return [](const Bus& bus, address offset) { return Region::template read<T>(bus, offset); };
+    else
+      return nullptr;
   }
-  if (memory::map::SPU.contains(addr, addr_rebased)) {
-    // NOTE: TRACE level because it's used a lot in BIOS init.
-    LOG_TRACE("Stubbed 16-bit write to SPU register: 0x{:04X} at 0x{:08X}", val, addr);
-    return m_spu.write<u16>(addr_rebased, val);
+
+  template <typename Region, typename T>
+  static constexpr WriteHandler<T> write_handler() {
+    if constexpr ((Region::write_widths & sizeof(T)) != 0)
+      return [](Bus& bus, address offset, T val) { Region::template write<T>(bus, offset, val); };
+    else
+      return nullptr;
   }
-  if (memory::map::IRQ_CONTROL.contains(addr, addr_rebased)) {
-    LOG_TRACE("{} 16-bit write of 0x{:04X}", addr_rebased == 0 ? "I_STAT" : "I_MASK", val);
-    return m_interrupts.write<u16>(addr_rebased, val);
+
+  template <typename Handler>
+  static constexpr Table<Handler> sorted(Table<Handler> table) {
+    for (size_t i = 1; i < table.size(); ++i)
+      for (size_t j = i; j > 0 && table[j].start < table[j - 1].start; --j) {
+        const auto entry = table[j];
+        table[j] = table[j - 1];
+        table[j - 1] = entry;
+      }
+    return table;
   }
-  if (memory::map::JOYPAD.contains(addr, addr_rebased)) {
-    LOG_TRACE_JOYPAD("16-bit write of {:04X} to {}", val, io::Joypad::addr_to_reg_name(addr_rebased));
-    m_joypad.write8(addr_rebased, val & 0xFF);
-    m_joypad.write8(addr_rebased + 1, (val >> 8) & 0xFF);
-    return;
+
+  template <typename T, size_t... I>
+  static constexpr Table<ReadHandler<T>> make_read_table(std::index_sequence<I...>) {
+    return sorted<ReadHandler<T>>({ { { std::tuple_element_t<I, List>::range.start(),
+                                        std::tuple_element_t<I, List>::range.start() +
+                                            std::tuple_element_t<I, List>::range.size(),
+                                        read_handler<std::tuple_element_t<I, List>, T>() }... } });
   }
-  if (memory::map::SIO.contains(addr, addr_rebased)) {
-    LOG_WARN("Unhandled 16-bit write to SIO register: 0x{:04X} at 0x{:08X}", val, addr);
-    return;
+
+  template <typename T, size_t... I>
+  static constexpr Table<WriteHandler<T>> make_write_table(std::index_sequence<I...>) {
+    return sorted<WriteHandler<T>>({ { { std::tuple_element_t<I, List>::range.start(),
+                                         std::tuple_element_t<I, List>::range.start() +
+                                             std::tuple_element_t<I, List>::range.size(),
+                                         write_handler<std::tuple_element_t<I, List>, T>() }... } });
   }
 
-  LOG_ERROR("Unknown 16-bit write of 0x{:04X} at 0x{:08X} ", val, addr);
-  assert(0);
+  template <typename T>
+  static constexpr auto read_table = make_read_table<T>(std::make_index_sequence<COUNT>{});
+  template <typename T>
+  static constexpr auto write_table = make_write_table<T>(std::make_index_sequence<COUNT>{});
+
+  template <typename Handler>
+  static constexpr bool has_overlaps(const Table<Handler>& table) {
+    for (size_t i = 1; i < table.size(); ++i)
+      if (table[i].start < table[i - 1].end)
+        return true;
+    return false;
+  }
+
+  // Entry of the region containing addr, nullptr if there isn't one
+  template <typename Handler>
+  static const Entry<Handler>* find(const Table<Handler>& table, address addr) {
+    const auto it = std::upper_bound(
+        table.begin(), table.end(), addr,
+        [](address a, const Entry<Handler>& entry) { return a < entry.start; });
+    if (it == table.begin() || addr >= (it - 1)->end)
+      return nullptr;
+    return &*(it - 1);
+  }
+};
+
+static_assert(!Regions::has_overlaps(Regions::read_table<u32>), "Bus regions can't overlap");
+
+void Bus::map_memory(const memory::Arena& arena) {
+  using namespace memory;
+
+  m_page_table.map_read(map::RAM_MIRRORS.start(), map::RAM_MIRRORS.size(), m_ram.data_ptr(), RAM_SIZE);
+  m_page_table.map_write(map::RAM_MIRRORS.start(), map::RAM_MIRRORS.size(), m_ram.data_ptr(), RAM_SIZE);
+  // Only the start of the scratchpad's page is mapped, 0x1F800400-0x1F800FFF is left unmapped
+  m_page_table.map_read(map::SCRATCHPAD.start(), PageTable::PAGE_SIZE, m_scratchpad.data_ptr(),
+                        SCRATCHPAD_SIZE);
+  m_page_table.map_write(map::SCRATCHPAD.start(), PageTable::PAGE_SIZE, m_scratchpad.data_ptr(),
+                         SCRATCHPAD_SIZE);
+  m_page_table.map_read(map::BIOS.start(), BIOS_SIZE, m_bios.data_ptr(), BIOS_SIZE);  // Read-only
+
+  // Writes to RAM pages with cached code or while logging need to go through Ram::write
+  m_ram.set_page_table(&m_page_table);
+
+  if (m_fastmem.init(arena))
+    m_ram.set_fastmem(&m_fastmem);
 }
 
-void Bus::write8(u32 addr, u8 val) {
-  addr = memory::mask_region(addr);
+template <typename T>
+T Bus::read_mmio(address addr) const {
+  const auto entry = Regions::find(Regions::read_table<T>, addr);
+  if (entry && entry->handler)
+    return entry->handler(*this, addr - entry->start);
 
-  address addr_rebased;
+  LOG_ERROR("Unknown {}-bit read at 0x{:08X}", sizeof(T) * 8, addr);
+  assert(0);
+  return 0;
+}
 
-  if (memory::map::RAM.contains(addr, addr_rebased))
-    return m_ram.write<u8>(addr_rebased, val);
-  if (memory::map::SCRATCHPAD.contains(addr, addr_rebased))
-    return m_scratchpad.write<u8>(addr_rebased, val);
-  if (memory::map::JOYPAD.contains(addr, addr_rebased)) {
-    LOG_TRACE_JOYPAD("8-bit write of {:02X} to {}", val, io::Joypad::addr_to_reg_name(addr_rebased));
-    m_joypad.write8(addr_rebased, val);
-    return;
-  }
-  if (memory::map::EXPANSION_2.contains(addr, addr_rebased)) {
-    LOG_WARN("Unhandled 8-bit write to EXPANSION_2 register: 0x{:02X} at 0x{:08X}", val, addr);
-    return;
-  }
-  if (memory::map::CDROM.contains(addr, addr_rebased)) {
-    m_cdrom.write_reg(addr_rebased, val);
-    return;
-  }
-  if (memory::map::DMA.contains(addr, addr_rebased))
-    return m_dma.write<u8>(addr_rebased, val);
+template <typename T>
+void Bus::write_mmio(address addr, T val) {
+  const auto entry = Regions::find(Regions::write_table<T>, addr);
+  if (entry && entry->handler)
+    return entry->handler(*this, addr - entry->start, val);
 
-  LOG_ERROR("Unknown 8-bit write of 0x{:02X} at 0x{:08X} ", val, addr);
+  LOG_ERROR("Unknown {}-bit write of 0x{:0{}X} at 0x{:08X}", sizeof(T) * 8, val, sizeof(T) * 2, addr);
   assert(0);
 }
 
+template u8 Bus::read_mmio<u8>(address addr) const;
+template u16 Bus::read_mmio<u16>(address addr) const;
+template u32 Bus::read_mmio<u32>(address addr) const;
+template void Bus::write_mmio<u8>(address addr, u8 val);
+template void Bus::write_mmio<u16>(address addr, u16 val);
+template void Bus::write_mmio<u32>(address addr, u32 val);
+
+u32 Bus::read_cycles(address addr, u32 size) const {
+  return m_timings.read_cycles(memory::mask_region(addr), size);
+}
+
+u32 Bus::fetch_cycles(address addr) const {
+  // Code in KUSEG and KSEG0 is assumed to always hit the instruction cache, KSEG1 is uncached
+  if (addr >> 29 != 0b101)
+    return 0;
+  return read_cycles(addr, 4);
+}
+
 }  // namespace bus
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <bus/stats.hpp>
+#include <bus/timing.hpp>
+#include <memory/fastmem.hpp>
+#include <memory/page_table.hpp>
 #include <util/types.hpp>
 
+#include <type_traits>
+
 namespace bios {
 class Bios;
 }
@@ -11,6 +17,7 @@ class Interrupts;
 }
 
 namespace memory {
+class Arena;
 class Ram;
 class Scratchpad;
 class Dma;
@@ -33,9 +40,14 @@ class Timers;
 
 namespace bus {
 
+struct Regions;
+
 class Bus {
+  friend struct Regions;
+
  public:
-  explicit Bus(bios::Bios const& bios,
+  explicit Bus(const memory::Arena& arena,
+               bios::Bios const& bios,
                memory::Expansion& expansion,
                cpu::Interrupts& interrupts,
                memory::Scratchpad& scratchpad,
@@ -57,19 +69,76 @@ class Bus {
         m_spu(spu),
         m_joypad(joypad),
         m_cdrom(cdrom),
-        m_timers(timers) {}
+        m_timers(timers) {
+    map_memory(arena);
+  }
+
+  // Accesses of T (u8, u16 or u32) at the virtual address addr, which is force-aligned. Memory is looked
+  // up in the page table, the rest is dispatched to the device mapped there (see Regions in bus.cpp).
+  template <typename T>
+  T read(address addr) const {
+    static_assert(is_access_type<T>(), "The bus only does 8, 16 and 32-bit accesses");
+    addr = physical_address(addr) & ~static_cast<address>(sizeof(T) - 1);
+    if (m_stats)
+      m_stats->count(addr, sizeof(T), false);
+
+    if (const auto host = m_page_table.read_ptr(addr))
+      return memory::PageTable::load<T>(host);
+    return read_mmio<T>(addr);
+  }
+
+  template <typename T>
+  void write(address addr, T val) {
+    static_assert(is_access_type<T>(), "The bus only does 8, 16 and 32-bit accesses");
+    addr = physical_address(addr) & ~static_cast<address>(sizeof(T) - 1);
+    if (m_stats)
+      m_stats->count(addr, sizeof(T), true);
+
+    if (const auto host = m_page_table.write_ptr(addr))
+      return memory::PageTable::store<T>(host, val);
+    write_mmio<T>(addr, val);
+  }
+
+  // Extra Cpu cycles a data read of size (1, 2 or 4) bytes from addr takes
+  u32 read_cycles(address addr, u32 size) const;
+  // Extra Cpu cycles fetching an instruction in RAM or BIOS from addr takes
+  u32 fetch_cycles(address addr) const;
+  // Incremented every time the above change
+  u32 timing_generation() const { return m_timings.generation(); }
 
-  u32 read32(u32 addr) const;
-  u16 read16(u32 addr) const;
-  u8 read8(u32 addr) const;
-  void write32(u32 addr, u32 val);
-  void write16(u32 addr, u16 val);
-  void write8(u32 addr, u8 val);
+  // Direct access to memory for native code, its base() is nullptr if it's not available
+  memory::Fastmem& fastmem() { return m_fastmem; }
+
+  // Counts all accesses in stats from now on, nullptr to stop
+  void set_stats(AccessStats* stats) { m_stats = stats; }
+  bool has_stats() const { return m_stats != nullptr; }
+
+  // Devices are saved by their owner, only the bus' own state is saved here
+  void serialize(util::Serializer& s) { m_timings.serialize(s); }
 
   cpu::Interrupts& m_interrupts;
   memory::Ram& m_ram;
 
  private:
+  template <typename T>
+  static constexpr bool is_access_type() {
+    return std::is_same<T, u8>::value || std::is_same<T, u16>::value || std::is_same<T, u32>::value;
+  }
+
+  // KUSEG, KSEG0 and KSEG1 are all views of the 512MB physical address space, KSEG2 only has the cache
+  // control register
+  static address physical_address(address addr) {
+    return (addr >= 0xC0000000) ? addr : (addr & 0x1FFFFFFF);
+  }
+
+  template <typename T>
+  T read_mmio(address addr) const;
+  template <typename T>
+  void write_mmio(address addr, T val);
+
+  // Maps RAM, the scratchpad and the BIOS in the page table, and views of arena in the fastmem region
+  void map_memory(const memory::Arena& arena);
+
   memory::Expansion& m_expansion;
   memory::Scratchpad& m_scratchpad;
   bios::Bios const& m_bios;
@@ -79,6 +148,12 @@ class Bus {
   io::Joypad& m_joypad;
   io::CdromDrive& m_cdrom;
   io::Timers& m_timers;
+
+  AccessTimings m_timings;
+  // Memory accesses are looked up here first, the device handlers below take care of the rest
+  memory::PageTable m_page_table;
+  memory::Fastmem m_fastmem;
+  AccessStats* m_stats{};
 };
 
 }  // namespace bus
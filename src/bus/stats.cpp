@@ -0,0 +1,103 @@
+#include <bus/stats.hpp>
+
+#include <memory/map.hpp>
+
+#include <fstream>
+
+namespace bus {
+
+namespace {
+
+struct StatsRange {
+  memory::Range range;
+  StatsRegion region;
+};
+
+// Most accessed first, GP0 and GP1 are the GPU's two registers
+constexpr StatsRange STATS_RANGES[] = {
+  { memory::map::RAM_MIRRORS, StatsRegion::Ram },
+  { memory::map::SCRATCHPAD, StatsRegion::Scratchpad },
+  { memory::map::BIOS, StatsRegion::Bios },
+  { memory::Range(memory::map::GPU.start(), 4), StatsRegion::Gp0 },
+  { memory::Range(memory::map::GPU.start() + 4, 4), StatsRegion::Gp1 },
+  { memory::map::DMA, StatsRegion::Dma },
+  { memory::map::IRQ_CONTROL, StatsRegion::IrqControl },
+  { memory::map::TIMERS, StatsRegion::Timers },
+  { memory::map::CDROM, StatsRegion::Cdrom },
+  { memory::map::JOYPAD, StatsRegion::Joypad },
+  { memory::map::SPU, StatsRegion::Spu },
+  { memory::map::SIO, StatsRegion::Sio },
+  { memory::map::MEM_CONTROL1, StatsRegion::MemControl },
+  { memory::map::MEM_CONTROL2, StatsRegion::MemControl },
+  { memory::map::MEM_CONTROL3, StatsRegion::MemControl },
+  { memory::map::EXPANSION_1, StatsRegion::Expansion },
+  { memory::map::EXPANSION_2, StatsRegion::Expansion },
+};
+
+constexpr const char* WIDTH_NAMES[AccessStats::WIDTH_COUNT] = { "8", "16", "32" };
+
+}  // namespace
+
+const char* stats_region_to_str(StatsRegion region) {
+  switch (region) {
+    case StatsRegion::Ram: return "ram";
+    case StatsRegion::Scratchpad: return "scratchpad";
+    case StatsRegion::Bios: return "bios";
+    case StatsRegion::Expansion: return "expansion";
+    case StatsRegion::MemControl: return "mem_control";
+    case StatsRegion::Joypad: return "joypad";
+    case StatsRegion::Sio: return "sio";
+    case StatsRegion::IrqControl: return "irq_control";
+    case StatsRegion::Dma: return "dma";
+    case StatsRegion::Timers: return "timers";
+    case StatsRegion::Cdrom: return "cdrom";
+    case StatsRegion::Gp0: return "gp0";
+    case StatsRegion::Gp1: return "gp1";
+    case StatsRegion::Spu: return "spu";
+    case StatsRegion::Other: return "other";
+    default: return "?";
+  }
+}
+
+void AccessStats::count(address addr, u32 size, bool is_write) {
+  auto region = StatsRegion::Other;
+  for (const auto& stats_range : STATS_RANGES) {
+    if (addr - stats_range.range.start() < stats_range.range.size()) {
+      region = stats_range.region;
+      break;
+    }
+  }
+
+  const u32 width = (size == 4) ? 2 : size - 1;
+  ++m_counts[index(region)][is_write][width];
+}
+
+u64 AccessStats::total() const {
+  u64 total = 0;
+  for (const auto& region : m_counts)
+    for (const auto& direction : region)
+      for (const auto count : direction)
+        total += count;
+  return total;
+}
+
+bool AccessStats::save_json(const fs::path& path) const {
+  std::ofstream ofs(path, std::ios::trunc);
+
+  ofs << "{\n";
+  for (size_t region = 0; region < m_counts.size(); ++region) {
+    ofs << "  \"" << stats_region_to_str(static_cast<StatsRegion>(region)) << "\": {";
+    for (u32 direction = 0; direction < 2; ++direction) {
+      for (u32 width = 0; width < WIDTH_COUNT; ++width) {
+        ofs << ((direction == 0 && width == 0) ? " " : ", ") << '"' << (direction ? "write" : "read")
+            << WIDTH_NAMES[width] << "\": " << m_counts[region][direction][width];
+      }
+    }
+    ofs << " }" << ((region + 1 < m_counts.size()) ? ",\n" : "\n");
+  }
+  ofs << "}\n";
+
+  return bool(ofs);
+}
+
+}  // namespace bus
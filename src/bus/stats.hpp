@@ -0,0 +1,61 @@
+#pragma once
+
+#include <util/fs.hpp>
+#include <util/types.hpp>
+
+#include <array>
+
+namespace bus {
+
+// What AccessStats counts accesses to
+enum class StatsRegion : u8 {
+  Ram,
+  Scratchpad,
+  Bios,
+  Expansion,   // 1 and 2
+  MemControl,  // Including the cache control register
+  Joypad,
+  Sio,
+  IrqControl,
+  Dma,
+  Timers,
+  Cdrom,
+  Gp0,  // GP0 writes, GPUREAD reads
+  Gp1,  // GP1 writes, GPUSTAT reads
+  Spu,
+  Other,  // Unmapped
+
+  Count,
+};
+
+constexpr size_t STATS_REGION_COUNT = static_cast<size_t>(StatsRegion::Count);
+
+const char* stats_region_to_str(StatsRegion region);
+
+// Counts the accesses going through the Bus, by region, direction and width, to show which device paths
+// are hot. Instruction fetches that miss the block cache are counted as reads too.
+// While counting, recompiled code doesn't access memory directly (see memory::Fastmem), so that its
+// accesses are seen.
+class AccessStats {
+ public:
+  static constexpr u32 WIDTH_COUNT = 3;  // 8, 16 and 32-bit
+
+  // addr is physical, size is in bytes
+  void count(address addr, u32 size, bool is_write);
+  void reset() { m_counts = {}; }
+
+  // width is 0, 1 or 2 for 8, 16 and 32-bit
+  u64 reads(StatsRegion region, u32 width) const { return m_counts[index(region)][0][width]; }
+  u64 writes(StatsRegion region, u32 width) const { return m_counts[index(region)][1][width]; }
+  u64 total() const;
+
+  bool save_json(const fs::path& path) const;
+
+ private:
+  static constexpr size_t index(StatsRegion region) { return static_cast<size_t>(region); }
+
+  // By region, direction (read, write) and width
+  std::array<std::array<std::array<u64, WIDTH_COUNT>, 2>, STATS_REGION_COUNT> m_counts{};
+};
+
+}  // namespace bus
@@ -0,0 +1,103 @@
+#include <bus/timing.hpp>
+
+#include <memory/map.hpp>
+
+#include <algorithm>
+
+namespace bus {
+
+AccessTimings::AccessTimings() {
+  // Values the BIOS writes on boot
+  m_delays[static_cast<u32>(DelayRegion::Expansion1)].word = 0x0013243F;
+  m_delays[static_cast<u32>(DelayRegion::Expansion3)].word = 0x00003022;
+  m_delays[static_cast<u32>(DelayRegion::Bios)].word = 0x0013243F;
+  m_delays[static_cast<u32>(DelayRegion::Spu)].word = 0x200931E1;
+  m_delays[static_cast<u32>(DelayRegion::Cdrom)].word = 0x00020843;
+  m_delays[static_cast<u32>(DelayRegion::Expansion2)].word = 0x00070777;
+  m_common_delay.word = 0x00031125;
+
+  for (u32 region = 0; region < REGION_COUNT; ++region)
+    update(static_cast<DelayRegion>(region));
+}
+
+void AccessTimings::set_delay(DelayRegion region, u32 val) {
+  m_delays[static_cast<u32>(region)].word = val;
+  update(region);
+  ++m_generation;
+}
+
+void AccessTimings::set_common_delay(u32 val) {
+  m_common_delay.word = val;
+  for (u32 region = 0; region < REGION_COUNT; ++region)
+    update(static_cast<DelayRegion>(region));
+  ++m_generation;
+}
+
+void AccessTimings::serialize(util::Serializer& s) {
+  s.value(m_delays);
+  s.value(m_common_delay);
+
+  if (s.is_loading()) {
+    for (u32 region = 0; region < REGION_COUNT; ++region)
+      update(static_cast<DelayRegion>(region));
+    ++m_generation;
+  }
+}
+
+u32 AccessTimings::read_cycles(address addr, u32 size) const {
+  using namespace memory;
+
+  const u32 size_index = size >> 1;
+  address addr_rebased;
+
+  if (map::RAM_MIRRORS.contains(addr, addr_rebased))
+    return RAM_READ_CYCLES;
+  if (map::SCRATCHPAD.contains(addr, addr_rebased))
+    return SCRATCHPAD_READ_CYCLES;
+  if (map::BIOS.contains(addr, addr_rebased))
+    return m_read_cycles[static_cast<u32>(DelayRegion::Bios)][size_index];
+  if (map::SPU.contains(addr, addr_rebased))
+    return m_read_cycles[static_cast<u32>(DelayRegion::Spu)][size_index];
+  if (map::CDROM.contains(addr, addr_rebased))
+    return m_read_cycles[static_cast<u32>(DelayRegion::Cdrom)][size_index];
+  if (map::EXPANSION_1.contains(addr, addr_rebased))
+    return m_read_cycles[static_cast<u32>(DelayRegion::Expansion1)][size_index];
+  if (map::EXPANSION_2.contains(addr, addr_rebased))
+    return m_read_cycles[static_cast<u32>(DelayRegion::Expansion2)][size_index];
+  return IO_READ_CYCLES;
+}
+
+void AccessTimings::update(DelayRegion region) {
+  const auto delay = m_delays[static_cast<u32>(region)];
+
+  // See "Memory Control" in nocash's psx-spx
+  s32 first = 0;
+  s32 seq = 0;
+  s32 min = 0;
+
+  if (delay.use_com0) {
+    first += m_common_delay.com0 - 1;
+    seq += m_common_delay.com0 - 1;
+  }
+  if (delay.use_com2) {
+    first += m_common_delay.com2;
+    seq += m_common_delay.com2;
+  }
+  if (delay.use_com3)
+    min = m_common_delay.com3;
+  if (first < 6)
+    first += 1;
+
+  first += delay.read_delay + 2;
+  seq += delay.read_delay + 2;
+  first = std::max(first, min + 6);
+  seq = std::max(seq, min + 2);
+
+  // Wider reads are split into sequential bus-width accesses
+  auto& cycles = m_read_cycles[static_cast<u32>(region)];
+  cycles[0] = first;
+  cycles[1] = delay.data_bus_16bit ? first : first + seq;
+  cycles[2] = delay.data_bus_16bit ? first + seq : first + 3 * seq;
+}
+
+}  // namespace bus
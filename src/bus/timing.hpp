@@ -0,0 +1,83 @@
+#pragma once
+
+#include <util/serializer.hpp>
+#include <util/types.hpp>
+
+#include <array>
+
+namespace bus {
+
+// Extra Cpu cycles reads take from regions without configurable timing
+constexpr u32 RAM_READ_CYCLES = 5;
+constexpr u32 SCRATCHPAD_READ_CYCLES = 0;
+constexpr u32 IO_READ_CYCLES = 2;
+
+// Regions with a Delay/Size register in MEM_CONTROL1, in register order (0x1F801008 onwards)
+enum class DelayRegion : u8 {
+  Expansion1 = 0,
+  Expansion3 = 1,
+  Bios = 2,
+  Spu = 3,
+  Cdrom = 4,
+  Expansion2 = 5,
+
+  Count,
+};
+
+union MemoryDelayRegister {
+  u32 word{};
+
+  struct {
+    u32 write_delay : 4;     // [0-3]   Write Delay
+    u32 read_delay : 4;      // [4-7]   Read Delay
+    u32 use_com0 : 1;        // [8]     Recovery Period   (0=No, 1=Yes, uses COM0 timings)
+    u32 use_com1 : 1;        // [9]     Hold Period       (0=No, 1=Yes, uses COM1 timings)
+    u32 use_com2 : 1;        // [10]    Floating Period   (0=No, 1=Yes, uses COM2 timings)
+    u32 use_com3 : 1;        // [11]    Pre-strobe Period (0=No, 1=Yes, uses COM3 timings)
+    u32 data_bus_16bit : 1;  // [12]    Data Bus-width    (0=8bits, 1=16bits)
+    u32 _13_31 : 19;         // [13-31] Auto increment, memory window size (unused)
+  };
+};
+
+union CommonDelayRegister {
+  u32 word{};
+
+  struct {
+    u32 com0 : 4;  // [0-3]
+    u32 com1 : 4;  // [4-7]
+    u32 com2 : 4;  // [8-11]
+    u32 com3 : 4;  // [12-15]
+    u32 _16_31 : 16;
+  };
+};
+
+// Timing of Cpu reads from each region, derived from the MEM_CONTROL1 Delay/Size and COM_DELAY
+// registers. Writes aren't timed, they go through the Cpu's write buffer.
+class AccessTimings {
+ public:
+  AccessTimings();
+
+  void set_delay(DelayRegion region, u32 val);
+  void set_common_delay(u32 val);
+
+  // Extra Cpu cycles a read of size (1, 2 or 4) bytes from physical address addr takes
+  u32 read_cycles(address addr, u32 size) const;
+
+  // Incremented every time the timings change
+  u32 generation() const { return m_generation; }
+
+  void serialize(util::Serializer& s);
+
+ private:
+  void update(DelayRegion region);
+
+  static constexpr auto REGION_COUNT = static_cast<u32>(DelayRegion::Count);
+
+  std::array<MemoryDelayRegister, REGION_COUNT> m_delays;
+  CommonDelayRegister m_common_delay;
+
+  std::array<std::array<u8, 3>, REGION_COUNT> m_read_cycles{};  // Indexed by region and log2(size)
+  u32 m_generation{};
+};
+
+}  // namespace bus
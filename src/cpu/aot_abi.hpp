@@ -0,0 +1,133 @@
+#pragma once
+
+// Interface between the emulator and code generated by tools/aot_recompiler.
+// Generated code only includes this header, so that it doesn't depend on the emulator's internals. It
+// mirrors what the Recompiler emits: ALU and branch instructions run directly on the Cpu's state through
+// the pointers in Context, everything else goes through the interpreter.
+
+#include <cstdint>
+
+namespace cpu {
+namespace aot {
+
+// Bumped whenever anything below changes, modules built for other versions are rejected
+constexpr uint32_t ABI_VERSION = 1;
+
+// Same values as cpu::BranchFlags
+constexpr uint8_t BRANCH_DELAY_SLOT = 1 << 0;
+constexpr uint8_t BRANCH_TAKEN = 1 << 1;
+
+// Views into the Cpu's state, filled in by cpu::AotCache
+struct Context {
+  void* cpu;
+  uint32_t* gpr;
+  uint32_t* hi;
+  uint32_t* lo;
+  uint32_t* pc;
+  uint32_t* pc_next;
+  uint32_t* pc_current;
+  uint8_t* branch_flags;
+  bool* bios_call_pending;
+  uint8_t* load_slot_reg;  // Register of the pending delayed load (0 if none)
+  uint8_t* next_load_slot_reg;
+  uint64_t* cycles;
+  const uint64_t* cycles_end;
+  const bool* interrupt_pending;
+  const uint32_t* invalidation_count;  // Of the BlockCache, changes when code in RAM is written to
+  uint32_t ram_fetch_cycles;           // Cycles an instruction fetch from RAM takes
+
+  // Runs an instruction through the interpreter, returns true if generated code should return
+  bool (*interpret)(void* cpu, uint32_t word);
+  void (*do_pending_load)(void* cpu);
+};
+
+// Runs the code of a guest function from entry_pc, which must be one of its block_starts. Returns the
+// number of guest instructions executed (0 if entry_pc isn't known).
+using FunctionCode = uint32_t (*)(Context* c, uint32_t entry_pc);
+
+struct Function {
+  uint32_t start;         // Address of the first instruction of its code
+  uint32_t word_count;    // Size of its code, including any gaps between its blocks
+  const uint32_t* words;  // Its code at translation time, RAM has to still hold it to be run
+  const uint32_t* block_starts;
+  uint32_t block_count;
+  FunctionCode code;
+};
+
+struct Module {
+  uint32_t abi_version;
+  uint32_t function_count;
+  const Function* functions;
+};
+
+// Name of the function a module exports to return its Module
+#define PCTATION_AOT_MODULE_SYMBOL "pctation_aot_module"
+using GetModuleFunction = const Module* (*)();
+
+#ifdef _WIN32
+#define PCTATION_AOT_EXPORT extern "C" __declspec(dllexport)
+#else
+#define PCTATION_AOT_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+//
+// Helpers for generated code, see Recompiler for their interpreter equivalents
+//
+
+// Before each instruction that isn't in a delay slot
+inline void begin(Context* c, uint32_t pc) {
+  *c->branch_flags = (*c->branch_flags & (BRANCH_DELAY_SLOT | BRANCH_TAKEN)) << 2;
+  *c->pc = pc + 4;
+  *c->pc_next = pc + 8;
+}
+
+// Before an instruction in a delay slot, where the next PC is only known at runtime
+inline void begin_delay_slot(Context* c) {
+  *c->branch_flags = (*c->branch_flags & (BRANCH_DELAY_SLOT | BRANCH_TAKEN)) << 2;
+  *c->pc = *c->pc_next;
+  *c->pc_next = *c->pc + 4;
+}
+
+// After each instruction
+inline void end(Context* c) {
+  if (*c->load_slot_reg | *c->next_load_slot_reg)
+    c->do_pending_load(c->cpu);
+}
+
+inline void set_gpr(Context* c, uint8_t reg, uint32_t val) {
+  if (reg == 0)
+    return;
+  c->gpr[reg] = val;
+
+  // Cpu::invalidate_reg
+  if (*c->load_slot_reg == reg)
+    *c->load_slot_reg = 0;
+}
+
+inline void branch(Context* c) {
+  *c->branch_flags |= BRANCH_DELAY_SLOT;
+}
+
+inline void take_branch(Context* c, uint32_t target) {
+  *c->pc_next = target;
+  *c->branch_flags |= BRANCH_TAKEN;
+
+  const uint32_t masked_target = target & 0x1FFFFFFF;
+  if (masked_target == 0xA0 || masked_target == 0xB0 || masked_target == 0xC0)
+    *c->bios_call_pending = true;
+}
+
+// Charges an instruction's cycles, returns true if the step is over
+inline bool charge_cycles(Context* c, uint32_t instruction_cycles) {
+  *c->cycles += instruction_cycles + c->ram_fetch_cycles;
+  return *c->cycles >= *c->cycles_end;
+}
+
+// Whether execution can go on to another block without going back to Cpu::step
+inline bool can_continue(const Context* c, uint32_t invalidation_count) {
+  return !*c->interrupt_pending && *c->cycles < *c->cycles_end &&
+         *c->invalidation_count == invalidation_count && !(*c->branch_flags & BRANCH_DELAY_SLOT);
+}
+
+}  // namespace aot
+}  // namespace cpu
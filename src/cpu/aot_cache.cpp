@@ -0,0 +1,168 @@
+#include <cpu/aot_cache.hpp>
+
+#include <bus/bus.hpp>
+#include <cpu/block_cache.hpp>
+#include <cpu/cpu.hpp>
+#include <memory/map.hpp>
+#include <util/log.hpp>
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace cpu {
+
+static_assert(aot::BRANCH_DELAY_SLOT == BRANCH_DELAY_SLOT && aot::BRANCH_TAKEN == BRANCH_TAKEN,
+              "Branch flags of generated code don't match the Cpu's");
+
+AotCache::AotCache(Cpu& cpu, BlockCache& block_cache) : m_cpu(cpu), m_block_cache(block_cache) {
+  m_context.cpu = &m_cpu;
+  m_context.gpr = m_cpu.m_gpr.data();
+  m_context.hi = &m_cpu.m_hi;
+  m_context.lo = &m_cpu.m_lo;
+  m_context.pc = &m_cpu.m_pc;
+  m_context.pc_next = &m_cpu.m_pc_next;
+  m_context.pc_current = &m_cpu.m_pc_current;
+  m_context.branch_flags = &m_cpu.m_branch_flags;
+  m_context.bios_call_pending = &m_cpu.m_bios_call_pending;
+  m_context.load_slot_reg = &m_cpu.m_slot_current.reg;
+  m_context.next_load_slot_reg = &m_cpu.m_slot_next.reg;
+  m_context.cycles = &m_cpu.m_cycles;
+  m_context.cycles_end = &m_cpu.m_cycles_end;
+  m_context.interrupt_pending = &m_cpu.m_interrupt_pending;
+  m_context.invalidation_count = m_block_cache.invalidation_count_ptr();
+  m_context.interpret = &AotCache::interpret_trampoline;
+  m_context.do_pending_load = &AotCache::pending_load_trampoline;
+}
+
+AotCache::~AotCache() {
+  unload();
+}
+
+bool AotCache::load(const fs::path& module_path) {
+  unload();
+
+#ifdef _WIN32
+  const auto library = LoadLibraryW(module_path.wstring().c_str());
+  const auto get_module = library ? reinterpret_cast<aot::GetModuleFunction>(
+                                        GetProcAddress(library, PCTATION_AOT_MODULE_SYMBOL))
+                                  : nullptr;
+#else
+  const auto library = dlopen(module_path.string().c_str(), RTLD_NOW | RTLD_LOCAL);
+  const auto get_module =
+      library ? reinterpret_cast<aot::GetModuleFunction>(dlsym(library, PCTATION_AOT_MODULE_SYMBOL))
+              : nullptr;
+#endif
+
+  if (!library) {
+    LOG_ERROR("Couldn't load AOT module {}", module_path.string());
+    return false;
+  }
+  m_library = reinterpret_cast<void*>(library);
+
+  const auto module = get_module ? get_module() : nullptr;
+  if (!module || module->abi_version != aot::ABI_VERSION) {
+    LOG_ERROR("{} isn't an AOT module for this version of the emulator", module_path.string());
+    unload();
+    return false;
+  }
+
+  for (u32 i = 0; i < module->function_count; ++i) {
+    const auto& function = module->functions[i];
+    for (u32 j = 0; j < function.block_count; ++j)
+      m_functions.emplace(function.block_starts[j], &function);
+  }
+  m_module = module;
+
+  // Blocks might remember that there's no translated code for them
+  m_block_cache.clear();
+
+  LOG_INFO("Loaded AOT module {} ({} functions)", module_path.string(), module->function_count);
+  return true;
+}
+
+void AotCache::unload() {
+  if (!m_library)
+    return;
+
+  // Blocks point into the module
+  if (m_module)
+    m_block_cache.clear();
+
+  m_functions.clear();
+  m_module = nullptr;
+
+#ifdef _WIN32
+  FreeLibrary(reinterpret_cast<HMODULE>(m_library));
+#else
+  dlclose(m_library);
+#endif
+  m_library = nullptr;
+}
+
+u32 AotCache::execute(Block& block, address pc) {
+  if (!m_module)
+    return 0;
+
+  if (!block.aot_checked || block.aot_pc != pc) {
+    block.aot_checked = true;
+    block.aot_pc = pc;
+    block.aot_function = find_function(pc, block.phys_addr);
+  }
+
+  const auto function = block.aot_function;
+  if (!function)
+    return 0;
+
+  // Translated code only lives in RAM, fetch timings are the same for all of it
+  m_context.ram_fetch_cycles = m_cpu.m_bus.fetch_cycles(pc);
+  return function->code(&m_context, pc);
+}
+
+const aot::Function* AotCache::find_function(address pc, address block_phys_addr) {
+  const auto it = m_functions.find(pc);
+  if (it == m_functions.end())
+    return nullptr;
+
+  const auto function = it->second;
+  if (!matches_ram(*function)) {
+    LOG_DEBUG("Code of AOT function at 0x{:08X} was modified, interpreting it", function->start);
+    return nullptr;
+  }
+
+  // Writes to any part of the function have to invalidate the block, not only to the block's own code
+  m_block_cache.track_range(block_phys_addr, memory::mask_region(function->start),
+                            function->word_count * 4);
+  return function;
+}
+
+bool AotCache::matches_ram(const aot::Function& function) const {
+  address addr_rebased;
+  if (!memory::map::RAM.contains(memory::mask_region(function.start), addr_rebased))
+    return false;
+  if (addr_rebased + function.word_count * 4 > memory::RAM_SIZE)
+    return false;
+
+  const auto& ram = m_cpu.m_bus.m_ram.data();
+  for (u32 i = 0; i < function.word_count; ++i) {
+    u32 word;
+    std::memcpy(&word, &ram[addr_rebased + i * 4], sizeof(word));
+    if (word != function.words[i])
+      return false;
+  }
+  return true;
+}
+
+bool AotCache::interpret_trampoline(void* cpu, u32 word) {
+  return static_cast<Cpu*>(cpu)->interpret_from_native(Instruction(word));
+}
+
+void AotCache::pending_load_trampoline(void* cpu) {
+  static_cast<Cpu*>(cpu)->do_pending_load();
+}
+
+}  // namespace cpu
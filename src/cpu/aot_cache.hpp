@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cpu/aot_abi.hpp>
+#include <util/fs.hpp>
+#include <util/types.hpp>
+
+#include <unordered_map>
+
+namespace cpu {
+
+class Cpu;
+class BlockCache;
+struct Block;
+
+// Extension of the modules built by tools/aot_recompiler, which are looked for next to the executable
+#ifdef _WIN32
+constexpr auto AOT_MODULE_EXTENSION = ".dll";
+#else
+constexpr auto AOT_MODULE_EXTENSION = ".so";
+#endif
+
+// Runs code of an executable that was translated ahead of time by tools/aot_recompiler, and built into a
+// shared library (see aot_abi.hpp).
+// A translated function is only used once RAM is checked to still hold the code it was translated from.
+// The RAM pages it spans are then registered with the blocks that use it, so that writes to them make us
+// check again.
+class AotCache {
+ public:
+  explicit AotCache(Cpu& cpu, BlockCache& block_cache);
+  ~AotCache();
+
+  bool load(const fs::path& module_path);  // Returns true on successful load
+  void unload();
+  bool loaded() const { return m_module != nullptr; }
+
+  // Runs the translated code for block, which starts at (virtual address) pc, if there is any.
+  // Returns the number of guest instructions executed, or 0 if there's no usable translated code.
+  u32 execute(Block& block, address pc);
+
+ private:
+  const aot::Function* find_function(address pc, address block_phys_addr);
+  bool matches_ram(const aot::Function& function) const;
+
+  // Called from translated code
+  static bool interpret_trampoline(void* cpu, u32 word);
+  static void pending_load_trampoline(void* cpu);
+
+  void* m_library{};
+  const aot::Module* m_module{};
+  std::unordered_map<address, const aot::Function*> m_functions;  // By (virtual) block start
+  aot::Context m_context{};
+
+  Cpu& m_cpu;
+  BlockCache& m_block_cache;
+};
+
+}  // namespace cpu
@@ -0,0 +1,93 @@
+#include <cpu/bios_log.hpp>
+
+#include <bios/functions.hpp>
+#include <util/log.hpp>
+
+#include <algorithm>
+
+namespace cpu {
+
+// Index of the oldest entry still held by a ring
+static u64 oldest_entry(u64 written, u32 capacity) {
+  return written > capacity ? written - capacity : 0;
+}
+
+void BiosLog::on_tty_output(u64 cycles, char c) {
+  allocate();
+
+  if (c == '\r')
+    return;
+
+  if (c == '\n') {
+    // Empty lines are kept too
+    if (!m_tty_line_open) {
+      auto& line = (*m_tty_lines)[m_tty_lines_written++ & (TTY_CAPACITY - 1)];
+      line.cycles = cycles;
+      line.length = 0;
+    }
+    m_tty_line_open = false;
+    return;
+  }
+
+  auto* line = &(*m_tty_lines)[(m_tty_lines_written - 1) & (TTY_CAPACITY - 1)];
+  if (!m_tty_line_open || line->length == TtyLine::MAX_LENGTH) {
+    line = &(*m_tty_lines)[m_tty_lines_written++ & (TTY_CAPACITY - 1)];
+    line->cycles = cycles;
+    line->length = 0;
+    m_tty_line_open = true;
+  }
+  line->text[line->length++] = c;
+}
+
+u32 BiosLog::call_count() const {
+  return static_cast<u32>(std::min<u64>(m_calls_written, CALL_CAPACITY));
+}
+
+u32 BiosLog::tty_line_count() const {
+  return static_cast<u32>(std::min<u64>(m_tty_lines_written, TTY_CAPACITY));
+}
+
+const BiosCall& BiosLog::call(u32 index) const {
+  return (*m_calls)[(oldest_entry(m_calls_written, CALL_CAPACITY) + index) & (CALL_CAPACITY - 1)];
+}
+
+const TtyLine& BiosLog::tty_line(u32 index) const {
+  return (*m_tty_lines)[(oldest_entry(m_tty_lines_written, TTY_CAPACITY) + index) & (TTY_CAPACITY - 1)];
+}
+
+std::string BiosLog::format_call(u32 index) const {
+  const auto& entry = call(index);
+
+  const auto* table = (entry.vector == 0xA) ? &bios::A0 : (entry.vector == 0xB) ? &bios::B0 : &bios::C0;
+  const auto function = table->find(entry.function);
+
+  std::string text = fmt::format("{:>12} [{:08X}] {:01X}({:02X})", entry.cycles, entry.return_addr,
+                                 entry.vector, entry.function);
+  if (function == table->end())
+    return text;
+
+  // Arguments after the 4th are passed on the stack, they aren't logged
+  const auto& args = function->second.args;
+  const auto arg_count = std::min<size_t>(args.size(), entry.args.size());
+
+  text += fmt::format(": {}(", function->second.name);
+  for (size_t i = 0; i < arg_count; ++i)
+    text += fmt::format("{}=0x{:X}{}", args[i], entry.args[i], i == (arg_count - 1) ? "" : ", ");
+  text += ")";
+  return text;
+}
+
+void BiosLog::clear() {
+  m_calls_written = 0;
+  m_tty_lines_written = 0;
+  m_tty_line_open = false;
+}
+
+void BiosLog::allocate() {
+  if (!m_calls) {
+    m_calls = std::make_unique<std::array<BiosCall, CALL_CAPACITY>>();
+    m_tty_lines = std::make_unique<std::array<TtyLine, TTY_CAPACITY>>();
+  }
+}
+
+}  // namespace cpu
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <util/types.hpp>
+
+#include <array>
+#include <memory>
+#include <string>
+
+namespace cpu {
+
+// A call to a BIOS function, as seen by Cpu::on_bios_call
+struct BiosCall {
+  u64 cycles;               // Cpu cycle it was made at
+  address return_addr;      // $ra
+  u8 vector;                // 0xA, 0xB or 0xC
+  u8 function;              // Function number ($t1)
+  std::array<u32, 4> args;  // $a0-$a3, formatting only shows the ones the function takes
+};
+
+// A line of TTY output (std_out_putchar/std_out_puts), longer ones are wrapped
+struct TtyLine {
+  static constexpr u32 MAX_LENGTH = 120;
+
+  u64 cycles;  // Cpu cycle its first character was printed at
+  u8 length;
+  std::array<char, MAX_LENGTH> text;  // Not null-terminated
+};
+
+// The most recent BIOS calls and lines of TTY output, for the debug UI.
+// Both are fixed-capacity rings, so memory use stays the same however long the emulator runs. Entries
+// are stored raw, and only formatted when they're displayed.
+class BiosLog {
+ public:
+  static constexpr u32 CALL_CAPACITY = 1 << 13;  // Entries, must be a power of 2
+  static constexpr u32 TTY_CAPACITY = 1 << 12;
+
+  void on_call(const BiosCall& call) {
+    allocate();
+    (*m_calls)[m_calls_written++ & (CALL_CAPACITY - 1)] = call;
+  }
+  void on_tty_output(u64 cycles, char c);
+
+  // Entries currently held, index 0 is the oldest
+  u32 call_count() const;
+  u32 tty_line_count() const;
+  const BiosCall& call(u32 index) const;
+  const TtyLine& tty_line(u32 index) const;
+
+  // "[return address] vector(function): name(arg=value, ...)", with the names known for the function
+  std::string format_call(u32 index) const;
+
+  void clear();
+
+ private:
+  // Allocated on first use, as they're only written to when logging is enabled
+  void allocate();
+
+  std::unique_ptr<std::array<BiosCall, CALL_CAPACITY>> m_calls;
+  std::unique_ptr<std::array<TtyLine, TTY_CAPACITY>> m_tty_lines;
+  u64 m_calls_written{};      // Total calls logged since the last clear
+  u64 m_tty_lines_written{};  // Same for TTY lines, including the one being printed
+  bool m_tty_line_open{};     // The last line hasn't been ended by a newline yet
+};
+
+}  // namespace cpu
@@ -0,0 +1,190 @@
+#include <cpu/block_cache.hpp>
+
+#include <bus/bus.hpp>
+#include <cpu/opcode.hpp>
+#include <memory/map.hpp>
+#include <util/log.hpp>
+
+#include <algorithm>
+
+namespace cpu {
+
+bool is_branch(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::J:
+    case Opcode::JAL:
+    case Opcode::JR:
+    case Opcode::JALR:
+    case Opcode::BEQ:
+    case Opcode::BNE:
+    case Opcode::BGTZ:
+    case Opcode::BLEZ:
+    case Opcode::BCONDZ: return true;
+    default: return false;
+  }
+}
+
+bool is_native(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::ADDU:
+    case Opcode::SUBU:
+    case Opcode::ADDIU:
+    case Opcode::AND:
+    case Opcode::OR:
+    case Opcode::XOR:
+    case Opcode::NOR:
+    case Opcode::ANDI:
+    case Opcode::ORI:
+    case Opcode::XORI:
+    case Opcode::LUI:
+    case Opcode::SLT:
+    case Opcode::SLTU:
+    case Opcode::SLTI:
+    case Opcode::SLTIU:
+    case Opcode::SLL:
+    case Opcode::SRL:
+    case Opcode::SRA:
+    case Opcode::SLLV:
+    case Opcode::SRLV:
+    case Opcode::SRAV:
+    case Opcode::MTHI:
+    case Opcode::MTLO:
+    case Opcode::J:
+    case Opcode::JAL:
+    case Opcode::BEQ:
+    case Opcode::BNE:
+    case Opcode::BGTZ:
+    case Opcode::BLEZ:
+    case Opcode::BCONDZ: return true;
+    default: return false;
+  }
+}
+
+// Branches relative to the PC (as opposed to jumps)
+static bool is_relative_branch(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::BEQ:
+    case Opcode::BNE:
+    case Opcode::BGTZ:
+    case Opcode::BLEZ:
+    case Opcode::BCONDZ: return true;
+    default: return false;
+  }
+}
+
+// These always throw an exception, so there's no point in decoding further
+static bool is_exception(Opcode opcode) {
+  return opcode == Opcode::SYSCALL || opcode == Opcode::BREAK || opcode == Opcode::INVALID;
+}
+
+static bool is_cacheable(address phys_addr) {
+  address addr_rebased;
+  return memory::map::RAM.contains(phys_addr, addr_rebased) ||
+         memory::map::BIOS.contains(phys_addr, addr_rebased);
+}
+
+BlockCache::BlockCache(bus::Bus& bus) : m_bus(bus) {}
+
+void BlockCache::track_range(address block_phys_addr, address phys_addr, u32 size) {
+  address addr_rebased;
+  if (size == 0 || !memory::map::RAM.contains(phys_addr, addr_rebased))
+    return;
+
+  const auto first_page = addr_rebased / memory::RAM_PAGE_SIZE;
+  const auto last_page =
+      std::min((addr_rebased + size - 1) / memory::RAM_PAGE_SIZE, memory::RAM_PAGE_COUNT - 1);
+
+  for (auto page = first_page; page <= last_page; ++page) {
+    m_ram_page_blocks[page].push_back(block_phys_addr);
+    m_bus.m_ram.mark_code_page(page);
+  }
+}
+
+void BlockCache::invalidate_page(u32 ram_page) {
+  auto& page_blocks = m_ram_page_blocks[ram_page];
+
+  // Blocks that span two pages are in both lists, erasing them twice is harmless
+  for (const auto phys_addr : page_blocks)
+    m_blocks.erase(phys_addr);
+  page_blocks.clear();
+
+  // The current block might have been freed
+  m_block = nullptr;
+  ++m_invalidation_count;
+}
+
+void BlockCache::clear() {
+  m_blocks.clear();
+  for (auto& page_blocks : m_ram_page_blocks)
+    page_blocks.clear();
+
+  m_block = nullptr;
+  m_loop_head = 1;
+  ++m_invalidation_count;
+}
+
+Block* BlockCache::get_block(address pc) {
+  if (pc % 4 != 0)
+    return nullptr;
+
+  const auto phys_addr = memory::mask_region(pc);
+
+  Block* block = nullptr;
+
+  const auto it = m_blocks.find(phys_addr);
+  if (it != m_blocks.end())
+    block = it->second.get();
+  else if (is_cacheable(phys_addr))
+    block = compile_block(phys_addr);
+
+  if (block && block->is_self_loop)
+    m_loop_head = pc;
+  return block;
+}
+
+const Instruction* BlockCache::fetch_block(address pc) {
+  m_block = get_block(pc);
+  if (!m_block)
+    return nullptr;
+
+  m_block_next_pc = pc + 4;
+  m_block_index = 1;
+  return &m_block->instructions[0];
+}
+
+Block* BlockCache::compile_block(address phys_addr) {
+  auto block = std::make_unique<Block>();
+  block->phys_addr = phys_addr;
+
+  address addr = phys_addr;
+  bool in_delay_slot = false;
+
+  while (block->instructions.size() < MAX_BLOCK_INSTRUCTIONS && is_cacheable(addr)) {
+    const Instruction instr(m_bus.read<u32>(addr));
+    block->instructions.push_back(instr);
+    addr += 4;
+
+    if (in_delay_slot || is_exception(instr.opcode()))
+      break;
+    in_delay_slot = is_branch(instr.opcode());
+  }
+
+  // The branch is followed by its delay slot, and its offset is relative to the delay slot
+  const auto instruction_count = block->instructions.size();
+  if (instruction_count >= 2) {
+    const auto& branch = block->instructions[instruction_count - 2];
+    block->is_self_loop =
+        is_relative_branch(branch.opcode()) && branch.imm16_se() == -static_cast<s32>(instruction_count - 1);
+  }
+
+  // Register the block with all the RAM pages it spans, so that writes to them invalidate it
+  track_range(phys_addr, phys_addr, addr - phys_addr);
+
+  const auto block_ptr = block.get();
+  m_blocks[phys_addr] = std::move(block);
+
+  LOG_TRACE("Compiled block at 0x{:08X} ({} instructions)", phys_addr, block_ptr->instructions.size());
+  return block_ptr;
+}
+
+}  // namespace cpu
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cpu/aot_abi.hpp>
+#include <cpu/instruction.hpp>
+#include <memory/ram.hpp>
+#include <util/types.hpp>
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace bus {
+class Bus;
+}
+
+namespace cpu {
+
+class Cpu;
+
+// Native code for a block, returns the number of guest instructions it executed (see cpu::Recompiler)
+using NativeBlockFunction = u32 (*)(Cpu* cpu);
+
+// Jumps and branches, which end a block after their delay slot
+bool is_branch(Opcode opcode);
+// Instructions that the Recompiler and tools/aot_recompiler translate to native code, the rest go
+// through the interpreter
+bool is_native(Opcode opcode);
+
+// Result of IdleLoopDetector's analysis of a self-looping block
+enum class IdleLoopStatus : u8 {
+  Unchecked,
+  Possible,    // Only contains instructions without side effects, iterations may be skipped
+  Impossible,  // Has side effects or loads from addresses that might change
+};
+
+// Max instructions decoded into a single block (if no branch is found before that)
+constexpr u32 MAX_BLOCK_INSTRUCTIONS = 64;
+
+// A run of pre-decoded instructions, up to and including the delay slot of the first branch/jump
+struct Block {
+  address phys_addr{};  // Physical address of the first instruction
+  std::vector<Instruction> instructions;
+  bool is_self_loop{};  // Ends with a branch back to its first instruction
+  IdleLoopStatus idle_loop{};
+
+  // Translated native code, if any
+  NativeBlockFunction native_code{};
+  address native_pc{};        // Virtual address the native code was translated for
+  u32 native_generation{};    // Code buffer generation the native code lives in
+  bool native_unsupported{};  // Block can't be translated, always interpret it
+
+  // Code translated ahead of time, if any (see cpu::AotCache)
+  const aot::Function* aot_function{};
+  address aot_pc{};    // Virtual address aot_function was looked up for
+  bool aot_checked{};  // aot_function was looked up
+};
+
+// Caches pre-decoded blocks keyed by their physical start address, so that we don't have to go through
+// the bus and decode every instruction we execute.
+// Only code in RAM and BIOS is cached. RAM pages containing cached code are tracked by memory::Ram, which
+// calls invalidate_page() when they're written to.
+class BlockCache {
+ public:
+  explicit BlockCache(bus::Bus& bus);
+
+  // Returns the pre-decoded instruction at (virtual address) pc, or nullptr if pc isn't cacheable
+  const Instruction* fetch(address pc) {
+    // Fast path: we're executing sequentially in the current block
+    if (continues_block(pc)) {
+      m_block_next_pc += 4;
+      return &m_block->instructions[m_block_index++];
+    }
+    return fetch_block(pc);
+  }
+
+  // Whether pc is the next instruction in the block fetch() is currently going through
+  bool continues_block(address pc) const {
+    return m_block && pc == m_block_next_pc && m_block_index < m_block->instructions.size();
+  }
+
+  // Returns the block starting at (virtual address) pc, decoding it if necessary. Returns nullptr if pc
+  // isn't cacheable
+  Block* get_block(address pc);
+
+  // Start of the last self-looping block that was looked up (an unaligned address if there was none)
+  address loop_head() const { return m_loop_head; }
+
+  // Registers the block at block_phys_addr with the RAM pages of a range of code it depends on, so that
+  // writes to them invalidate it
+  void track_range(address block_phys_addr, address phys_addr, u32 size);
+
+  void invalidate_page(u32 ram_page);
+  void clear();  // Forgets all blocks, for when all of memory changes at once
+  u32 invalidation_count() const { return m_invalidation_count; }
+  // For code translated ahead of time, which can't call invalidation_count()
+  const u32* invalidation_count_ptr() const { return &m_invalidation_count; }
+
+ private:
+  const Instruction* fetch_block(address pc);
+  Block* compile_block(address phys_addr);
+
+  std::unordered_map<address, std::unique_ptr<Block>> m_blocks;
+  std::array<std::vector<address>, memory::RAM_PAGE_COUNT> m_ram_page_blocks;  // Blocks per RAM page
+  u32 m_invalidation_count{};
+  address m_loop_head{ 1 };
+
+  // Current block cursor
+  const Block* m_block{};
+  address m_block_next_pc{};
+  u32 m_block_index{};
+
+  bus::Bus& m_bus;
+};
+
+}  // namespace cpu
@@ -1,10 +1,13 @@
 #include <cpu/cpu.hpp>
 
 #include <bios/functions.hpp>
+#include <bios/hle.hpp>
 #include <bus/bus.hpp>
+#include <cpu/cycles.hpp>
 #include <cpu/instruction.hpp>
 #include <cpu/interrupt.hpp>
 #include <cpu/opcode.hpp>
+#include <cpu/trace.hpp>
 #include <emulator/settings.hpp>
 #include <memory/ram.hpp>
 #include <util/log.hpp>
@@ -14,57 +17,169 @@
 #include <iostream>
 #include <string>
 
-#define TRACE_NONE 0
-#define TRACE_DISASM 1
-#define TRACE_REGS 2
-#define TRACE_PC_ONLY 3
-
-#define TRACE_MODE TRACE_NONE
-
-#define LOAD_EXE_HOOK 0
-
 namespace cpu {
 
 Cpu::Cpu(bus::Bus& bus, const emulator::Settings& settings)
     : m_bus(bus),
       m_gte(*this),
-      m_settings(settings) {}
-
-void Cpu::step(u32 cycles_to_execute) {
-  for (u32 cycle = 0; cycle < cycles_to_execute; cycle += APPROX_CYCLES_PER_INSTRUCTION) {
-#if LOAD_EXE_HOOK
-    // mid-boot hook to load an executable
-    if (m_pc == 0x80030000) {
-      memory::PSEXELoadInfo psxexe_load_info;
-      if (m_bus.m_ram.load_executable(psxexe_load_info)) {
-        set_pc(psxexe_load_info.pc);
-        m_gpr[28] = psxexe_load_info.r28;
-        m_gpr[29] = psxexe_load_info.r29_r30;
-        m_gpr[30] = psxexe_load_info.r29_r30;
+      m_block_cache(bus),
+      m_recompiler(*this, m_block_cache),
+      m_idle_loop_detector(*this, m_block_cache),
+      m_settings(settings) {
+  m_bus.m_ram.init(&m_block_cache);
+}
+
+// Bits of a step variant's index
+enum StepVariantBits : u32 {
+  STEP_DEBUG = 1 << 0,
+  STEP_TRACE = 1 << 1,
+  STEP_PROFILE = 1 << 2,
+  STEP_BIOS_LOG = 1 << 3,
+  STEP_EXE_HOOK = 1 << 4,
+  STEP_LOCKSTEP = 1 << 5,
+
+  STEP_VARIANT_COUNT = 1 << 6,
+};
+
+template <size_t Index>
+using StepPolicyFor = StepPolicy<(Index & STEP_DEBUG) != 0,
+                                 (Index & STEP_TRACE) != 0,
+                                 (Index & STEP_PROFILE) != 0,
+                                 (Index & STEP_BIOS_LOG) != 0,
+                                 (Index & STEP_EXE_HOOK) != 0,
+                                 (Index & STEP_LOCKSTEP) != 0>;
+
+template <size_t... Indices>
+constexpr std::array<Cpu::StepVariant, sizeof...(Indices)> Cpu::make_step_variants(
+    std::index_sequence<Indices...>) {
+  return { &Cpu::step<StepPolicyFor<Indices>>... };
+}
+
+void Cpu::select_step_variant() {
+  // Every combination of diagnostics, indexed by StepVariantBits
+  static constexpr auto variants = make_step_variants(std::make_index_sequence<STEP_VARIANT_COUNT>{});
+
+  u32 index = 0;
+  if (m_debugger.armed() || m_cop0_breakpoints_armed)
+    index |= STEP_DEBUG;
+  if (m_settings.trace_cpu) {
+    index |= STEP_TRACE;
+    m_trace.allocate();
+  }
+  if (m_settings.profile_cpu)
+    index |= STEP_PROFILE;
+  if (m_settings.log_bios_calls)
+    index |= STEP_BIOS_LOG;
+  if (m_stop_at_shell_entry)
+    index |= STEP_EXE_HOOK;
+  if (m_lockstep)
+    index |= STEP_LOCKSTEP;
+
+  m_step_variant = variants[index];
+}
+
+void Cpu::step(u64 cycles_end) {
+  if (m_debugger.paused())
+    return;
+
+  (this->*m_step_variant)(cycles_end);
+}
+
+template <typename Policy>
+void Cpu::step(u64 cycles_end) {
+  const bool trace_cpu_regs = Policy::trace && m_settings.trace_cpu_regs;
+  m_profiling = Policy::profile;
+
+  // Breakpoints, tracing and profiling need to see every instruction, so they always go through the
+  // interpreter
+  constexpr bool debugging = Policy::debug || Policy::trace || Policy::profile;
+  const bool use_recompiler = !debugging && m_settings.cpu_engine == emulator::CpuEngine::Recompiler;
+
+  // Devices might have changed what idle loops are waiting on since the last step
+  m_idle_loop_detector.reset();
+
+  m_cycles_end = cycles_end;
+  m_reached_shell_entry = false;
+
+  [[maybe_unused]] const u64 instructions_start = m_instructions;
+
+  while (m_cycles < m_cycles_end) {
+    if constexpr (Policy::lockstep) {
+      if (m_instructions != instructions_start)
+        return;
+    }
+
+    // Mid-boot hook, to save a boot snapshot or load an executable
+    if constexpr (Policy::exe_hook) {
+      if (m_pc == BIOS_SHELL_ENTRY_ADDR) {
+        m_stop_at_shell_entry = false;
+        m_reached_shell_entry = true;
+        select_step_variant();
+        return;
       }
     }
-#endif
 
-#ifdef LOG_BIOS_CALLS
-    bool was_branch_cycle = m_branch_taken_saved;
-#endif
+    // Check breakpoints before anything about the instruction changes state. If an interrupt is pending,
+    // it will be serviced before the instruction runs, we'll check it when it's returned to.
+    if constexpr (Policy::debug) {
+      if (!m_interrupt_pending && check_breakpoints())
+        return;
+    }
+
+    // Skip iterations of loops that are waiting for an event (tracing and profiling need to see them)
+    if (!debugging && m_pc == m_block_cache.loop_head())
+      m_idle_loop_detector.on_loop_head();
+
+    if (use_recompiler) {
+      const u32 instructions_executed = m_recompiler.execute_block();
+
+      if (instructions_executed) {
+        m_instructions += instructions_executed;
+        continue;
+      }
+    }
+
+    // Whether we're at the target of a taken jump to a BIOS function (the previous instruction was its
+    // delay slot)
+    const bool is_bios_call = m_bios_call_pending && (m_branch_flags & BRANCH_TAKEN_SAVED);
 
     // Store state for potential exceptions (and reset current state)
     store_exception_state();
 
-    // Check for interrupts and trigger an exception if any
+    // Trigger an exception if there's an interrupt. The flag is only updated when the registers that
+    // affect it change.
     // TODO: Delay by 1 cycle?
-    m_bus.m_interrupts.check_and_trigger();
+    if (m_interrupt_pending)
+      trigger_exception(ExceptionCause::Interrupt);
+
+    if (is_bios_call && is_bios_function_vector(m_pc)) {
+      m_bios_call_pending = false;
+      if constexpr (Policy::bios_log)
+        on_bios_call(m_pc & 0x1FFFFF);
+      if constexpr (Policy::profile)
+        m_profiler.on_bios_call(m_pc, gpr(9));
+
+      if (m_settings.hle_bios && hle_bios_call(m_pc & 0x1FFFFF)) {
+        // Returned to the caller without a JR $ra
+        if constexpr (Policy::profile)
+          m_profiler.on_return(m_pc);
+        continue;
+      }
+    }
+
+    // Fetch current instruction, already decoded if it's in the block cache
+    const Instruction* cached_instr = m_block_cache.fetch(m_pc);
 
-    // Fetch current instruction
     u32 cur_instr;
-    if (!load32(m_pc, cur_instr)) {
+    if (cached_instr)
+      cur_instr = cached_instr->word();
+    else if (!load32(m_pc, cur_instr)) {
       LOG_CRITICAL("PC unaligned: {:08X}", m_pc);
       continue;
     }
 
-    // Decode current instruction
-    const Instruction instr(cur_instr);
+    // Decode current instruction (copied, as executing it might invalidate its block)
+    const Instruction instr = cached_instr ? *cached_instr : Instruction(cur_instr);
 
     if (instr.opcode() == Opcode::INVALID) {
       LOG_CRITICAL("Invalid instruction {:02X}", cur_instr);
@@ -72,21 +187,20 @@ void Cpu::step(u32 cycles_to_execute) {
       return;
     }
 
-    if (m_settings.log_trace_cpu) {
-#if TRACE_MODE == TRACE_REGS  // Log all registers
-      char debug_str[512];
-      // This is ugly but much faster than a loop
-      // clang-format off
-    std::snprintf(debug_str, 512, "[%08X]: at:%X v0:%X v1:%X a0:%X a1:%X a2:%X a3:%X t0:%X t1:%X t2:%X t3:%X t4:%X t5:%X t6:%X t7:%X s0:%X s1:%X s2:%X s3:%X s4:%X s5:%X s6:%X s7:%X t8:%X t9:%X k0:%X k1:%X gp:%X ra:%X hi:%X lo:%X",
-      m_pc, m_gpr[1], m_gpr[2], m_gpr[3], m_gpr[4], m_gpr[5], m_gpr[6], m_gpr[7], m_gpr[8], m_gpr[9], m_gpr[10], m_gpr[11], m_gpr[12], m_gpr[13], m_gpr[14], m_gpr[15], m_gpr[16], m_gpr[17], m_gpr[18], m_gpr[19], m_gpr[20], m_gpr[21], m_gpr[22], m_gpr[23], m_gpr[24], m_gpr[25], m_gpr[26], m_gpr[27], m_gpr[28], m_gpr[31], m_hi, m_lo);
-      // clang-format on
-      LOG_TRACE_CPU_NOFMT(debug_str);
-#elif TRACE_MODE == TRACE_DISASM   // Log instruction disassembly
-      LOG_TRACE_CPU("[{:08X}]: {:08X} {}", m_pc, cur_instr, instr.disassemble());
-      // In PC_ONLY mode we print the PC-4 for branch delay slot instructions (to match no$psx's output)
-#elif TRACE_MODE == TRACE_PC_ONLY  // Log PC register only
-      LOG_TRACE_CPU("{:08X}", m_pc);
-#endif
+    // Uncached fetches were already charged by load32
+    m_cycles += INSTRUCTION_CYCLES[static_cast<u32>(instr.opcode())];
+    if (cached_instr)
+      m_cycles += m_bus.fetch_cycles(m_pc);
+    ++m_instructions;
+
+    if constexpr (Policy::profile) {
+      if (m_profiler.sample_due(m_cycles))
+        m_profiler.sample(m_cycles, m_pc, instr.opcode());
+    }
+
+    if constexpr (Policy::trace) {
+      execute_traced(instr, trace_cpu_regs);
+      continue;
     }
 
     // Advance PC
@@ -99,20 +213,151 @@ void Cpu::step(u32 cycles_to_execute) {
 
     do_pending_load();
 
-#ifdef LOG_BIOS_CALLS
-    if (was_branch_cycle) {
-      const auto masked_pc = m_pc_current & 0x1FFFFF;
+  }
+}
 
-      // If we jumped to a BIOS function
-      if (masked_pc == 0xA0 || masked_pc == 0xB0 || masked_pc == 0xC0)
-        on_bios_call(masked_pc);
+bool Cpu::check_breakpoints() {
+  // Misaligned PCs fault when fetched
+  if (m_pc % 4 != 0)
+    return false;
+
+  const Instruction* cached_instr = m_block_cache.fetch(m_pc);
+  const Instruction instr = cached_instr ? *cached_instr : Instruction(m_bus.read<u32>(m_pc));
+
+  MemoryAccess access;
+  const bool accesses_memory = memory_access(instr, rs(instr), access);
+
+  if (m_debugger.armed() && m_debugger.should_break(m_pc, accesses_memory ? &access : nullptr))
+    return true;
+
+  if (!m_cop0_breakpoints_armed)
+    return false;
+
+  // COP0 breakpoints, which raise a debug exception before the instruction executes
+  bool hit = false;
+
+  if ((m_cop0_dcic & DCIC_EXECUTE_ENABLED) == DCIC_EXECUTE_ENABLED &&
+      ((m_pc ^ m_cop0_bpc) & m_cop0_bpcm) == 0) {
+    m_cop0_dcic |= DCIC_HIT_ANY | DCIC_HIT_BPC;
+    hit = true;
+  }
+
+  if (accesses_memory && (m_cop0_dcic & DCIC_DATA_ENABLED) == DCIC_DATA_ENABLED &&
+      ((access.addr ^ m_cop0_bda) & m_cop0_bdam) == 0) {
+    const u32 type_enable = access.is_write ? DCIC_DATA_WRITE : DCIC_DATA_READ;
+
+    if (m_cop0_dcic & type_enable) {
+      m_cop0_dcic |= DCIC_HIT_ANY | DCIC_HIT_BDA | (access.is_write ? DCIC_HIT_BDA_WRITE : DCIC_HIT_BDA_READ);
+      hit = true;
     }
-#endif
+  }
+
+  if (hit) {
+    store_exception_state();
+    trigger_exception(ExceptionCause::Breakpoint);
+  }
+  return false;
+}
+
+void Cpu::update_cop0_breakpoints_armed() {
+  const bool execute_enabled = (m_cop0_dcic & DCIC_EXECUTE_ENABLED) == DCIC_EXECUTE_ENABLED;
+  const bool data_enabled = (m_cop0_dcic & DCIC_DATA_ENABLED) == DCIC_DATA_ENABLED &&
+                            (m_cop0_dcic & (DCIC_DATA_READ | DCIC_DATA_WRITE));
+  m_cop0_breakpoints_armed = execute_enabled || data_enabled;
+
+  // Takes effect from the next step
+  select_step_variant();
+}
+
+void Cpu::execute_traced(const Instruction& i, bool trace_regs) {
+  TraceEntry entry{ m_pc, i.word(), {}, {} };
+
+  std::array<Register, 32> gpr_before;
+  if (trace_regs)
+    gpr_before = m_gpr;
+
+  set_pc(m_pc_next);
+  execute_instruction(i);
+  do_pending_load();
+
+  if (trace_regs) {
+    u32 written_count = 0;
+    for (u8 reg = 1; reg < 32 && written_count < entry.reg_index.size(); ++reg) {
+      if (m_gpr[reg] != gpr_before[reg]) {
+        entry.reg_index[written_count] = reg;
+        entry.reg_value[written_count] = m_gpr[reg];
+        ++written_count;
+      }
+    }
+  }
+
+  m_trace.push(entry);
+}
+
+void Cpu::sideload_executable(const memory::PSEXELoadInfo& load_info) {
+  set_pc(load_info.pc);
+  m_gpr[28] = load_info.r28;
+  m_gpr[29] = load_info.r29_r30;
+  m_gpr[30] = load_info.r29_r30;
+}
+
+void Cpu::serialize(util::Serializer& s) {
+  s.value(m_gpr);
+  s.value(m_pc_current);
+  s.value(m_pc);
+  s.value(m_pc_next);
+  s.value(m_hi);
+  s.value(m_lo);
+
+  s.value(m_cop0_bpc);
+  s.value(m_cop0_bda);
+  s.value(m_cop0_jumpdest);
+  s.value(m_cop0_dcic);
+  s.value(m_cop0_bad_vaddr);
+  s.value(m_cop0_bdam);
+  s.value(m_cop0_bpcm);
+  s.value(m_cop0_status);
+  s.value(m_cop0_cause);
+  s.value(m_cop0_epc);
+
+  s.value(m_slot_current);
+  s.value(m_slot_next);
+  s.value(m_branch_flags);
+  s.value(m_interrupt_pending);
+  s.value(m_bios_call_pending);
+
+  s.value(m_cycles);
+  s.value(m_cycles_end);
+  s.value(m_instructions);
+  s.value(m_muldiv_ready_cycle);
+  s.value(m_gte_ready_cycle);
+
+  m_gte.serialize(s);
+
+  if (s.is_loading()) {
+    // Cached code was decoded from the old memory contents
+    m_block_cache.clear();
+    m_idle_loop_detector.reset();
+    update_cop0_breakpoints_armed();
   }
 }
 
 void Cpu::execute_instruction(const Instruction& i) {
-  switch (i.opcode()) {
+  // Handlers indexed by Opcode, in the same order as the enum
+  static constexpr std::array<InstructionHandler, OPCODE_COUNT> handlers = {
+#define OPCODE(mnemonic, opcode, operand1, operand2, operand3) &Cpu::execute<Opcode::mnemonic>,
+#include <cpu/opcodes.def>
+#undef OPCODE
+    &Cpu::execute<Opcode::INVALID>,
+  };
+
+  (this->*handlers[static_cast<u32>(i.opcode())])(i);
+}
+
+// Instantiated for every opcode, the switch is resolved at compile time
+template <Opcode opcode>
+void Cpu::execute(const Instruction& i) {
+  switch (opcode) {
       // Arithmetic
     case Opcode::ADD: op_add(i); break;
     case Opcode::ADDU: set_rd(i, rs(i) + rt(i)); break;
@@ -165,27 +410,27 @@ void Cpu::execute_instruction(const Instruction& i) {
     case Opcode::JAL: op_jal(i); break;
     case Opcode::JALR: op_jalr(i); break;
     case Opcode::BEQ:
-      m_in_branch_delay_slot = true;
+      m_branch_flags |= BRANCH_DELAY_SLOT;
       if (rs(i) == rt(i))
         op_branch(i);
       break;
     case Opcode::BNE:
-      m_in_branch_delay_slot = true;
+      m_branch_flags |= BRANCH_DELAY_SLOT;
       if (rs(i) != rt(i))
         op_branch(i);
       break;
     case Opcode::BGTZ:
-      m_in_branch_delay_slot = true;
+      m_branch_flags |= BRANCH_DELAY_SLOT;
       if ((s32)rs(i) > 0)
         op_branch(i);
       break;
     case Opcode::BLEZ:
-      m_in_branch_delay_slot = true;
+      m_branch_flags |= BRANCH_DELAY_SLOT;
       if ((s32)rs(i) <= 0)
         op_branch(i);
       break;
     case Opcode::BCONDZ: {
-      m_in_branch_delay_slot = true;
+      m_branch_flags |= BRANCH_DELAY_SLOT;
 
       // Format of rt is "X0000Y", where:
       // - X is set if we need to link,
@@ -208,18 +453,25 @@ void Cpu::execute_instruction(const Instruction& i) {
     case Opcode::MTC0: {
       const auto cop_dst_reg = static_cast<Cop0Register>(i.rd());
       switch (cop_dst_reg) {
-        case Cop0Register::COP0_BPC: m_cop0_bpc = rt(i); goto unhandled_mtc;
-        case Cop0Register::COP0_BDA: m_cop0_bda = rt(i); goto unhandled_mtc;
-        case Cop0Register::COP0_DCIC: m_cop0_dcic = rt(i); break;
-        case Cop0Register::COP0_BDAM: m_cop0_bdam = rt(i); goto unhandled_mtc;
-        case Cop0Register::COP0_BPCM: m_cop0_bpcm = rt(i); goto unhandled_mtc;
-        case Cop0Register::COP0_SR: m_cop0_status.word = rt(i); break;
-        case Cop0Register::COP0_CAUSE: m_cop0_cause.word = rt(i); break;
+        case Cop0Register::COP0_BPC: m_cop0_bpc = rt(i); break;
+        case Cop0Register::COP0_BDA: m_cop0_bda = rt(i); break;
+        case Cop0Register::COP0_DCIC:
+          m_cop0_dcic = rt(i);
+          update_cop0_breakpoints_armed();
+          break;
+        case Cop0Register::COP0_BDAM: m_cop0_bdam = rt(i); break;
+        case Cop0Register::COP0_BPCM: m_cop0_bpcm = rt(i); break;
+        case Cop0Register::COP0_SR:
+          m_cop0_status.word = rt(i);
+          update_interrupt_pending();
+          break;
+        case Cop0Register::COP0_CAUSE:
+          m_cop0_cause.word = rt(i);
+          update_interrupt_pending();
+          break;
         case Cop0Register::COP0_EPC:
           m_cop0_epc = rt(i);
           break;
-
-        unhandled_mtc:
         default: LOG_WARN("Unhandled Cop1 register {} write", static_cast<u32>(cop_dst_reg));
       }
       break;
@@ -227,13 +479,13 @@ void Cpu::execute_instruction(const Instruction& i) {
     case Opcode::MFC0: {
       const auto cop_dst_reg = static_cast<Cop0Register>(i.rd());
       switch (cop_dst_reg) {
-        case Cop0Register::COP0_BPC: issue_delayed_load(i.rt(), m_cop0_bpc); goto unhandled_mfc;
-        case Cop0Register::COP0_BDA: issue_delayed_load(i.rt(), m_cop0_bda); goto unhandled_mfc;
+        case Cop0Register::COP0_BPC: issue_delayed_load(i.rt(), m_cop0_bpc); break;
+        case Cop0Register::COP0_BDA: issue_delayed_load(i.rt(), m_cop0_bda); break;
         case Cop0Register::COP0_JUMPDEST: issue_delayed_load(i.rt(), m_cop0_jumpdest); break;
         case Cop0Register::COP0_DCIC: issue_delayed_load(i.rt(), m_cop0_dcic); break;
         case Cop0Register::COP0_BAD_VADDR: issue_delayed_load(i.rt(), m_cop0_bad_vaddr); break;
-        case Cop0Register::COP0_BDAM: issue_delayed_load(i.rt(), m_cop0_bdam); goto unhandled_mfc;
-        case Cop0Register::COP0_BPCM: issue_delayed_load(i.rt(), m_cop0_bpcm); goto unhandled_mfc;
+        case Cop0Register::COP0_BDAM: issue_delayed_load(i.rt(), m_cop0_bdam); break;
+        case Cop0Register::COP0_BPCM: issue_delayed_load(i.rt(), m_cop0_bpcm); break;
         case Cop0Register::COP0_SR: issue_delayed_load(i.rt(), m_cop0_status.word); break;
         case Cop0Register::COP0_CAUSE: issue_delayed_load(i.rt(), m_cop0_cause.word); break;
         case Cop0Register::COP0_EPC: issue_delayed_load(i.rt(), m_cop0_epc); break;
@@ -246,8 +498,14 @@ void Cpu::execute_instruction(const Instruction& i) {
       }
       break;
     }
-    case Opcode::MFLO: set_rd(i, m_lo); break;
-    case Opcode::MFHI: set_rd(i, m_hi); break;
+    case Opcode::MFLO:
+      stall_until(m_muldiv_ready_cycle);
+      set_rd(i, m_lo);
+      break;
+    case Opcode::MFHI:
+      stall_until(m_muldiv_ready_cycle);
+      set_rd(i, m_hi);
+      break;
     case Opcode::MTLO: m_lo = rs(i); break;
     case Opcode::MTHI: m_hi = rs(i); break;
     case Opcode::RFE:
@@ -255,6 +513,7 @@ void Cpu::execute_instruction(const Instruction& i) {
       break;
       // Co-processor 2 (Geometry Transformation Engine)
     case Opcode::MFC2: {
+      stall_until(m_gte_ready_cycle);
       auto val = m_gte.read_reg(i.rd());
       LOG_TRACE_GTE("{:<23}      | val: 0x{:08X} | 0x{:08X} at 0x{:08X}", i.disassemble(), val, i.word(),
                     m_pc_current);
@@ -262,6 +521,7 @@ void Cpu::execute_instruction(const Instruction& i) {
       break;
     }
     case Opcode::CFC2: {
+      stall_until(m_gte_ready_cycle);
       const auto val = m_gte.read_reg(i.rd() + 32);  // Add 32 because it's a Control Register
       LOG_TRACE_GTE("{:<23}      | val: 0x{:08X} | 0x{:08X} at 0x{:08X}", i.disassemble(), val, i.word(),
                     m_pc_current);
@@ -284,7 +544,8 @@ void Cpu::execute_instruction(const Instruction& i) {
       const auto dest_reg = i.rt();
       Expects(dest_reg < 64);
 
-      const auto val = m_bus.read32(addr);
+      const auto val = m_bus.read<u32>(addr);
+      m_cycles += m_bus.read_cycles(addr, 4);
 
       LOG_TRACE_GTE("{:<23}    | val: 0x{:08X} | 0x{:08X} at 0x{:08X}", i.disassemble(), val, i.word(),
                     m_pc_current);
@@ -297,14 +558,17 @@ void Cpu::execute_instruction(const Instruction& i) {
       const auto dest_reg = i.rt();
       Expects(dest_reg < 64);
 
+      stall_until(m_gte_ready_cycle);
       const auto val = m_gte.read_reg(dest_reg);
 
       LOG_TRACE_GTE("{:<23}    | val: 0x{:08X} | 0x{:08X} at 0x{:08X}", i.disassemble(), val, i.word(),
                     m_pc_current);
-      m_bus.write32(addr, val);
+      m_bus.write<u32>(addr, val);
       break;
     }
     case Opcode::COP2: {
+      stall_until(m_gte_ready_cycle);
+      m_gte_ready_cycle = m_cycles + gte::GteCommand(i.word()).cycles();
       m_gte.cmd(i.word());
       break;
     }
@@ -315,6 +579,23 @@ void Cpu::execute_instruction(const Instruction& i) {
   }
 }
 
+bool Cpu::hle_bios_call(u32 masked_pc) {
+  // A load from the caller is still pending, it lands in the middle of the BIOS code
+  if (m_slot_current.is_valid())
+    return false;
+
+  const u8 func_number = gpr(9);
+  const auto result = bios::hle::call(m_bus, masked_pc, func_number, { gpr(4), gpr(5), gpr(6), gpr(7) });
+  if (!result)
+    return false;
+
+  // Return to the caller
+  set_gpr(2, result->ret);
+  set_pc(gpr(31));
+  m_cycles += result->cycles;
+  return true;
+}
+
 void Cpu::on_bios_call(u32 masked_pc) {
   std::unordered_map<uint8_t, bios::Function>::const_iterator function;
   const u8 func_number = gpr(9);
@@ -342,39 +623,29 @@ void Cpu::on_bios_call(u32 masked_pc) {
     }
   }
 
-  if (!is_known_func) {
-    m_bios_calls_log += fmt::format("[{:08X}] {:01X}({:02X})\n", gpr(31), type, func_number);
-    return;
-  }
-
-  if (log_known_func) {
-    const bios::Function func = function->second;
-
-    const auto arg_count = func.args.size();
-    // Arguments after the 4th are passed on the stack, unimplemented
-    Ensures(arg_count <= 4);
-
-    std::string log_text =
-        fmt::format("[{:08X}] {:01X}({:02X}): {}(", gpr(31), type, func_number, func.name);
-
-    for (auto i = 0; i < arg_count; ++i) {
-      log_text += fmt::format("{}=0x{:X}{}", func.args[i], gpr(4 + i), i == (arg_count - 1) ? "" : ", ");
-    }
-    log_text += ")\n";
-
-    m_bios_calls_log += log_text;
-  }
+  // Only the raw values are stored, they're formatted by BiosLog when displayed
+  if (!is_known_func || log_known_func)
+    m_bios_log.on_call(BiosCall{ m_cycles, gpr(31), static_cast<u8>(type), func_number,
+                                 { gpr(4), gpr(5), gpr(6), gpr(7) } });
 }
 
-void Cpu::store_exception_state() {
-  // Store state that we'll need if an exception happens
-  m_pc_current = m_pc;
-  m_in_branch_delay_slot_saved = m_in_branch_delay_slot;
-  m_branch_taken_saved = m_branch_taken;
-
-  // Reset state so that we can use/set it appropriately on the current cycle
-  m_in_branch_delay_slot = false;
-  m_branch_taken = false;
+bool Cpu::interpret_from_native(const Instruction& i) {
+  // Copied, as executing it might invalidate its block
+  const Instruction instr = i;
+  const auto invalidation_count = m_block_cache.invalidation_count();
+  const auto pc_next = m_pc_next;
+
+  // Same as the interpreter loop, minus what native code never needs (see Recompiler::translate)
+  store_exception_state();
+  m_cycles += INSTRUCTION_CYCLES[static_cast<u32>(instr.opcode())] + m_bus.fetch_cycles(m_pc);
+  set_pc(m_pc_next);
+  execute_instruction(instr);
+  do_pending_load();
+
+  // Stop on exceptions, if an interrupt got enabled, if the running block was modified, or at the end of
+  // the step
+  return m_pc != pc_next || m_interrupt_pending ||
+         m_block_cache.invalidation_count() != invalidation_count || m_cycles >= m_cycles_end;
 }
 
 void Cpu::trigger_exception(ExceptionCause cause) {
@@ -408,11 +679,11 @@ void Cpu::trigger_exception(ExceptionCause cause) {
   else
     m_cop0_epc = m_pc_current;  // on everything else, the instruction that caused the exception
 
-  if (m_in_branch_delay_slot_saved) {
+  if (m_branch_flags & BRANCH_DELAY_SLOT_SAVED) {
     m_cop0_epc -= 4;  // need to set this to the branch instruction if we're in a branch delay slot
     m_cop0_cause.branch_delay = true;  // also set this CAUSE bit which indicates this edge case
 
-    if (m_branch_taken_saved)
+    if (m_branch_flags & BRANCH_TAKEN_SAVED)
       m_cop0_cause.branch_delay_taken = true;  // Another edge case, if the branch was actually taken
 
     m_cop0_jumpdest = m_pc;  // Update JUMPDEST
@@ -421,10 +692,17 @@ void Cpu::trigger_exception(ExceptionCause cause) {
   if (cause == ExceptionCause::Breakpoint)
     m_cop0_dcic |= 1;
 
+  // Interrupts got disabled
+  update_interrupt_pending();
+
   // Exceptions don't have a branch delay, jump directly to the handler
   set_pc(handler_addr);
 }
 
+void Cpu::update_interrupt_pending() {
+  m_interrupt_pending = m_bus.m_interrupts.check();
+}
+
 void Cpu::trigger_load_exception(const address addr) {
   m_cop0_bad_vaddr = addr;
   trigger_exception(ExceptionCause::LoadAddressError);
@@ -603,14 +881,14 @@ void Cpu::op_lwr(const Instruction& i) {
 }
 
 void Cpu::op_j(const Instruction& i) {
-  m_in_branch_delay_slot = true;
+  m_branch_flags |= BRANCH_DELAY_SLOT;
   const address addr = m_pc_next & 0xF0000000 | (i.imm26() << 2);
 
   set_pc_next(addr);
 }
 
 void Cpu::op_jr(const Instruction& i) {
-  m_in_branch_delay_slot = true;
+  m_branch_flags |= BRANCH_DELAY_SLOT;
   const address addr = rs(i);
 
   if (addr % 4 != 0) {
@@ -619,6 +897,9 @@ void Cpu::op_jr(const Instruction& i) {
   }
   set_pc_next(addr);
 
+  if (m_profiling && i.rs() == 31)
+    m_profiler.on_return(addr);
+
 #if LOG_TTY_OUTPUT_WITH_HOOK
   // Hook std_out_putchar function in the B0 kernel table. Assumes there's an ADDIU/"LI" instruction
   // right after the JR, containing the kernel procedure vector.
@@ -630,25 +911,26 @@ void Cpu::op_jr(const Instruction& i) {
     Ensures(next_instr.opcode() == Opcode::ADDIU);
 
     if (next_instr.imm16_se() == 0x3D) {
-      char tty_out_char = gpr(4);
-      m_tty_out += tty_out_char;
-      //          std::cout << tty_out_char;
+      m_bios_log.on_tty_output(m_cycles, static_cast<char>(gpr(4)));
     }
   }
 #endif
 }
 
 void Cpu::op_jal(const Instruction& i) {
-  m_in_branch_delay_slot = true;
+  m_branch_flags |= BRANCH_DELAY_SLOT;
 
   gpr(31) = m_pc_next;
   const address addr = m_pc_next & 0xF0000000 | (i.imm26() << 2);
 
   set_pc_next(addr);
+
+  if (m_profiling)
+    m_profiler.on_call(addr, gpr(31));
 }
 
 void Cpu::op_jalr(const Instruction& i) {
-  m_in_branch_delay_slot = true;
+  m_branch_flags |= BRANCH_DELAY_SLOT;
 
   const address addr = rs(i);
   set_rd(i, m_pc_next);
@@ -658,9 +940,15 @@ void Cpu::op_jalr(const Instruction& i) {
     return;
   }
   set_pc_next(addr);
+
+  if (m_profiling && i.rd() == 31)
+    m_profiler.on_call(addr, gpr(31));
 }
 
 void Cpu::op_mult(const Instruction& i) {
+  stall_until(m_muldiv_ready_cycle);
+  m_muldiv_ready_cycle = m_cycles + mult_cycles(rs(i), true);
+
   const auto a = (s64)(s32)rs(i);
   const auto b = (s64)(s32)rt(i);
   const auto result = (u64)(a * b);
@@ -670,6 +958,9 @@ void Cpu::op_mult(const Instruction& i) {
 }
 
 void Cpu::op_multu(const Instruction& i) {
+  stall_until(m_muldiv_ready_cycle);
+  m_muldiv_ready_cycle = m_cycles + mult_cycles(rs(i), false);
+
   const auto result = (u64)rs(i) * (u64)rt(i);
   m_hi = result >> 32;
   m_lo = (u32)result;
@@ -682,6 +973,9 @@ void Cpu::op_branch(const Instruction& i) {
 }
 
 void Cpu::op_udiv(const Instruction& i) {
+  stall_until(m_muldiv_ready_cycle);
+  m_muldiv_ready_cycle = m_cycles + DIV_CYCLES;
+
   const u32 numerator = rs(i);
   const u32 denominator = rt(i);
 
@@ -695,6 +989,9 @@ void Cpu::op_udiv(const Instruction& i) {
 }
 
 void Cpu::op_sdiv(const Instruction& i) {
+  stall_until(m_muldiv_ready_cycle);
+  m_muldiv_ready_cycle = m_cycles + DIV_CYCLES;
+
   const s32 numerator = rs(i);
   const s32 denominator = rt(i);
 
@@ -731,6 +1028,7 @@ void Cpu::op_rfe(const Instruction& i) {
   // Restore the mode before the exception by shifting the Interrupt Enable / User Mode stack back to its
   // original position.
   m_cop0_status.word = (m_cop0_status.word & ~0b1111u) | ((m_cop0_status.word >> 2) & 0xF);
+  update_interrupt_pending();
 }
 
 bool Cpu::checked_add(u32 op1, u32 op2, u32& out) {
@@ -758,7 +1056,8 @@ bool Cpu::load32(u32 addr, u32& out_val) {
     trigger_load_exception(addr);
     return false;
   }
-  out_val = m_bus.read32(addr);
+  out_val = m_bus.read<u32>(addr);
+  m_cycles += m_bus.read_cycles(addr, 4);
   return true;
 }
 
@@ -767,12 +1066,14 @@ bool Cpu::load16(u32 addr, u16& out_val) {
     trigger_load_exception(addr);
     return false;
   }
-  out_val = m_bus.read16(addr);
+  out_val = m_bus.read<u16>(addr);
+  m_cycles += m_bus.read_cycles(addr, 2);
   return true;
 }
 
 void Cpu::load8(u32 addr, u8& out_val) {
-  out_val = m_bus.read8(addr);
+  out_val = m_bus.read<u8>(addr);
+  m_cycles += m_bus.read_cycles(addr, 1);
 }
 
 void Cpu::store32(u32 addr, u32 val) {
@@ -784,7 +1085,7 @@ void Cpu::store32(u32 addr, u32 val) {
     LOG_TRACE("Ignoring write 0x{:08X} to 0x{:08X} due to cache isolation", val, addr);
     return;
   }
-  m_bus.write32(addr, val);
+  m_bus.write<u32>(addr, val);
 }
 
 void Cpu::store16(u32 addr, u16 val) {
@@ -796,7 +1097,7 @@ void Cpu::store16(u32 addr, u16 val) {
     LOG_TRACE("Ignoring write 0x{:04X} to 0x{:08X} due to cache isolation", val, addr);
     return;
   }
-  m_bus.write16(addr, val);
+  m_bus.write<u16>(addr, val);
 }
 
 void Cpu::store8(u32 addr, u8 val) {
@@ -804,7 +1105,7 @@ void Cpu::store8(u32 addr, u8 val) {
     LOG_TRACE("Ignoring write 0x{:02X} to 0x{:08X} due to cache isolation", val, addr);
     return;
   }
-  m_bus.write8(addr, val);
+  m_bus.write<u8>(addr, val);
 }
 
 void Cpu::issue_delayed_load(RegisterIndex reg, u32 val) {
@@ -817,7 +1118,7 @@ void Cpu::issue_delayed_load(RegisterIndex reg, u32 val) {
   m_slot_next.val_prev = gpr(reg);
 }
 
-void Cpu::do_pending_load() {
+void Cpu::apply_pending_load() {
   if (m_slot_current.is_valid()) {
     const auto cur_reg = m_slot_current.reg;
 
@@ -1,12 +1,22 @@
 #pragma once
 
+#include <cpu/bios_log.hpp>
+#include <cpu/block_cache.hpp>
+#include <cpu/debugger.hpp>
 #include <cpu/gte.hpp>
+#include <cpu/idle_loop_detector.hpp>
 #include <cpu/instruction.hpp>
+#include <cpu/profiler.hpp>
+#include <cpu/recompiler.hpp>
+#include <cpu/trace.hpp>
+#include <util/serializer.hpp>
 #include <util/types.hpp>
 
 #include <gsl-lite.hpp>
 
+#include <algorithm>
 #include <array>
+#include <utility>
 
 namespace gui {
 class Gui;
@@ -22,16 +32,44 @@ class Instruction;
 
 namespace emulator {
 struct Settings;
+class LockstepChecker;
 }
 
-#define LOG_TTY_OUTPUT_WITH_HOOK false  // No need to enable this if LOG_BIOS_CALLS is enabled
-#define LOG_BIOS_CALLS true             // If enabled, TTY output is logged anyways
+namespace memory {
+struct PSEXELoadInfo;
+}
 
-namespace cpu {
+#define LOG_TTY_OUTPUT_WITH_HOOK false  // No need to enable this if BIOS calls are logged (see Settings)
 
-constexpr u32 APPROX_CYCLES_PER_INSTRUCTION = 2;
+namespace cpu {
 
 constexpr auto PC_RESET_ADDR = 0xBFC00000u;
+constexpr auto BIOS_SHELL_ENTRY_ADDR = 0x80030000u;  // The BIOS jumps here once the kernel is set up
+
+// Whether addr is the entry point of one of the BIOS function tables (A0, B0 or C0), in RAM
+constexpr bool is_bios_function_vector(address addr) {
+  const auto masked_addr = addr & 0x1FFFFFFF;
+  return masked_addr == 0xA0 || masked_addr == 0xB0 || masked_addr == 0xC0;
+}
+
+// Diagnostics compiled into a Cpu::step variant. Variants without them carry no checks for them.
+template <bool Debug, bool Trace, bool Profile, bool BiosLog, bool ExeHook, bool Lockstep>
+struct StepPolicy {
+  static constexpr bool debug = Debug;       // Check breakpoints and watchpoints (see Debugger)
+  static constexpr bool trace = Trace;       // Record executed instructions (see TraceBuffer)
+  static constexpr bool profile = Profile;   // Sample guest code (see Profiler)
+  static constexpr bool bios_log = BiosLog;  // Log BIOS function calls
+  static constexpr bool exe_hook = ExeHook;  // Stop at BIOS_SHELL_ENTRY_ADDR
+  static constexpr bool lockstep = Lockstep;  // Return after each block (see emulator::LockstepChecker)
+};
+
+// Branch delay state of the current instruction (and the previous one, saved for exceptions)
+enum BranchFlags : u8 {
+  BRANCH_DELAY_SLOT = 1 << 0,        // Instruction is a branch/jump, the next one is in its delay slot
+  BRANCH_TAKEN = 1 << 1,             // Instruction is a taken branch/jump
+  BRANCH_DELAY_SLOT_SAVED = 1 << 2,  // Same as above for the previous instruction
+  BRANCH_TAKEN_SAVED = 1 << 3,
+};
 
 // Co-processor 0 registers
 enum class Cop0Register : u32 {
@@ -85,25 +123,91 @@ enum class ExceptionCause : u8 {
 class Cpu {
   friend class Interrupts;
   friend class gui::Gui;  // for debug info
+  friend class Recompiler;
+  friend class AotCache;
+  friend class IdleLoopDetector;
+  friend class emulator::LockstepChecker;
 
  public:
   explicit Cpu(bus::Bus& bus, const emulator::Settings& settings);
 
-  void step(u32 cycles_to_execute);
+  // Runs until cycles() reaches cycles_end, usually the next Scheduler deadline. Instructions aren't
+  // split, so a step can overshoot, in which case the next one is shorter. Returns early if a breakpoint
+  // pauses execution.
+  void step(u64 cycles_end);
+  // Makes the current step end once cycles() reaches cycle, if it was going to run past it. Called when
+  // something is scheduled while the Cpu runs.
+  void end_step_by(u64 cycle) {
+    if (cycle < m_cycles_end)
+      m_cycles_end = std::max(cycle, m_cycles);
+  }
 
   bus::Bus& bus() const { return m_bus; }
+  u64 cycles() const { return m_cycles; }
+
+  // Picks the step() variant with the diagnostics currently enabled in Settings (or needed by the
+  // debugger), called at frame boundaries
+  void select_step_variant();
+
+  // Makes the next step() that reaches BIOS_SHELL_ENTRY_ADDR return before executing it
+  void stop_at_shell_entry() {
+    m_stop_at_shell_entry = true;
+    select_step_variant();
+  }
+  // Whether the last step() returned early because of the above
+  bool reached_shell_entry() const { return m_reached_shell_entry; }
+  // Makes step() return after each block (or each instruction, when interpreting), so that it can be
+  // checked against another Cpu (see emulator::LockstepChecker)
+  void set_lockstep(bool lockstep) {
+    m_lockstep = lockstep;
+    select_step_variant();
+  }
+  // Jumps to a PS-X EXE loaded to RAM instead of the shell, call when reached_shell_entry()
+  void sideload_executable(const memory::PSEXELoadInfo& load_info);
+  // Loads code translated ahead of time by tools/aot_recompiler, used by the Recompiler engine
+  bool load_aot_module(const fs::path& module_path) { return m_recompiler.load_aot_module(module_path); }
+
+  void serialize(util::Serializer& s);
+
+  TraceBuffer& trace() { return m_trace; }
+  Profiler& profiler() { return m_profiler; }
+  Debugger& debugger() { return m_debugger; }
+  const Profiler& profiler() const { return m_profiler; }
 
   // Debug UI fields
-  std::string m_tty_out_log;
-  std::string m_bios_calls_log;
+  BiosLog m_bios_log;
 
  private:
+  using InstructionHandler = void (Cpu::*)(const Instruction& i);
+  using StepVariant = void (Cpu::*)(u64 cycles_end);
+
+  template <typename Policy>
+  void step(u64 cycles_end);
+  template <size_t... Indices>
+  static constexpr std::array<StepVariant, sizeof...(Indices)> make_step_variants(
+      std::index_sequence<Indices...>);
+  bool check_breakpoints();  // Returns true if execution should pause
+  void update_cop0_breakpoints_armed();  // Called when DCIC changes
+
   void execute_instruction(const Instruction& i);
+  void execute_traced(const Instruction& i, bool trace_regs);  // Also records it to m_trace
+  template <Opcode opcode>
+  void execute(const Instruction& i);
+  bool interpret_from_native(const Instruction& i);  // Returns true if native code should stop
   void on_bios_call(u32 masked_pc);
+  bool hle_bios_call(u32 masked_pc);  // Returns true if the function was run natively
 
   // Exceptions
-  void store_exception_state();
+  void store_exception_state() {
+    // Store state that we'll need if an exception happens
+    m_pc_current = m_pc;
+
+    // The current flags become the saved ones, and are reset so that the current instruction can set
+    // them
+    m_branch_flags = (m_branch_flags & (BRANCH_DELAY_SLOT | BRANCH_TAKEN)) << 2;
+  }
   void trigger_exception(ExceptionCause cause);
+  void update_interrupt_pending();  // Called when I_STAT, I_MASK, COP0 SR or CAUSE change
   void trigger_load_exception(const address addr);
   void trigger_store_exception(const address addr);
 
@@ -171,7 +275,9 @@ class Cpu {
 
   void set_pc_next(address addr) {
     m_pc_next = addr;
-    m_branch_taken = true;
+    m_branch_flags |= BRANCH_TAKEN;
+    if (is_bios_function_vector(addr))
+      m_bios_call_pending = true;
   }
 
   // Instruction operand register getters
@@ -219,7 +325,12 @@ class Cpu {
 
   // Load delay emulation
   void issue_delayed_load(RegisterIndex reg, u32 val);
-  void do_pending_load();
+  void do_pending_load() {
+    // Nothing to do unless the current or previous instruction issued a load
+    if (m_slot_current.is_valid() || m_slot_next.is_valid())
+      apply_pending_load();
+  }
+  void apply_pending_load();
   void invalidate_reg(RegisterIndex r);
 
   struct DelayedLoad {
@@ -234,10 +345,28 @@ class Cpu {
   DelayedLoad m_slot_next{};
 
   // Exceptions
-  bool m_branch_taken{};
-  bool m_branch_taken_saved{};
-  bool m_in_branch_delay_slot{};
-  bool m_in_branch_delay_slot_saved{};
+  u8 m_branch_flags{};         // See BranchFlags
+  bool m_interrupt_pending{};  // An enabled interrupt is pending, the next instruction traps (see
+                               // Interrupts::check)
+  bool m_bios_call_pending{};  // A branch/jump to a BIOS function vector was taken
+  bool m_native_exit_pending{};  // Native code has to leave its block after the current access (see
+                                 // Recompiler::fastmem_write)
+
+  bool m_stop_at_shell_entry{};
+  bool m_lockstep{};
+  bool m_reached_shell_entry{};
+
+  // Timing (see cycles.hpp)
+  void stall_until(u64 cycle) {
+    if (m_cycles < cycle)
+      m_cycles = cycle;
+  }
+
+  u64 m_cycles{};              // Cycles elapsed since reset
+  u64 m_cycles_end{};          // Cycle the current step ends at
+  u64 m_instructions{};        // Instructions executed since reset
+  u64 m_muldiv_ready_cycle{};  // Cycle the results of the last MULT/DIV are ready in HI/LO at
+  u64 m_gte_ready_cycle{};     // Cycle the results of the last GTE command are ready at
 
   //  #ifndef NDEBUG
   //  // For debugging
@@ -246,6 +375,18 @@ class Cpu {
 
   cpu::gte::Gte m_gte;
 
+  BlockCache m_block_cache;
+  Recompiler m_recompiler;
+  IdleLoopDetector m_idle_loop_detector;
+  TraceBuffer m_trace;
+  Profiler m_profiler;
+  Debugger m_debugger;
+  bool m_cop0_breakpoints_armed{};  // DCIC enables execution or data breakpoints
+
+  // See select_step_variant. No diagnostics until the settings are read, they aren't initialized yet.
+  StepVariant m_step_variant{ &Cpu::step<StepPolicy<false, false, false, false, false, false>> };
+  bool m_profiling{};  // Settings::profile_cpu for the current step, for call/return tracking
+
   // References
 
   bus::Bus& m_bus;
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cpu/opcode.hpp>
+#include <util/types.hpp>
+
+#include <array>
+
+// Cpu timing, in Cpu (system) clock cycles.
+// Every instruction is issued in a single cycle. On top of that, memory accesses take as long as the
+// region they target needs (see bus::AccessTimings), and reading the results of MULT/DIV and GTE
+// commands stalls until they're ready.
+
+namespace cpu {
+
+// Cycles it takes to issue each instruction, excluding memory accesses and interlock stalls. The
+// pipeline issues everything in a single cycle.
+inline constexpr auto INSTRUCTION_CYCLES = [] {
+  std::array<u8, OPCODE_COUNT> table{};
+  for (auto& cycles : table)
+    cycles = 1;
+  return table;
+}();
+
+// Cycles until the results of DIV/DIVU are ready in HI/LO
+constexpr u32 DIV_CYCLES = 36;
+
+// Cycles until the results of MULT/MULTU are ready in HI/LO, which depends on the magnitude of rs
+constexpr u32 mult_cycles(u32 rs, bool is_signed) {
+  // Signed operands take as long as their absolute value would
+  if (is_signed && static_cast<s32>(rs) < 0)
+    rs = ~rs;
+
+  if (rs < 0x800)
+    return 6;
+  if (rs < 0x100000)
+    return 9;
+  return 13;
+}
+
+}  // namespace cpu
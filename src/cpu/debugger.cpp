@@ -0,0 +1,120 @@
+#include <cpu/debugger.hpp>
+
+#include <cpu/opcode.hpp>
+#include <memory/map.hpp>
+#include <util/log.hpp>
+
+#include <algorithm>
+
+namespace cpu {
+
+// The same memory is visible at several addresses: through KUSEG, KSEG0 and KSEG1, and through the RAM
+// mirrors. Addresses are compared as the one they all map to.
+static address canonical_address(address addr) {
+  const auto phys_addr = memory::mask_region(addr);
+  if (phys_addr < memory::map::RAM_MIRRORS.start() + memory::map::RAM_MIRRORS.size())
+    return phys_addr & (memory::RAM_SIZE - 1);
+  return phys_addr;
+}
+
+bool memory_access(const Instruction& i, Register base, MemoryAccess& out_access) {
+  const address addr = base + i.imm16_se();
+
+  switch (i.opcode()) {
+    case Opcode::LB:
+    case Opcode::LBU: out_access = { addr, 1, false }; return true;
+    case Opcode::LH:
+    case Opcode::LHU: out_access = { addr, 2, false }; return true;
+    case Opcode::LW:
+    case Opcode::LWC2: out_access = { addr, 4, false }; return true;
+    case Opcode::LWL:
+    case Opcode::LWR: out_access = { addr & ~3u, 4, false }; return true;
+    case Opcode::SB: out_access = { addr, 1, true }; return true;
+    case Opcode::SH: out_access = { addr, 2, true }; return true;
+    case Opcode::SW:
+    case Opcode::SWC2: out_access = { addr, 4, true }; return true;
+    // Unaligned stores read-modify-write the aligned word
+    case Opcode::SWL:
+    case Opcode::SWR: out_access = { addr & ~3u, 4, true }; return true;
+    default: return false;
+  }
+}
+
+bool Debugger::should_break(address pc, const MemoryAccess* access) {
+  if (m_resuming) {
+    m_resuming = false;
+    return false;
+  }
+
+  const auto pc_addr = canonical_address(pc);
+  for (const auto& bp : m_breakpoints) {
+    if (bp.enabled && canonical_address(bp.addr) == pc_addr) {
+      m_paused = true;
+      m_pause_reason = fmt::format("Breakpoint at 0x{:08X}", pc);
+      return true;
+    }
+  }
+
+  if (!access)
+    return false;
+
+  const auto access_addr = canonical_address(access->addr);
+  for (const auto& wp : m_watchpoints) {
+    const auto wp_addr = canonical_address(wp.addr);
+    const bool type_matches = access->is_write ? wp.on_write : wp.on_read;
+    const bool overlaps = access_addr < wp_addr + wp.size && wp_addr < access_addr + access->size;
+
+    if (wp.enabled && type_matches && overlaps) {
+      m_paused = true;
+      m_pause_reason = fmt::format("{}-bit {} of 0x{:08X} at 0x{:08X}", access->size * 8,
+                                   access->is_write ? "write" : "read", access->addr, pc);
+      return true;
+    }
+  }
+  return false;
+}
+
+void Debugger::add_breakpoint(address addr) {
+  m_breakpoints.push_back({ addr, true });
+  on_changed();
+}
+
+void Debugger::add_watchpoint(address addr, u32 size, bool on_read, bool on_write) {
+  m_watchpoints.push_back({ addr, size, on_read, on_write, true });
+  on_changed();
+}
+
+void Debugger::remove_breakpoint(size_t index) {
+  m_breakpoints.erase(m_breakpoints.begin() + index);
+  on_changed();
+}
+
+void Debugger::remove_watchpoint(size_t index) {
+  m_watchpoints.erase(m_watchpoints.begin() + index);
+  on_changed();
+}
+
+void Debugger::on_changed() {
+  m_armed = std::any_of(m_breakpoints.begin(), m_breakpoints.end(),
+                        [](const Breakpoint& bp) { return bp.enabled; }) ||
+            std::any_of(m_watchpoints.begin(), m_watchpoints.end(),
+                        [](const Watchpoint& wp) { return wp.enabled && (wp.on_read || wp.on_write); });
+
+  // Nothing could have paused us now
+  if (!m_armed) {
+    m_paused = false;
+    m_resuming = false;
+    m_pause_reason.clear();
+  }
+}
+
+void Debugger::resume() {
+  if (!m_paused)
+    return;
+
+  m_paused = false;
+  m_resuming = true;
+  m_pause_reason.clear();
+}
+
+}  // namespace cpu
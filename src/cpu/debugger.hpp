@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cpu/instruction.hpp>
+#include <util/types.hpp>
+
+#include <string>
+#include <vector>
+
+namespace cpu {
+
+// DCIC (COP0 breakpoint control) bits
+enum DcicBits : u32 {
+  DCIC_HIT_ANY = 1 << 0,         // Set on any break
+  DCIC_HIT_BPC = 1 << 1,         // Set on an execution break
+  DCIC_HIT_BDA = 1 << 2,         // Set on a data access break
+  DCIC_HIT_BDA_READ = 1 << 3,    // Set on a data read break
+  DCIC_HIT_BDA_WRITE = 1 << 4,   // Set on a data write break
+  DCIC_SUPER_MASTER_1 = 1 << 23,
+  DCIC_EXECUTE = 1 << 24,        // Break on execution of BPC (masked by BPCM)
+  DCIC_DATA = 1 << 25,           // Break on accesses to BDA (masked by BDAM)
+  DCIC_DATA_READ = 1 << 26,
+  DCIC_DATA_WRITE = 1 << 27,
+  DCIC_MASTER = 1 << 30,
+  DCIC_SUPER_MASTER_2 = 1u << 31,
+
+  DCIC_EXECUTE_ENABLED = DCIC_SUPER_MASTER_1 | DCIC_EXECUTE | DCIC_MASTER | DCIC_SUPER_MASTER_2,
+  DCIC_DATA_ENABLED = DCIC_SUPER_MASTER_1 | DCIC_DATA | DCIC_MASTER | DCIC_SUPER_MASTER_2,
+};
+
+// A memory access made by a load/store instruction
+struct MemoryAccess {
+  address addr;
+  u32 size;
+  bool is_write;
+};
+
+// The access instruction i will make, given the value of its base register. Returns false if it isn't a
+// load/store.
+bool memory_access(const Instruction& i, Register base, MemoryAccess& out_access);
+
+struct Breakpoint {
+  address addr;
+  bool enabled;
+};
+
+struct Watchpoint {
+  address addr;
+  u32 size;  // Bytes watched, starting at addr
+  bool on_read;
+  bool on_write;
+  bool enabled;
+};
+
+// Breakpoints and watchpoints set from the GUI, which pause emulation when hit. COP0 hardware
+// breakpoints are handled by the Cpu, which raises exceptions for them instead.
+// Checking them needs the debug variant of Cpu::step, which is only used while armed() (or while COP0
+// breakpoints are enabled).
+class Debugger {
+ public:
+  // Emulation side
+  bool armed() const { return m_armed; }
+  bool paused() const { return m_paused; }
+  // Returns true if execution should pause before the instruction at pc, which will make access (if
+  // non-null)
+  bool should_break(address pc, const MemoryAccess* access);
+
+  // GUI side
+  void add_breakpoint(address addr);
+  void add_watchpoint(address addr, u32 size, bool on_read, bool on_write);
+  void remove_breakpoint(size_t index);
+  void remove_watchpoint(size_t index);
+  std::vector<Breakpoint>& breakpoints() { return m_breakpoints; }
+  std::vector<Watchpoint>& watchpoints() { return m_watchpoints; }
+  void on_changed();  // Call after editing breakpoints()/watchpoints() directly
+  void resume();
+  const std::string& pause_reason() const { return m_pause_reason; }
+
+ private:
+  std::vector<Breakpoint> m_breakpoints;
+  std::vector<Watchpoint> m_watchpoints;
+  bool m_armed{};  // Any breakpoint/watchpoint enabled
+
+  bool m_paused{};
+  bool m_resuming{};  // Don't break again on the instruction that we paused on
+  std::string m_pause_reason;
+};
+
+}  // namespace cpu
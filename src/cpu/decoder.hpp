@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cpu/opcode.hpp>
+#include <util/types.hpp>
+
+#include <array>
+
+// Compile-time decode tables generated from opcodes.def.
+// An instruction is decoded with a lookup on bits [31:21] (primary opcode and co-processor opcode fields),
+// and a second lookup on the secondary opcode field for SPECIAL instructions.
+
+namespace cpu {
+namespace decoder {
+
+constexpr u32 PRIMARY_TABLE_SIZE = 1 << 11;  // Indexed by bits [31:21]
+constexpr u32 SPECIAL_TABLE_SIZE = 1 << 6;   // Indexed by bits [5:0]
+
+// Decodes everything that's determined by bits [31:21] of the instruction (see Instruction::op_cop)
+constexpr Opcode decode_primary(u16 op_cop) {
+  const u8 primary_opcode = op_cop >> 5;
+  const bool is_cop_instr = op_cop >> 9 & 1;
+
+  // Disable formattinig to keep macro defs in a single line for brevity
+  // clang-format off
+
+  if (is_cop_instr) {  // Co-processor insruction
+    // COP2 commands have bit 25 set
+    if (op_cop >> 4 == 0b0100101)
+      return Opcode::COP2;
+
+    switch (op_cop) {
+#define OPCODE_COP(mnemonic, opcode, operand1, operand2, operand3) \
+  case opcode: return Opcode::mnemonic;
+#include <cpu/opcodes.def>
+#undef OPCODE_COP
+      default: break;  // LWC/SWC instructions use the primary encoding
+    }
+  }
+
+  if (primary_opcode == 0)
+    return Opcode::SPECIAL;
+
+  switch (primary_opcode) {
+#define OPCODE_PRIM(mnemonic, opcode, operand1, operand2, operand3) \
+  case opcode: return Opcode::mnemonic;
+#include <cpu/opcodes.def>
+#undef OPCODE_PRIM
+    default: return Opcode::INVALID;
+  }
+  // clang-format on
+}
+
+// Decodes SPECIAL instructions by their secondary opcode field
+constexpr Opcode decode_special(u8 op_sec) {
+  // clang-format off
+  switch (op_sec) {
+#define OPCODE_SEC(mnemonic, opcode, operand1, operand2, operand3) \
+  case opcode: return Opcode::mnemonic;
+#include <cpu/opcodes.def>
+#undef OPCODE_SEC
+    default: return Opcode::INVALID;
+  }
+  // clang-format on
+}
+
+template <u32 Size, typename DecodeFunction>
+constexpr std::array<Opcode, Size> make_table(DecodeFunction decode) {
+  std::array<Opcode, Size> table{};
+  for (u32 i = 0; i < Size; ++i)
+    table[i] = decode(i);
+  return table;
+}
+
+inline constexpr auto PRIMARY_TABLE =
+    make_table<PRIMARY_TABLE_SIZE>([](u32 i) { return decode_primary(static_cast<u16>(i)); });
+inline constexpr auto SPECIAL_TABLE =
+    make_table<SPECIAL_TABLE_SIZE>([](u32 i) { return decode_special(static_cast<u8>(i)); });
+
+constexpr Opcode decode(u32 word) {
+  const auto opcode = PRIMARY_TABLE[word >> 21];
+  return opcode == Opcode::SPECIAL ? SPECIAL_TABLE[word & 0x3F] : opcode;
+}
+
+}  // namespace decoder
+}  // namespace cpu
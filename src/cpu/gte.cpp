@@ -95,6 +95,37 @@ u32 Gte::read_reg(u32 src_reg) {
   return 0;
 }
 
+void Gte::serialize(util::Serializer& s) {
+  // Data Registers
+  s.value(v);
+  s.value(rgbc);
+  s.value(avg_z);
+  s.value(ir);
+  s.value(s_xy);
+  s.value(s_z);
+  s.value(rgb_fifo);
+  s.value(res);
+  s.value(mac);
+  s.value(rgb_conv);
+  s.value(lzcs);
+  s.value(lzcr);
+
+  // Control Registers
+  s.value(rot_mat);
+  s.value(trans_vec);
+  s.value(light_mat);
+  s.value(bg_col);
+  s.value(light_col_src_mat);
+  s.value(far_color);
+  s.value(screen_offset);
+  s.value(h);
+  s.value(dqa);
+  s.value(dqb);
+  s.value(zsf3);
+  s.value(zsf4);
+  s.value(flag);
+}
+
 void Gte::write_reg(u32 dest_reg, u32 val) {
   switch (dest_reg) {
       // Data Registers
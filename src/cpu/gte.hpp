@@ -3,6 +3,7 @@
 #include <glm/mat3x3.hpp>
 #include <glm/vec3.hpp>
 #include <gsl-lite.hpp>
+#include <util/serializer.hpp>
 #include <util/types.hpp>
 
 #include <array>
@@ -59,6 +60,8 @@ class Gte {
   void write_reg(u32 dest_reg, u32 val);
   void cmd(u32 word);
 
+  void serialize(util::Serializer& s);
+
  private:
   union FlagRegister {
     enum {
@@ -301,6 +304,35 @@ union GteCommand {
       default: return "<invalid>";
     }
   }
+
+  // Cycles until the command's results are ready
+  u32 cycles() const {
+    switch (_opcode) {
+      case RTPS: return 15;
+      case NCLIP: return 8;
+      case OP: return 6;
+      case DPCS: return 8;
+      case INTPL: return 8;
+      case MVMVA: return 8;
+      case NCDS: return 19;
+      case CDP: return 13;
+      case NCDT: return 44;
+      case NCCS: return 17;
+      case CC: return 11;
+      case NCS: return 14;
+      case NCT: return 30;
+      case SQR: return 5;
+      case DCPL: return 8;
+      case DPCT: return 17;
+      case AVSZ3: return 5;
+      case AVSZ4: return 6;
+      case RTPT: return 23;
+      case GPF: return 5;
+      case GPL: return 5;
+      case NCCT: return 39;
+      default: return 1;
+    }
+  }
 };
 
 static const char* reg_to_str(u8 reg_idx) {
@@ -0,0 +1,221 @@
+#include <cpu/idle_loop_detector.hpp>
+
+#include <cpu/cpu.hpp>
+#include <cpu/opcode.hpp>
+#include <memory/map.hpp>
+
+namespace cpu {
+
+// Loads that can appear in idle loops
+static bool is_load(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::LB:
+    case Opcode::LBU:
+    case Opcode::LH:
+    case Opcode::LHU:
+    case Opcode::LW: return true;
+    default: return false;
+  }
+}
+
+// Register an instruction without side effects writes to (0 if none)
+static RegisterIndex destination_reg(const Instruction& i) {
+  switch (i.opcode()) {
+    case Opcode::ADD:
+    case Opcode::ADDU:
+    case Opcode::SUB:
+    case Opcode::SUBU:
+    case Opcode::AND:
+    case Opcode::OR:
+    case Opcode::XOR:
+    case Opcode::NOR:
+    case Opcode::SLT:
+    case Opcode::SLTU:
+    case Opcode::SLL:
+    case Opcode::SRL:
+    case Opcode::SRA:
+    case Opcode::SLLV:
+    case Opcode::SRLV:
+    case Opcode::SRAV:
+    case Opcode::MFHI:
+    case Opcode::MFLO: return i.rd();
+    case Opcode::ADDI:
+    case Opcode::ADDIU:
+    case Opcode::ANDI:
+    case Opcode::ORI:
+    case Opcode::XORI:
+    case Opcode::SLTI:
+    case Opcode::SLTIU:
+    case Opcode::LUI: return i.rt();
+    case Opcode::BCONDZ: return ((i.rt() & 0x1E) == 0x10) ? 31 : 0;
+    default: return is_load(i.opcode()) ? i.rt() : 0;
+  }
+}
+
+// Whether reading addr always returns the same value (and doesn't change anything) while the Cpu is
+// running
+static bool is_invariant_address(address addr) {
+  using namespace memory;
+
+  const auto phys_addr = mask_region(addr);
+  address addr_rebased;
+
+  if (map::RAM.contains(phys_addr, addr_rebased) || map::SCRATCHPAD.contains(phys_addr, addr_rebased) ||
+      map::BIOS.contains(phys_addr, addr_rebased) || map::IRQ_CONTROL.contains(phys_addr, addr_rebased))
+    return true;
+  if (map::GPU.contains(phys_addr, addr_rebased))
+    return addr_rebased >= 4;  // GPUSTAT, GPUREAD reads from VRAM
+  if (map::TIMERS.contains(phys_addr, addr_rebased))
+    return (addr_rebased & 0xF) == 8;  // Counters advance as the Cpu runs, reading the mode resets flags
+  if (map::CDROM.contains(phys_addr, addr_rebased))
+    return addr_rebased == 0 || addr_rebased == 3;  // Status and interrupt registers, not the FIFOs
+  return false;
+}
+
+IdleLoopDetector::IdleLoopDetector(Cpu& cpu, BlockCache& block_cache)
+    : m_cpu(cpu),
+      m_block_cache(block_cache) {}
+
+void IdleLoopDetector::on_loop_head() {
+  auto& cpu = m_cpu;
+  const auto pc = cpu.m_pc;
+
+  Block* block = m_block_cache.get_block(pc);
+  if (!block || !block->is_self_loop || block->idle_loop == IdleLoopStatus::Impossible)
+    return;
+
+  if (block->idle_loop == IdleLoopStatus::Unchecked) {
+    block->idle_loop = has_side_effects(*block) ? IdleLoopStatus::Impossible : IdleLoopStatus::Possible;
+    if (block->idle_loop == IdleLoopStatus::Impossible)
+      return;
+  }
+
+  // Iterations only take the same time if there's no MULT/DIV result to stall on (GTE commands aren't
+  // allowed in idle loops)
+  if (cpu.m_muldiv_ready_cycle > cpu.m_cycles) {
+    m_snapshot_valid = false;
+    return;
+  }
+
+  const auto instruction_count = block->instructions.size();
+  const auto loop_cycles = cpu.m_cycles - m_snapshot_cycles;
+  const auto state = capture();
+
+  // We need to have executed exactly one iteration since the previous snapshot, and to have ended up in
+  // the same state
+  const bool is_idle = m_snapshot_valid && m_snapshot_pc == pc &&
+                       cpu.m_instructions - m_snapshot_instructions == instruction_count &&
+                       state == m_snapshot;
+
+  m_snapshot = state;
+  m_snapshot_valid = true;
+  m_snapshot_pc = pc;
+  m_snapshot_cycles = cpu.m_cycles;
+  m_snapshot_instructions = cpu.m_instructions;
+
+  if (!is_idle)
+    return;
+
+  // The state is the same, so loads that depend on it read the same addresses every time
+  if (!has_invariant_loads(*block)) {
+    block->idle_loop = IdleLoopStatus::Impossible;
+    m_snapshot_valid = false;
+    return;
+  }
+
+  // Skip all iterations that would start before the end of the step
+  const auto skipped_iterations = (cpu.m_cycles_end - 1 - cpu.m_cycles) / loop_cycles;
+  cpu.m_cycles += skipped_iterations * loop_cycles;
+  cpu.m_instructions += skipped_iterations * instruction_count;
+  m_snapshot_cycles = cpu.m_cycles;
+  m_snapshot_instructions = cpu.m_instructions;
+}
+
+bool IdleLoopDetector::has_side_effects(const Block& block) {
+  const auto instruction_count = block.instructions.size();
+
+  for (size_t n = 0; n < instruction_count; ++n) {
+    const auto& i = block.instructions[n];
+
+    // The loop's branch
+    if (n == instruction_count - 2)
+      continue;
+
+    // Anything else needs to only write to registers. Stores, HI/LO and co-processor writes, or
+    // unaligned loads (which depend on the load delay slot) aren't allowed.
+    if (destination_reg(i) == 0 && i.word() != 0)
+      return true;
+  }
+  return false;
+}
+
+bool IdleLoopDetector::has_invariant_loads(const Block& block) const {
+  // Track registers whose values are known when each instruction executes, starting from the current
+  // state
+  std::array<bool, 32> is_known;
+  std::array<u32, 32> values = m_cpu.m_gpr;
+  is_known.fill(true);
+
+  // Registers with pending loads will change at some point
+  is_known[m_cpu.m_slot_current.reg] = false;
+  is_known[m_cpu.m_slot_next.reg] = false;
+  is_known[0] = true;
+
+  for (const auto& i : block.instructions) {
+    const auto rs = i.rs();
+    const auto dst = destination_reg(i);
+
+    if (is_load(i.opcode())) {
+      if (!is_known[rs] || !is_invariant_address(values[rs] + i.imm16_se()))
+        return false;
+    }
+
+    if (dst == 0)
+      continue;
+
+    // Only follow the usual ways of building addresses
+    switch (i.opcode()) {
+      case Opcode::LUI: values[dst] = i.imm16() << 16; break;
+      case Opcode::ADDI:
+      case Opcode::ADDIU: values[dst] = values[rs] + i.imm16_se(); break;
+      case Opcode::ORI: values[dst] = values[rs] | i.imm16(); break;
+      default: is_known[dst] = false; continue;
+    }
+    is_known[dst] = (i.opcode() == Opcode::LUI) || is_known[rs];
+  }
+  return true;
+}
+
+IdleLoopDetector::Snapshot IdleLoopDetector::capture() const {
+  const auto& c = m_cpu;
+
+  // Invalid slots keep stale values around, which don't matter
+  const auto slot = [](const auto& load) -> std::array<u32, 3> {
+    if (!load.is_valid())
+      return {};
+    return { load.reg, load.val, load.val_prev };
+  };
+
+  return Snapshot{
+    c.m_gpr,
+    c.m_hi,
+    c.m_lo,
+    c.m_pc_next,
+    c.m_pc_current,
+    slot(c.m_slot_current),
+    slot(c.m_slot_next),
+    c.m_branch_flags,
+    c.m_cop0_status.word,
+    c.m_cop0_cause.word,
+    c.m_cop0_epc,
+  };
+}
+
+bool IdleLoopDetector::Snapshot::operator==(const Snapshot& rhs) const {
+  return gpr == rhs.gpr && hi == rhs.hi && lo == rhs.lo && pc_next == rhs.pc_next &&
+         pc_current == rhs.pc_current && slot_current == rhs.slot_current &&
+         slot_next == rhs.slot_next && branch_flags == rhs.branch_flags &&
+         cop0_status == rhs.cop0_status && cop0_cause == rhs.cop0_cause && cop0_epc == rhs.cop0_epc;
+}
+
+}  // namespace cpu
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cpu/block_cache.hpp>
+#include <cpu/instruction.hpp>
+#include <util/types.hpp>
+
+#include <array>
+
+namespace cpu {
+
+class Cpu;
+
+// Detects loops that spin waiting for an event, like the BIOS and games polling I_STAT, GPUSTAT or a RAM
+// variable until an interrupt arrives, so that the Cpu can skip their iterations.
+//
+// A loop is idle if it's a single block that branches back to itself, only contains instructions without
+// side effects, only loads from addresses that can't change while the Cpu is running (device events only
+// run between Cpu::step calls), and an iteration leaves the Cpu state unchanged. Iterations of such
+// a loop are identical (down to their cycle count) until the end of the current step, so they're
+// skipped, up to the last one that starts before it.
+class IdleLoopDetector {
+ public:
+  explicit IdleLoopDetector(Cpu& cpu, BlockCache& block_cache);
+
+  // Forgets the last iteration, called when the Cpu starts a new step
+  void reset() { m_snapshot_valid = false; }
+
+  // Called when the Cpu is about to execute the start of a self-looping block. Advances the Cpu's cycle
+  // count past the iterations that can be skipped, if any.
+  void on_loop_head();
+
+ private:
+  static bool has_side_effects(const Block& block);
+  bool has_invariant_loads(const Block& block) const;
+
+  // Cpu state at the start of an iteration
+  struct Snapshot {
+    std::array<u32, 32> gpr;
+    u32 hi;
+    u32 lo;
+    u32 pc_next;
+    u32 pc_current;
+    std::array<u32, 3> slot_current;  // reg, val, val_prev
+    std::array<u32, 3> slot_next;
+    u8 branch_flags;
+    u32 cop0_status;
+    u32 cop0_cause;
+    u32 cop0_epc;
+
+    bool operator==(const Snapshot& rhs) const;
+  };
+  Snapshot capture() const;
+
+  Snapshot m_snapshot{};  // Taken at the start of the previous iteration
+  bool m_snapshot_valid{};
+  address m_snapshot_pc{};
+  u64 m_snapshot_cycles{};
+  u64 m_snapshot_instructions{};
+
+  Cpu& m_cpu;
+  BlockCache& m_block_cache;
+};
+
+}  // namespace cpu
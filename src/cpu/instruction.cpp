@@ -3,66 +3,27 @@
 
 #include <spdlog/fmt/fmt.h>
 
-namespace cpu {
-
-Instruction::Instruction(u32 word) : m_word(word), m_opcode(decode()) {}
-
-// TODO: Using X-Macros for instruction decoding & disassembly sounded like a good idea initially, but it
-// got a bit out of hand. This should be refactored, if not to completely remove X-Macros use, to remove
-// the disassembly part of it for some simplicty.
-
-Opcode Instruction::decode() {
-  const auto primary_opcode = op_prim();
+#include <array>
 
-  const bool is_cop_instr = m_word >> 30 & 1;
-
-  // Disable formattinig to keep macro defs in a single line for brevity
-  // clang-format off
-
-  if (is_cop_instr) {  // Co-processor insruction
-    const auto cop_opcode = op_cop();
+namespace cpu {
 
-    if (is_cop2_cmd()) {
-      m_operands = { OPERAND_IMM25, OPERAND_NONE, OPERAND_NONE };
-      return Opcode::COP2;
-    }
-    else if (cop_opcode == 0b010000'1'0000) { // COP0 instruction
-      const u16 cop0_opcode_sec = op_cop0_sec();
+using OperandList = std::array<u8, 3>;  // OPERAND_* values
 
-      // RFE is the only COP0 instruction implemented on PlayStation hardware with this encoding
-      Ensures(cop0_opcode_sec == 0b010000);
+// Operands of each opcode, indexed by Opcode. Only built the first time something gets disassembled.
+static const std::array<OperandList, OPCODE_COUNT>& operand_table() {
+  static const auto table = [] {
+    std::array<OperandList, OPCODE_COUNT> operands{};
 
-      return Opcode::RFE;
-    } else {
-      switch (cop_opcode) {  // Other COPn instruction
-#define OPCODE_COP(mnemonic, opcode, operand1, operand2, operand3) \
-  case opcode: m_operands = { operand1, operand2, operand3 }; return Opcode::mnemonic;
-#include <cpu/opcodes.def>
-#undef OPCODE_COP
-        default: goto prim_encoding; // LWC/SWC instructions use this encoding (op is first 6 bits)
-      }
-    }
-  } else if (primary_opcode != 0) {  // non-SPECIAL insruction
-  prim_encoding:
-    switch (primary_opcode) {
-#define OPCODE_PRIM(mnemonic, opcode, operand1, operand2, operand3) \
-  case opcode: m_operands = { operand1, operand2, operand3 }; return Opcode::mnemonic;
+#define OPCODE(mnemonic, opcode, operand1, operand2, operand3) \
+  operands[static_cast<u32>(Opcode::mnemonic)] = { operand1, operand2, operand3 };
 #include <cpu/opcodes.def>
-#undef OPCODE_PRIM
-      default: return Opcode::INVALID;
-    }
-  } else {  // SPECIAL insruction
-    const u8 secondary_opcode = op_sec();
+#undef OPCODE
 
-    switch (secondary_opcode) {
-#define OPCODE_SEC(mnemonic, opcode, operand1, operand2, operand3) \
-  case opcode: m_operands = { operand1, operand2, operand3 }; return Opcode::mnemonic;
-#include <cpu/opcodes.def>
-#undef OPCODE_SEC
-      default: return Opcode::INVALID;
-    }
-  }
-  // clang-format on
+    // The GTE command is in the lower 25 bits
+    operands[static_cast<u32>(Opcode::COP2)] = { OPERAND_IMM25, OPERAND_NONE, OPERAND_NONE };
+    return operands;
+  }();
+  return table;
 }
 
 std::string Instruction::disassemble() const {
@@ -73,7 +34,7 @@ std::string Instruction::disassemble() const {
   disasm_text = opcode_to_str(m_opcode);
   disasm_text += "\t";
 
-  for (const auto operand : m_operands) {
+  for (const auto operand : operand_table()[static_cast<u32>(m_opcode)]) {
     switch (operand) {
       case OPERAND_NONE: break;
       case OPERAND_RS: disasm_text += fmt::format("{}, ", register_to_str(rs())); break;
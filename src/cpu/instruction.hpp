@@ -1,9 +1,10 @@
 #pragma once
 
+#include <cpu/decoder.hpp>
 #include <cpu/opcode.hpp>
 #include <util/types.hpp>
 
-#include <array>
+#include <string>
 
 #define OPERAND_NONE 0     // No operand
 #define OPERAND_RS 1       // Register source
@@ -25,7 +26,7 @@ using RegisterIndex = u8;
 
 class Instruction {
  public:
-  explicit Instruction(u32 word);
+  explicit constexpr Instruction(u32 word) : m_word(word), m_opcode(decoder::decode(word)) {}
 
   // Primary opcode field [31:26]
   constexpr u8 op_prim() const { return (m_word & 0b11111100'00000000'00000000'00000000) >> 26; }
@@ -63,13 +64,9 @@ class Instruction {
 
   std::string disassemble() const;
 
- private:
-  Opcode decode();
-
  private:
   const u32 m_word;
   const Opcode m_opcode;
-  std::array<u16, 3> m_operands;  //  bitfield of enum Operand
 };
 
 }  // namespace cpu
@@ -10,6 +10,7 @@ void Interrupts::update_cop0() {
   const bool is_interrupt_pending = (m_imask.word & m_istat.word);
 
   m_cpu->m_cop0_cause.interrupt_pending = is_interrupt_pending ? 0b100 : 0b0;
+  m_cpu->update_interrupt_pending();
 }
 
 bool Interrupts::check() const {
@@ -22,15 +23,15 @@ bool Interrupts::check() const {
   return are_interrupts_enabled && are_active_interrupts;
 }
 
-void Interrupts::check_and_trigger() const {
-  if (check())
-    m_cpu->trigger_exception(ExceptionCause::Interrupt);
-}
-
 void Interrupts::trigger(IrqType irq) {
   m_istat.word |= (1 << static_cast<u16>(irq));
 
   update_cop0();
 }
 
+void Interrupts::serialize(util::Serializer& s) {
+  s.value(m_istat);
+  s.value(m_imask);
+}
+
 }  // namespace cpu
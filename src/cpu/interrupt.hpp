@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory/addressable.hpp>
+#include <util/serializer.hpp>
 #include <util/types.hpp>
 
 namespace cpu {
@@ -43,10 +44,10 @@ class Interrupts {
  public:
   void init(cpu::Cpu* cpu) { m_cpu = cpu; }
 
-  bool check() const;
+  bool check() const;  // Whether an interrupt should be taken
   void update_cop0();
-  void check_and_trigger() const;
   void trigger(IrqType irq);
+  void serialize(util::Serializer& s);
 
   template <typename ValueType>
   ValueType read(address addr_rebased) const {
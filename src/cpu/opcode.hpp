@@ -1,14 +1,18 @@
 #pragma once
 
+#include <util/types.hpp>
+
 namespace cpu {
 
-enum class Opcode {
+enum class Opcode : u8 {
 #define OPCODE(mnemonic, opcode, operand1, operand2, operand3) mnemonic,
 #include <cpu/opcodes.def>
 #undef OPCODE
   INVALID
 };
 
+constexpr u32 OPCODE_COUNT = static_cast<u32>(Opcode::INVALID) + 1;
+
 inline const char* opcode_to_str(Opcode opcode) {
   switch (opcode) {
 #define OPCODE(mnemonic, opcode, operand1, operand2, operand3) \
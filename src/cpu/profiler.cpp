@@ -0,0 +1,130 @@
+#include <cpu/profiler.hpp>
+
+#include <bios/functions.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+
+namespace cpu {
+
+const char* opcode_class_to_str(OpcodeClass opcode_class) {
+  switch (opcode_class) {
+    case OpcodeClass::Alu: return "ALU";
+    case OpcodeClass::Load: return "Load";
+    case OpcodeClass::Store: return "Store";
+    case OpcodeClass::Jump: return "Branch/Jump";
+    case OpcodeClass::MulDiv: return "Mul/Div";
+    case OpcodeClass::Cop0: return "COP0";
+    case OpcodeClass::Gte: return "GTE";
+    case OpcodeClass::Other: return "Other";
+    default: return "<invalid>";
+  }
+}
+
+std::string function_name(FunctionId function) {
+  if ((function & ~PC_ID_ADDRESS_MASK) == PC_ID)
+    return fmt::format("pc_{:08X}", function & PC_ID_ADDRESS_MASK);
+  if ((function & 0xFFFF0000) != BIOS_FUNCTION_ID)
+    return fmt::format("func_{:08X}", function);
+
+  const u8 vector = (function >> 4) & 0xF0;
+  const u8 number = function & 0xFF;
+
+  const auto& table = vector == 0xA0 ? bios::A0 : vector == 0xB0 ? bios::B0 : bios::C0;
+  const auto it = table.find(number);
+  if (it == table.end())
+    return fmt::format("{:02X}({:02X})", vector, number);
+  return fmt::format("{:02X}({:02X}):{}", vector, number, it->second.name);
+}
+
+void Profiler::reset(u64 cycles) {
+  m_stack.clear();
+  m_stack_samples.clear();
+  m_opcode_class_samples.fill(0);
+  m_sample_count = 0;
+  m_next_sample_cycle = cycles + SAMPLE_PERIOD;
+}
+
+void Profiler::sample(u64 cycles, address pc, Opcode opcode) {
+  m_sample_stack.clear();
+  for (const auto& frame : m_stack)
+    m_sample_stack.push_back(frame.function);
+  if (m_sample_stack.empty())
+    m_sample_stack.push_back(PC_ID | (pc & PC_ID_ADDRESS_MASK));
+  ++m_stack_samples[m_sample_stack];
+
+  ++m_opcode_class_samples[static_cast<size_t>(opcode_class(opcode))];
+  ++m_sample_count;
+
+  // Periods skipped by long instructions aren't made up for, they'd all land on the same PC
+  m_next_sample_cycle = cycles + SAMPLE_PERIOD;
+}
+
+void Profiler::on_call(address target, address return_addr) {
+  // Functions that never return (or return in other ways) would otherwise grow the stack forever
+  if (m_stack.size() == MAX_STACK_DEPTH)
+    m_stack.erase(m_stack.begin());
+
+  m_stack.push_back({ target, return_addr });
+}
+
+void Profiler::on_return(address target) {
+  // Unwind to the matching call, skipping frames of functions that didn't return normally. Returns
+  // without a matching call (eg. to code that ran before profiling started) are ignored.
+  for (auto frame = m_stack.rbegin(); frame != m_stack.rend(); ++frame) {
+    if (frame->return_addr == target) {
+      m_stack.erase(std::next(frame).base(), m_stack.end());
+      return;
+    }
+  }
+}
+
+void Profiler::on_bios_call(address vector_addr, u8 function_number) {
+  const address masked_vector = vector_addr & 0x1FFFFF;
+
+  // The innermost call is either to the vector itself, or to a stub that only jumps to it (li t2,0xA0;
+  // jr t2; li t1,N), which doesn't push a frame of its own. Either way, it's the BIOS function's.
+  if (!m_stack.empty())
+    m_stack.back().function = BIOS_FUNCTION_ID | masked_vector << 4 | function_number;
+}
+
+std::vector<Hotspot> Profiler::hotspots() const {
+  std::unordered_map<FunctionId, Hotspot> hotspots;
+
+  for (const auto& [stack, samples] : m_stack_samples) {
+    for (auto it = stack.begin(); it != stack.end(); ++it) {
+      // Count recursive functions once per sample
+      if (std::find(stack.begin(), it, *it) != it)
+        continue;
+
+      auto& hotspot = hotspots.try_emplace(*it, Hotspot{ *it, 0, 0 }).first->second;
+      hotspot.total_samples += samples;
+    }
+    hotspots[stack.back()].self_samples += samples;
+  }
+
+  std::vector<Hotspot> sorted;
+  sorted.reserve(hotspots.size());
+  for (const auto& [function, hotspot] : hotspots)
+    sorted.push_back(hotspot);
+
+  std::sort(sorted.begin(), sorted.end(),
+            [](const Hotspot& a, const Hotspot& b) { return a.self_samples > b.self_samples; });
+  return sorted;
+}
+
+bool Profiler::save_folded(const fs::path& path) const {
+  std::ofstream ofs(path, std::ios::trunc);
+
+  for (const auto& [stack, samples] : m_stack_samples) {
+    std::string line = "root";
+    for (const auto function : stack)
+      line += ';' + function_name(function);
+    ofs << line << ' ' << samples << '\n';
+  }
+
+  return bool(ofs);
+}
+
+}  // namespace cpu
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cpu/opcode.hpp>
+#include <util/fs.hpp>
+#include <util/types.hpp>
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cpu {
+
+enum class OpcodeClass : u8 {
+  Alu,
+  Load,
+  Store,
+  Jump,  // Branches and jumps
+  MulDiv,
+  Cop0,
+  Gte,
+  Other,
+
+  Count,
+};
+
+constexpr OpcodeClass opcode_class(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::LB:
+    case Opcode::LBU:
+    case Opcode::LH:
+    case Opcode::LHU:
+    case Opcode::LW:
+    case Opcode::LWL:
+    case Opcode::LWR: return OpcodeClass::Load;
+    case Opcode::SB:
+    case Opcode::SH:
+    case Opcode::SW:
+    case Opcode::SWL:
+    case Opcode::SWR: return OpcodeClass::Store;
+    case Opcode::BCONDZ:
+    case Opcode::BEQ:
+    case Opcode::BNE:
+    case Opcode::BLEZ:
+    case Opcode::BGTZ:
+    case Opcode::J:
+    case Opcode::JAL:
+    case Opcode::JR:
+    case Opcode::JALR: return OpcodeClass::Jump;
+    case Opcode::MULT:
+    case Opcode::MULTU:
+    case Opcode::DIV:
+    case Opcode::DIVU:
+    case Opcode::MFHI:
+    case Opcode::MFLO:
+    case Opcode::MTHI:
+    case Opcode::MTLO: return OpcodeClass::MulDiv;
+    case Opcode::MFC0:
+    case Opcode::CFC0:
+    case Opcode::MTC0:
+    case Opcode::CTC0:
+    case Opcode::RFE: return OpcodeClass::Cop0;
+    case Opcode::LWC2:
+    case Opcode::SWC2:
+    case Opcode::COP2:
+    case Opcode::MFC2:
+    case Opcode::CFC2:
+    case Opcode::MTC2:
+    case Opcode::CTC2:
+    case Opcode::BC2: return OpcodeClass::Gte;
+    case Opcode::SYSCALL:
+    case Opcode::BREAK:
+    case Opcode::SPECIAL:
+    case Opcode::INVALID: return OpcodeClass::Other;
+    default: return OpcodeClass::Alu;
+  }
+}
+
+const char* opcode_class_to_str(OpcodeClass opcode_class);
+
+// Guest function, either its entry address or a BIOS function called through a vector (A0/B0/C0).
+// Samples taken outside any tracked call (eg. in the BIOS before profiling saw a call) are attributed
+// to their PC instead, in a range no code is called in.
+using FunctionId = u32;
+constexpr FunctionId BIOS_FUNCTION_ID = 0xFFFF0000;  // | vector (0xA0/0xB0/0xC0) << 4 | function number
+constexpr FunctionId PC_ID = 0x60000000;             // | physical address (pc & PC_ID_ADDRESS_MASK)
+constexpr FunctionId PC_ID_ADDRESS_MASK = 0x1FFFFFFF;
+
+std::string function_name(FunctionId function);
+
+struct Hotspot {
+  FunctionId function;
+  u64 self_samples;   // Samples in the function itself
+  u64 total_samples;  // Samples in the function or ones it called
+};
+
+// Sampling profiler for guest code. Samples the PC every SAMPLE_PERIOD cycles, attributing it to the
+// call stack, which is tracked from JAL/JALR (calls) and JR $ra (returns).
+class Profiler {
+ public:
+  static constexpr u32 SAMPLE_PERIOD = 1000;  // In cycles, ~34k samples per emulated second
+
+  void reset(u64 cycles);
+  bool sample_due(u64 cycles) const { return cycles >= m_next_sample_cycle; }
+  void sample(u64 cycles, address pc, Opcode opcode);
+
+  void on_call(address target, address return_addr);
+  void on_return(address target);
+  // Names the call to the vector, or to the stub that jumped to it
+  void on_bios_call(address vector_addr, u8 function_number);
+
+  u64 sample_count() const { return m_sample_count; }
+  const std::array<u64, static_cast<size_t>(OpcodeClass::Count)>& opcode_class_samples() const {
+    return m_opcode_class_samples;
+  }
+  std::vector<Hotspot> hotspots() const;  // Sorted by self samples, descending
+  // Saves samples as folded stacks ("caller;callee count" lines), for flame graph tools.
+  // Returns false on failure.
+  bool save_folded(const fs::path& path) const;
+
+ private:
+  struct Frame {
+    FunctionId function;
+    address return_addr;
+  };
+  static constexpr u32 MAX_STACK_DEPTH = 64;
+
+  std::vector<Frame> m_stack;
+  std::vector<FunctionId> m_sample_stack;  // Reused to avoid allocating on every sample
+  std::map<std::vector<FunctionId>, u64> m_stack_samples;
+  std::array<u64, static_cast<size_t>(OpcodeClass::Count)> m_opcode_class_samples{};
+  u64 m_sample_count{};
+  u64 m_next_sample_cycle{};
+};
+
+}  // namespace cpu
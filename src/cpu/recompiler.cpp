@@ -0,0 +1,708 @@
+#include <cpu/recompiler.hpp>
+
+#include <bus/bus.hpp>
+#include <cpu/cpu.hpp>
+#include <cpu/cycles.hpp>
+#include <cpu/interrupt.hpp>
+#include <cpu/opcode.hpp>
+#include <emulator/settings.hpp>
+#include <memory/map.hpp>
+#include <memory/page_table.hpp>
+#include <util/log.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace cpu {
+
+using namespace x64;
+
+// Argument registers of the host calling convention
+#ifdef _WIN32
+constexpr Reg ARG0 = RCX;
+constexpr Reg ARG1 = RDX;
+#else
+constexpr Reg ARG0 = RDI;
+constexpr Reg ARG1 = RSI;
+#endif
+
+// Upper bound of the native code size of a single block
+constexpr u32 MAX_BLOCK_CODE_SIZE = 32 * 1024;
+
+// Stack space reserved by the prologue. Keeps calls 16-byte aligned and doubles as Win64 shadow space.
+constexpr u8 STACK_RESERVE = 32;
+
+// Loads and stores translated to native accesses in the fastmem region, if it's available
+static bool is_fastmem_access(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::LB:
+    case Opcode::LBU:
+    case Opcode::LH:
+    case Opcode::LHU:
+    case Opcode::LW:
+    case Opcode::SB:
+    case Opcode::SH:
+    case Opcode::SW: return true;
+    default: return false;
+  }
+}
+
+static u32 access_size(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::LB:
+    case Opcode::LBU:
+    case Opcode::SB: return 1;
+    case Opcode::LH:
+    case Opcode::LHU:
+    case Opcode::SH: return 2;
+    default: return 4;
+  }
+}
+
+static bool is_store(Opcode opcode) {
+  return opcode == Opcode::SB || opcode == Opcode::SH || opcode == Opcode::SW;
+}
+
+Recompiler::Recompiler(Cpu& cpu, BlockCache& block_cache)
+    : m_aot_cache(cpu, block_cache), m_cpu(cpu), m_block_cache(block_cache) {}
+
+Recompiler::~Recompiler() {
+  if (!m_code_buffer)
+    return;
+  m_cpu.m_bus.fastmem().set_handler(nullptr, nullptr, nullptr);
+#ifdef _WIN32
+  VirtualFree(m_code_buffer, 0, MEM_RELEASE);
+#else
+  munmap(m_code_buffer, RECOMPILER_CODE_BUFFER_SIZE);
+#endif
+}
+
+u32 Recompiler::execute_block() {
+  const auto pc = m_cpu.m_pc;
+
+  // The interpreter is in the middle of a block, let it finish it
+  if (m_block_cache.continues_block(pc))
+    return 0;
+
+  // Native code assumes it starts executing sequentially (not in a delay slot) with no pending interrupt
+  if ((m_cpu.m_branch_flags & BRANCH_DELAY_SLOT) || m_cpu.m_interrupt_pending)
+    return 0;
+
+  Block* block = m_block_cache.get_block(pc);
+  if (!block)
+    return 0;
+
+  const u32 aot_instructions_executed = m_aot_cache.execute(*block, pc);
+  if (aot_instructions_executed)
+    return aot_instructions_executed;
+
+#if RECOMPILER_SUPPORTED
+  // Instruction fetch timings are baked into native code, and so is the way it accesses memory
+  if (m_cpu.m_bus.timing_generation() != m_bus_timing_generation || use_fastmem() != m_fastmem) {
+    m_bus_timing_generation = m_cpu.m_bus.timing_generation();
+    m_fastmem = use_fastmem();
+    flush();
+  }
+
+  if (block->native_unsupported)
+    return 0;
+
+  auto code = block->native_code;
+  if (!code || block->native_generation != m_generation || block->native_pc != pc) {
+    code = translate(*block, pc);
+    if (!code)
+      return 0;
+  }
+  m_cpu.m_native_exit_pending = false;
+  return code(&m_cpu);
+#else
+  return 0;
+#endif
+}
+
+bool Recompiler::allocate_code_buffer() {
+#ifdef _WIN32
+  m_code_buffer = static_cast<u8*>(VirtualAlloc(nullptr, RECOMPILER_CODE_BUFFER_SIZE,
+                                                MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+#else
+  void* mem = mmap(nullptr, RECOMPILER_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  m_code_buffer = (mem == MAP_FAILED) ? nullptr : static_cast<u8*>(mem);
+#endif
+
+  if (!m_code_buffer) {
+    LOG_ERROR("Couldn't allocate the recompiler's code buffer");
+    return false;
+  }
+
+  m_cpu.m_bus.fastmem().set_handler(this, m_code_buffer, m_code_buffer + RECOMPILER_CODE_BUFFER_SIZE);
+  return true;
+}
+
+void Recompiler::flush() {
+  LOG_DEBUG("Flushing recompiler code buffer");
+
+  // Native code pointers of the previous generation are ignored from now on
+  m_code_buffer_used = 0;
+  ++m_generation;
+}
+
+NativeBlockFunction Recompiler::translate(Block& block, address pc) {
+  const auto instruction_count = static_cast<u32>(block.instructions.size());
+
+  // Invalid instructions and BIOS function entry points need the interpreter's handling
+  for (u32 n = 0; n < instruction_count; ++n) {
+    if (block.instructions[n].opcode() == Opcode::INVALID || is_bios_function_vector(pc + n * 4)) {
+      block.native_unsupported = true;
+      return nullptr;
+    }
+  }
+
+  if (!m_code_buffer && !allocate_code_buffer()) {
+    block.native_unsupported = true;
+    return nullptr;
+  }
+
+  if (RECOMPILER_CODE_BUFFER_SIZE - m_code_buffer_used < MAX_BLOCK_CODE_SIZE)
+    flush();
+
+  Emitter e(m_code_buffer + m_code_buffer_used, MAX_BLOCK_CODE_SIZE);
+
+  // We're entering sequentially, but know nothing about the rest of the state
+  m_state.pc_in_memory = true;
+  m_state.branch_flags_clear = true;
+  m_state.saved_flags_clear = false;
+  m_state.load_slot_clear = false;
+  m_state.next_load_slot_clear = false;
+  m_state.exits.clear();
+  m_state.step_end_exits.clear();
+
+  // Prologue
+  e.push_r64(RBX);
+  e.sub_rsp_imm8(STACK_RESERVE);
+  e.mov_r64_r64(RBX, ARG0);
+
+  for (u32 n = 0; n < instruction_count; ++n) {
+    const auto& i = block.instructions[n];
+    const auto instr_pc = pc + n * 4;
+    const bool is_delay_slot = (n > 0) && is_branch(block.instructions[n - 1].opcode());
+
+    // Branches in delay slots compute their target from the previous branch's, leave those to the
+    // interpreter
+    if (m_fastmem && is_fastmem_access(i.opcode())) {
+      emit_fastmem_access(e, i, instr_pc, is_delay_slot, n + 1, n + 1 == instruction_count);
+    } else if (is_native(i.opcode()) && !(is_delay_slot && is_branch(i.opcode()))) {
+      emit_instruction(e, i, instr_pc, is_delay_slot);
+      emit_cycles(e, i, instr_pc, n + 1, n + 1 == instruction_count);
+    } else {
+      emit_fallback(e, i, instr_pc, n + 1);
+    }
+  }
+
+  // Write back the state the interpreter expects after the last instruction
+  const auto last_pc = pc + (instruction_count - 1) * 4;
+  e.mov_mem_imm32(offset_of(&m_cpu.m_pc_current), last_pc);
+  if (!m_state.pc_in_memory)
+    emit_set_pc(e, last_pc + 4);
+  e.mov_r32_imm32(RAX, instruction_count);
+
+  // Same for the instructions the step can end after
+  if (!m_state.step_end_exits.empty()) {
+    m_state.exits.push_back(e.jmp_near());
+
+    for (const auto& exit : m_state.step_end_exits) {
+      e.bind_near(exit.jump);
+      e.mov_mem_imm32(offset_of(&m_cpu.m_pc_current), exit.pc);
+      if (!exit.pc_in_memory)
+        emit_set_pc(e, exit.pc + 4);
+      e.mov_r32_imm32(RAX, exit.instructions_done);
+      m_state.exits.push_back(e.jmp_near());
+    }
+  }
+
+  // Epilogue
+  for (const auto exit : m_state.exits)
+    e.bind_near(exit);
+  e.add_rsp_imm8(STACK_RESERVE);
+  e.pop_r64(RBX);
+  e.ret();
+
+  // Keep blocks 16-byte aligned
+  m_code_buffer_used += (e.size() + 15) & ~15u;
+
+  block.native_code = reinterpret_cast<NativeBlockFunction>(e.begin());
+  block.native_pc = pc;
+  block.native_generation = m_generation;
+  return block.native_code;
+}
+
+void Recompiler::emit_instruction(Emitter& e, const Instruction& i, address pc, bool is_delay_slot) {
+  emit_store_exception_state(e);
+
+  // Advance PC. In delay slots the next PC is only known at runtime, otherwise we keep it static and
+  // only write it back when it's needed.
+  if (is_delay_slot) {
+    e.mov_r32_mem(RAX, offset_of(&m_cpu.m_pc_next));
+    e.mov_mem_r32(offset_of(&m_cpu.m_pc), RAX);
+    e.alu_r32_imm32(ALU_ADD, RAX, 4);
+    e.mov_mem_r32(offset_of(&m_cpu.m_pc_next), RAX);
+    m_state.pc_in_memory = true;
+  } else {
+    m_state.pc_in_memory = false;
+  }
+
+  const auto op = i.opcode();
+
+  // Register-register ALU operations, rd = rs <op> rt
+  const auto emit_alu_rr = [&](AluOp alu_op) {
+    if (i.rd() == 0)
+      return;
+    emit_load_gpr(e, RAX, i.rs());
+    emit_load_gpr(e, RCX, i.rt());
+    e.alu_r32_r32(alu_op, RAX, RCX);
+    emit_store_gpr(e, i.rd());
+  };
+  // Register-immediate ALU operations, rt = rs <op> imm
+  const auto emit_alu_ri = [&](AluOp alu_op, u32 imm) {
+    if (i.rt() == 0)
+      return;
+    emit_load_gpr(e, RAX, i.rs());
+    e.alu_r32_imm32(alu_op, RAX, imm);
+    emit_store_gpr(e, i.rt());
+  };
+  // Comparisons, dst = (rs < other) ? 1 : 0
+  const auto emit_set_less = [&](Condition cc, RegisterIndex dst, bool with_imm) {
+    if (dst == 0)
+      return;
+    emit_load_gpr(e, RAX, i.rs());
+    if (with_imm) {
+      e.alu_r32_imm32(ALU_CMP, RAX, static_cast<u32>(static_cast<s32>(i.imm16_se())));
+    } else {
+      emit_load_gpr(e, RCX, i.rt());
+      e.alu_r32_r32(ALU_CMP, RAX, RCX);
+    }
+    e.setcc_r32(cc, RAX);
+    emit_store_gpr(e, dst);
+  };
+  // Shifts by immediate, rd = rt <op> imm5
+  const auto emit_shift_imm = [&](ShiftOp shift_op) {
+    if (i.rd() == 0)
+      return;
+    emit_load_gpr(e, RAX, i.rt());
+    e.shift_r32_imm8(shift_op, RAX, i.imm5());
+    emit_store_gpr(e, i.rd());
+  };
+  // Shifts by register, rd = rt <op> (rs & 0x1F). x86 masks the shift amount the same way.
+  const auto emit_shift_reg = [&](ShiftOp shift_op) {
+    if (i.rd() == 0)
+      return;
+    emit_load_gpr(e, RAX, i.rt());
+    emit_load_gpr(e, RCX, i.rs());
+    e.shift_r32_cl(shift_op, RAX);
+    emit_store_gpr(e, i.rd());
+  };
+  // Every branch sets the delay slot flag and advances PC normally, the taken path overrides m_pc_next
+  const auto emit_branch_prologue = [&]() {
+    emit_set_pc(e, pc + 4);
+    e.or_mem8_imm8(offset_of(&m_cpu.m_branch_flags), BRANCH_DELAY_SLOT);
+    m_state.branch_flags_clear = false;
+  };
+  const address branch_target = pc + 4 + (i.imm16_se() << 2);
+  const address jump_target = ((pc + 8) & 0xF0000000) | (i.imm26() << 2);
+
+  switch (op) {
+    case Opcode::ADDU: emit_alu_rr(ALU_ADD); break;
+    case Opcode::SUBU: emit_alu_rr(ALU_SUB); break;
+    case Opcode::AND: emit_alu_rr(ALU_AND); break;
+    case Opcode::OR: emit_alu_rr(ALU_OR); break;
+    case Opcode::XOR: emit_alu_rr(ALU_XOR); break;
+    case Opcode::NOR:
+      if (i.rd() == 0)
+        break;
+      emit_load_gpr(e, RAX, i.rs());
+      emit_load_gpr(e, RCX, i.rt());
+      e.alu_r32_r32(ALU_OR, RAX, RCX);
+      e.not_r32(RAX);
+      emit_store_gpr(e, i.rd());
+      break;
+    case Opcode::ADDIU: emit_alu_ri(ALU_ADD, static_cast<u32>(static_cast<s32>(i.imm16_se()))); break;
+    case Opcode::ANDI: emit_alu_ri(ALU_AND, i.imm16()); break;
+    case Opcode::ORI: emit_alu_ri(ALU_OR, i.imm16()); break;
+    case Opcode::XORI: emit_alu_ri(ALU_XOR, i.imm16()); break;
+    case Opcode::LUI:
+      if (i.rt() == 0)
+        break;
+      e.mov_r32_imm32(RAX, i.imm16() << 16);
+      emit_store_gpr(e, i.rt());
+      break;
+    case Opcode::SLT: emit_set_less(CC_L, i.rd(), false); break;
+    case Opcode::SLTU: emit_set_less(CC_B, i.rd(), false); break;
+    case Opcode::SLTI: emit_set_less(CC_L, i.rt(), true); break;
+    case Opcode::SLTIU: emit_set_less(CC_B, i.rt(), true); break;
+    case Opcode::SLL: emit_shift_imm(SHIFT_SHL); break;
+    case Opcode::SRL: emit_shift_imm(SHIFT_SHR); break;
+    case Opcode::SRA: emit_shift_imm(SHIFT_SAR); break;
+    case Opcode::SLLV: emit_shift_reg(SHIFT_SHL); break;
+    case Opcode::SRLV: emit_shift_reg(SHIFT_SHR); break;
+    case Opcode::SRAV: emit_shift_reg(SHIFT_SAR); break;
+    case Opcode::MTHI:
+    case Opcode::MTLO:
+      emit_load_gpr(e, RAX, i.rs());
+      e.mov_mem_r32(offset_of(op == Opcode::MTHI ? &m_cpu.m_hi : &m_cpu.m_lo), RAX);
+      break;
+    case Opcode::J:
+    case Opcode::JAL:
+      emit_branch_prologue();
+      // The link register is written directly, without going through the load delay logic
+      if (op == Opcode::JAL)
+        e.mov_mem_imm32(offset_of(&m_cpu.m_gpr[31]), pc + 8);
+      emit_branch(e, jump_target);
+      break;
+    case Opcode::BEQ:
+    case Opcode::BNE: {
+      emit_branch_prologue();
+      emit_load_gpr(e, RAX, i.rs());
+      emit_load_gpr(e, RCX, i.rt());
+      e.alu_r32_r32(ALU_CMP, RAX, RCX);
+      const auto skip = e.jcc_short(op == Opcode::BEQ ? CC_NE : CC_E);
+      emit_branch(e, branch_target);
+      e.bind_short(skip);
+      break;
+    }
+    case Opcode::BGTZ:
+    case Opcode::BLEZ: {
+      emit_branch_prologue();
+      emit_load_gpr(e, RAX, i.rs());
+      e.test_r32_r32(RAX, RAX);
+      const auto skip = e.jcc_short(op == Opcode::BGTZ ? CC_LE : CC_G);
+      emit_branch(e, branch_target);
+      e.bind_short(skip);
+      break;
+    }
+    case Opcode::BCONDZ: {
+      // See Cpu::execute_instruction for the format of rt
+      const bool should_link = ((i.rt() & 0x1E) == 0x10);
+      const bool branch_if_positive = (i.rt() & 1);
+
+      emit_branch_prologue();
+      emit_load_gpr(e, RAX, i.rs());
+      if (should_link)
+        e.mov_mem_imm32(offset_of(&m_cpu.m_gpr[31]), pc + 8);
+      e.test_r32_r32(RAX, RAX);
+      const auto skip = e.jcc_short(branch_if_positive ? CC_S : CC_NS);
+      emit_branch(e, branch_target);
+      e.bind_short(skip);
+      break;
+    }
+    case Opcode::LB:
+    case Opcode::LBU:
+    case Opcode::LH:
+    case Opcode::LHU:
+    case Opcode::LW: emit_guest_load(e, i); break;
+    case Opcode::SB:
+    case Opcode::SH:
+    case Opcode::SW: emit_guest_store(e, i); break;
+    default: assert(0);
+  }
+
+  emit_pending_load(e);
+}
+
+void Recompiler::emit_fallback(Emitter& e, const Instruction& i, address pc, u32 instructions_done) {
+  // The interpreter expects PC to be up to date
+  if (!m_state.pc_in_memory)
+    emit_set_pc(e, pc);
+
+  e.mov_r64_r64(ARG0, RBX);
+  e.mov_r64_imm64(ARG1, reinterpret_cast<u64>(&i));
+  e.mov_r64_imm64(RAX, reinterpret_cast<u64>(&fallback_trampoline));
+  e.call_r64(RAX);
+
+  // Leave if the interpreter tells us to
+  e.test_r32_r32(RAX, RAX);
+  const auto skip = e.jcc_short(CC_E);
+  e.mov_r32_imm32(RAX, instructions_done);
+  m_state.exits.push_back(e.jmp_near());
+  e.bind_short(skip);
+
+  // The interpreter leaves everything in memory, but we don't know what it did to the flags and load
+  // delay slot (other than always invalidating the next one)
+  m_state.pc_in_memory = true;
+  m_state.branch_flags_clear = false;
+  m_state.saved_flags_clear = false;
+  m_state.load_slot_clear = false;
+  m_state.next_load_slot_clear = true;
+}
+
+void Recompiler::emit_fastmem_access(Emitter& e,
+                                     const Instruction& i,
+                                     address pc,
+                                     bool is_delay_slot,
+                                     u32 instructions_done,
+                                     bool is_last) {
+  const auto op = i.opcode();
+  const u32 size = access_size(op);
+
+  // Misaligned accesses throw and stores are dropped while the cache is isolated, the interpreter
+  // handles those. So do accesses past the scratchpad's 1KB, which is mapped as a whole host page (see
+  // memory::Fastmem).
+  std::vector<u8*> slow_jumps;
+  emit_guest_address(e, i);
+  if (size > 1) {
+    e.test_r32_imm32(RCX, size - 1);
+    slow_jumps.push_back(e.jcc_near(CC_NE));
+  }
+  // Physical address rounded down to 1KB, in [0x1F800400, 0x1F801000)
+  constexpr u32 scratchpad_end = memory::map::SCRATCHPAD.start() + memory::SCRATCHPAD_SIZE;
+  e.mov_r64_r64(RAX, RCX);
+  e.alu_r32_imm32(ALU_AND, RAX, 0x1FFFFFFF & ~(memory::SCRATCHPAD_SIZE - 1));
+  e.alu_r32_imm32(ALU_SUB, RAX, scratchpad_end);
+  e.alu_r32_imm32(ALU_CMP, RAX, memory::PageTable::PAGE_SIZE - memory::SCRATCHPAD_SIZE);
+  slow_jumps.push_back(e.jcc_near(CC_B));
+  if (is_store(op)) {
+    Cop0StatusRegister isolated{};
+    isolated.isolate_cache = 1;
+    e.mov_r32_mem(RAX, offset_of(&m_cpu.m_cop0_status));
+    e.test_r32_imm32(RAX, isolated.word);
+    slow_jumps.push_back(e.jcc_near(CC_NE));
+  }
+
+  const KnownState state_before = m_state;
+
+  emit_instruction(e, i, pc, is_delay_slot);
+  emit_cycles(e, i, pc, instructions_done, is_last);
+
+  // Leave if the access faulted and modified the running block, or raised an interrupt
+  if (!is_last) {
+    e.cmp_mem8_imm8(offset_of(&m_cpu.m_native_exit_pending), 0);
+    m_state.step_end_exits.push_back({ e.jcc_near(CC_NE), pc, m_state.pc_in_memory, instructions_done });
+  }
+
+  if (slow_jumps.empty())
+    return;
+
+  const KnownState state_native = m_state;
+  const auto done = e.jmp_near();
+
+  for (const auto jump : slow_jumps)
+    e.bind_near(jump);
+  static_cast<KnownState&>(m_state) = state_before;
+  emit_fallback(e, i, pc, instructions_done);
+
+  e.bind_near(done);
+  m_state.merge(state_native);
+}
+
+void Recompiler::emit_guest_address(Emitter& e, const Instruction& i) {
+  emit_load_gpr(e, RCX, i.rs());
+  e.alu_r32_imm32(ALU_ADD, RCX, static_cast<u32>(static_cast<s32>(i.imm16_se())));
+}
+
+void Recompiler::emit_guest_load(Emitter& e, const Instruction& i) {
+  // Cpu::load*, the access faults unless it's to memory
+  emit_guest_address(e, i);
+  e.mov_r64_imm64(RDX, reinterpret_cast<u64>(m_cpu.m_bus.fastmem().base()));
+  switch (i.opcode()) {
+    case Opcode::LB: e.movsx_r32_guest8(RAX, RDX, RCX); break;
+    case Opcode::LBU: e.movzx_r32_guest8(RAX, RDX, RCX); break;
+    case Opcode::LH: e.movsx_r32_guest16(RAX, RDX, RCX); break;
+    case Opcode::LHU: e.movzx_r32_guest16(RAX, RDX, RCX); break;
+    default: e.mov_r32_guest(RAX, RDX, RCX); break;
+  }
+
+  // Bus::read_cycles for the memory in the region, see fastmem_read_cycles
+  const u32 size = access_size(i.opcode());
+  e.alu_r32_imm32(ALU_AND, RCX, 0x1FFFFFFF);
+  e.mov_r32_imm32(RDX, m_cpu.m_bus.read_cycles(memory::map::RAM.start(), size));
+  e.alu_r32_imm32(ALU_CMP, RCX, memory::map::SCRATCHPAD.start());
+  const auto is_ram = e.jcc_short(CC_B);
+  e.mov_r32_imm32(RDX, m_cpu.m_bus.read_cycles(memory::map::SCRATCHPAD.start(), size));
+  e.alu_r32_imm32(ALU_CMP, RCX, memory::map::BIOS.start());
+  const auto is_scratchpad = e.jcc_short(CC_B);
+  e.mov_r32_imm32(RDX, m_cpu.m_bus.read_cycles(memory::map::BIOS.start(), size));
+  e.bind_short(is_ram);
+  e.bind_short(is_scratchpad);
+  e.add_mem64_r64(offset_of(&m_cpu.m_cycles), RDX);
+
+  // Cpu::issue_delayed_load
+  const auto rt = i.rt();
+  if (rt == 0)
+    return;
+  emit_invalidate_reg(e, rt);
+  e.mov_mem_imm8(offset_of(&m_cpu.m_slot_next.reg), rt);
+  e.mov_mem_r32(offset_of(&m_cpu.m_slot_next.val), RAX);
+  emit_load_gpr(e, RCX, rt);
+  e.mov_mem_r32(offset_of(&m_cpu.m_slot_next.val_prev), RCX);
+  m_state.next_load_slot_clear = false;
+}
+
+void Recompiler::emit_guest_store(Emitter& e, const Instruction& i) {
+  // Cpu::store*, the access faults unless it's to memory (or a RAM page with cached code)
+  emit_guest_address(e, i);
+  emit_load_gpr(e, RAX, i.rt());
+  e.mov_r64_imm64(RDX, reinterpret_cast<u64>(m_cpu.m_bus.fastmem().base()));
+  switch (i.opcode()) {
+    case Opcode::SB: e.mov_guest_r8(RDX, RCX, RAX); break;
+    case Opcode::SH: e.mov_guest_r16(RDX, RCX, RAX); break;
+    default: e.mov_guest_r32(RDX, RCX, RAX); break;
+  }
+}
+
+void Recompiler::emit_cycles(Emitter& e,
+                             const Instruction& i,
+                             address pc,
+                             u32 instructions_done,
+                             bool is_last) {
+  // Same as what Cpu::step charges
+  const u32 cycles = INSTRUCTION_CYCLES[static_cast<u32>(i.opcode())] + m_cpu.m_bus.fetch_cycles(pc);
+  const auto cycles_offset = offset_of(&m_cpu.m_cycles);
+  e.add_mem64_imm32(cycles_offset, cycles);
+
+  // The block ends here anyway
+  if (is_last)
+    return;
+
+  // Leave if the step is over
+  e.mov_r64_mem(RAX, cycles_offset);
+  e.cmp_r64_mem(RAX, offset_of(&m_cpu.m_cycles_end));
+  m_state.step_end_exits.push_back({ e.jcc_near(CC_AE), pc, m_state.pc_in_memory, instructions_done });
+}
+
+void Recompiler::emit_load_gpr(Emitter& e, Reg host_reg, RegisterIndex guest_reg) {
+  if (guest_reg == 0)
+    e.xor_r32_r32(host_reg, host_reg);
+  else
+    e.mov_r32_mem(host_reg, offset_of(&m_cpu.m_gpr[guest_reg]));
+}
+
+void Recompiler::emit_store_gpr(Emitter& e, RegisterIndex guest_reg) {
+  if (guest_reg == 0)
+    return;
+
+  e.mov_mem_r32(offset_of(&m_cpu.m_gpr[guest_reg]), RAX);
+  emit_invalidate_reg(e, guest_reg);
+}
+
+void Recompiler::emit_invalidate_reg(Emitter& e, RegisterIndex guest_reg) {
+  // Cpu::invalidate_reg
+  if (!m_state.load_slot_clear) {
+    const auto slot_reg = offset_of(&m_cpu.m_slot_current.reg);
+    e.cmp_mem8_imm8(slot_reg, guest_reg);
+    const auto skip = e.jcc_short(CC_NE);
+    e.mov_mem_imm8(slot_reg, 0);
+    e.bind_short(skip);
+  }
+}
+
+void Recompiler::emit_store_exception_state(Emitter& e) {
+  // m_pc_current is only needed by exceptions and the hooks, which are all handled by the interpreter
+  if (m_state.branch_flags_clear && m_state.saved_flags_clear)
+    return;
+
+  const auto flags = offset_of(&m_cpu.m_branch_flags);
+
+  if (m_state.branch_flags_clear) {
+    e.mov_mem_imm8(flags, 0);
+  } else {
+    e.movzx_r32_mem8(RAX, flags);
+    e.alu_r32_imm32(ALU_AND, RAX, BRANCH_DELAY_SLOT | BRANCH_TAKEN);
+    e.shift_r32_imm8(SHIFT_SHL, RAX, 2);
+    e.mov_mem_r8(flags, RAX);
+  }
+
+  m_state.saved_flags_clear = m_state.branch_flags_clear;
+  m_state.branch_flags_clear = true;
+}
+
+void Recompiler::emit_pending_load(Emitter& e) {
+  // Cpu::do_pending_load, skipped entirely if we know both slots are empty
+  if (!(m_state.load_slot_clear && m_state.next_load_slot_clear)) {
+    e.movzx_r32_mem8(RAX, offset_of(&m_cpu.m_slot_current.reg));
+    e.or_r8_mem8(RAX, offset_of(&m_cpu.m_slot_next.reg));
+    const auto skip = e.jcc_short(CC_E);
+    e.mov_r64_r64(ARG0, RBX);
+    e.mov_r64_imm64(RAX, reinterpret_cast<u64>(&pending_load_trampoline));
+    e.call_r64(RAX);
+    e.bind_short(skip);
+  }
+
+  m_state.load_slot_clear = m_state.next_load_slot_clear;
+  m_state.next_load_slot_clear = true;
+}
+
+void Recompiler::emit_set_pc(Emitter& e, address pc) {
+  e.mov_mem_imm32(offset_of(&m_cpu.m_pc), pc);
+  e.mov_mem_imm32(offset_of(&m_cpu.m_pc_next), pc + 4);
+  m_state.pc_in_memory = true;
+}
+
+void Recompiler::emit_branch(Emitter& e, address target) {
+  // Cpu::set_pc_next
+  e.mov_mem_imm32(offset_of(&m_cpu.m_pc_next), target);
+  e.or_mem8_imm8(offset_of(&m_cpu.m_branch_flags), BRANCH_TAKEN);
+  if (is_bios_function_vector(target))
+    e.mov_mem_imm8(offset_of(&m_cpu.m_bios_call_pending), 1);
+}
+
+u32 Recompiler::fallback_trampoline(Cpu* cpu, const Instruction* i) {
+  return cpu->interpret_from_native(*i) ? 1 : 0;
+}
+
+void Recompiler::pending_load_trampoline(Cpu* cpu) {
+  cpu->do_pending_load();
+}
+
+u32 Recompiler::fastmem_read(address addr, u32 size) {
+  u32 val;
+  switch (size) {
+    case 1: val = m_cpu.m_bus.read<u8>(addr); break;
+    case 2: val = m_cpu.m_bus.read<u16>(addr); break;
+    default: val = m_cpu.m_bus.read<u32>(addr); break;
+  }
+
+  // Native code charged the timings of the memory it expected to find
+  m_cpu.m_cycles += m_cpu.m_bus.read_cycles(addr, size);
+  m_cpu.m_cycles -= fastmem_read_cycles(addr, size);
+
+  if (m_cpu.m_interrupt_pending)
+    m_cpu.m_native_exit_pending = true;
+  return val;
+}
+
+void Recompiler::fastmem_write(address addr, u32 val, u32 size) {
+  const auto invalidation_count = m_block_cache.invalidation_count();
+
+  switch (size) {
+    case 1: m_cpu.m_bus.write<u8>(addr, static_cast<u8>(val)); break;
+    case 2: m_cpu.m_bus.write<u16>(addr, static_cast<u16>(val)); break;
+    default: m_cpu.m_bus.write<u32>(addr, val); break;
+  }
+
+  // Same as after interpreted instructions, see Cpu::interpret_from_native
+  if (m_cpu.m_interrupt_pending || m_block_cache.invalidation_count() != invalidation_count)
+    m_cpu.m_native_exit_pending = true;
+}
+
+bool Recompiler::use_fastmem() const {
+  // Accesses have to go through the bus to be counted
+  return m_cpu.m_settings.fastmem && !m_cpu.m_bus.has_stats() && m_cpu.m_bus.fastmem().base();
+}
+
+u32 Recompiler::fastmem_read_cycles(address addr, u32 size) const {
+  // Same as the code emit_guest_load generates
+  const address phys_addr = addr & 0x1FFFFFFF;
+  if (phys_addr < memory::map::SCRATCHPAD.start())
+    return m_cpu.m_bus.read_cycles(memory::map::RAM.start(), size);
+  if (phys_addr < memory::map::BIOS.start())
+    return m_cpu.m_bus.read_cycles(memory::map::SCRATCHPAD.start(), size);
+  return m_cpu.m_bus.read_cycles(memory::map::BIOS.start(), size);
+}
+
+s32 Recompiler::offset_of(const void* member) const {
+  return static_cast<s32>(static_cast<const u8*>(member) - reinterpret_cast<const u8*>(&m_cpu));
+}
+
+}  // namespace cpu
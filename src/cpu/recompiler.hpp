@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cpu/aot_cache.hpp>
+#include <cpu/block_cache.hpp>
+#include <cpu/x64_emitter.hpp>
+#include <memory/fastmem.hpp>
+#include <util/types.hpp>
+
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RECOMPILER_SUPPORTED 1
+#else
+#define RECOMPILER_SUPPORTED 0
+#endif
+
+namespace cpu {
+
+class Cpu;
+
+// Size of the executable memory that holds all translated code. Once it's full, all native code is
+// discarded and blocks get translated again on demand.
+constexpr u32 RECOMPILER_CODE_BUFFER_SIZE = 32 * 1024 * 1024;
+
+// Translates blocks from the BlockCache to x86-64 code.
+// Guest state stays in the Cpu object, which the native code accesses through a fixed register. ALU and
+// branch instructions are translated directly, and so are loads/stores when the memory::Fastmem region
+// is available (faulting accesses to MMIO come back here). Everything else (COP0, COP2, multiplications
+// and divisions, anything that can throw an exception) calls back into Cpu::execute_instruction.
+// Native code charges the same cycles as the interpreter, and stops at the same instruction when a step
+// ends.
+// Code translated ahead of time (see AotCache) is preferred when it's available, on any host.
+class Recompiler : public memory::FastmemHandler {
+ public:
+  explicit Recompiler(Cpu& cpu, BlockCache& block_cache);
+  ~Recompiler();
+
+  // Runs the native code of the block at the current PC, translating it if necessary.
+  // Returns the number of guest instructions executed, or 0 if the block can't be run natively, in which
+  // case the caller should interpret the next instruction instead.
+  u32 execute_block();
+
+  // Loads code translated ahead of time, returns true on successful load
+  bool load_aot_module(const fs::path& module_path) { return m_aot_cache.load(module_path); }
+
+  // Native loads/stores that fault in the fastmem region (MMIO, protected code pages)
+  u32 fastmem_read(address addr, u32 size) override;
+  void fastmem_write(address addr, u32 val, u32 size) override;
+
+ private:
+  NativeBlockFunction translate(Block& block, address pc);
+  bool allocate_code_buffer();
+  void flush();
+
+  // Translation helpers
+  void emit_instruction(x64::Emitter& e, const Instruction& i, address pc, bool is_delay_slot);
+  void emit_fallback(x64::Emitter& e, const Instruction& i, address pc, u32 instructions_done);
+  void emit_fastmem_access(x64::Emitter& e,
+                           const Instruction& i,
+                           address pc,
+                           bool is_delay_slot,
+                           u32 instructions_done,
+                           bool is_last);
+  void emit_guest_load(x64::Emitter& e, const Instruction& i);
+  void emit_guest_store(x64::Emitter& e, const Instruction& i);
+  void emit_guest_address(x64::Emitter& e, const Instruction& i);  // To ecx
+  void emit_cycles(x64::Emitter& e,
+                   const Instruction& i,
+                   address pc,
+                   u32 instructions_done,
+                   bool is_last);
+  void emit_load_gpr(x64::Emitter& e, x64::Reg host_reg, RegisterIndex guest_reg);
+  void emit_store_gpr(x64::Emitter& e, RegisterIndex guest_reg);  // From eax
+  void emit_invalidate_reg(x64::Emitter& e, RegisterIndex guest_reg);
+  void emit_store_exception_state(x64::Emitter& e);
+  void emit_pending_load(x64::Emitter& e);
+  void emit_set_pc(x64::Emitter& e, address pc);
+  void emit_branch(x64::Emitter& e, address target);
+
+  // Called from native code
+  static u32 fallback_trampoline(Cpu* cpu, const Instruction* i);
+  static void pending_load_trampoline(Cpu* cpu);
+
+  // Byte offset of a Cpu member from the start of the object
+  s32 offset_of(const void* member) const;
+
+  bool use_fastmem() const;
+  // Cycles native code charges for a load from addr, the fastmem handler makes up the difference
+  u32 fastmem_read_cycles(address addr, u32 size) const;
+
+  u8* m_code_buffer{};
+  u32 m_code_buffer_used{};
+  u32 m_generation{ 1 };          // Incremented every time the code buffer is flushed
+  u32 m_bus_timing_generation{};  // Bus timings the native code was translated with
+  bool m_fastmem{};               // Whether native code was translated with fastmem accesses
+
+  // Static state tracked while translating a block, so that we can skip redundant bookkeeping
+  struct KnownState {
+    bool pc_in_memory;          // m_pc and m_pc_next hold the PC after the previous instruction
+    bool branch_flags_clear;    // The current bits of m_branch_flags are known to be clear
+    bool saved_flags_clear;     // The saved ones are known to be clear
+    bool load_slot_clear;       // m_slot_current is known to be invalid
+    bool next_load_slot_clear;  // m_slot_next is known to be invalid
+
+    // Where two paths of native code join, only what's known on both is
+    void merge(const KnownState& other) {
+      pc_in_memory &= other.pc_in_memory;
+      branch_flags_clear &= other.branch_flags_clear;
+      saved_flags_clear &= other.saved_flags_clear;
+      load_slot_clear &= other.load_slot_clear;
+      next_load_slot_clear &= other.next_load_slot_clear;
+    }
+  };
+  struct TranslationState : KnownState {
+    std::vector<u8*> exits;  // Jumps to the epilogue
+
+    // Jumps taken when the step ends after a native instruction
+    struct StepEndExit {
+      u8* jump;
+      address pc;
+      bool pc_in_memory;
+      u32 instructions_done;
+    };
+    std::vector<StepEndExit> step_end_exits;
+  } m_state{};
+
+  AotCache m_aot_cache;
+
+  Cpu& m_cpu;
+  BlockCache& m_block_cache;
+};
+
+}  // namespace cpu
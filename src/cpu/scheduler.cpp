@@ -0,0 +1,129 @@
+#include <cpu/scheduler.hpp>
+
+#include <cpu/cpu.hpp>
+
+#include <utility>
+
+namespace cpu {
+
+const char* event_to_str(Event event) {
+  switch (event) {
+    case Event::Vblank: return "VBLANK";
+    case Event::Timers: return "Timers";
+    case Event::DmaIrq: return "DMA IRQ";
+    case Event::CdromIrq: return "CD-ROM IRQ";
+    case Event::CdromSector: return "CD-ROM sector";
+    case Event::JoypadAck: return "Joypad ACK";
+    default: return "<unknown>";
+  }
+}
+
+u64 Scheduler::now() const {
+  return m_cpu->cycles();
+}
+
+void Scheduler::schedule(Event event, u64 cycle) {
+  const auto i = index(event);
+
+  if (m_deadlines[i] == NEVER) {
+    m_heap_pos[i] = m_heap_size;
+    m_heap[m_heap_size++] = event;
+  }
+
+  const bool is_sooner = cycle < m_deadlines[i];
+  m_deadlines[i] = cycle;
+  if (is_sooner)
+    sift_up(m_heap_pos[i]);
+  else
+    sift_down(m_heap_pos[i]);
+
+  m_cpu->end_step_by(cycle);
+}
+
+void Scheduler::cancel(Event event) {
+  if (is_scheduled(event))
+    remove(event);
+}
+
+bool Scheduler::pop_due(Event& event) {
+  if (next_deadline() > now())
+    return false;
+
+  event = m_heap[0];
+  remove(event);
+  return true;
+}
+
+void Scheduler::serialize(util::Serializer& s) {
+  s.value(m_deadlines);
+
+  // The heap is rebuilt from the deadlines
+  if (s.is_loading()) {
+    m_heap_size = 0;
+    for (u32 i = 0; i < EVENT_COUNT; ++i) {
+      if (m_deadlines[i] == NEVER)
+        continue;
+      m_heap_pos[i] = m_heap_size;
+      m_heap[m_heap_size++] = static_cast<Event>(i);
+      sift_up(m_heap_pos[i]);
+    }
+  }
+}
+
+void Scheduler::remove(Event event) {
+  const auto i = index(event);
+  const auto pos = m_heap_pos[i];
+
+  m_deadlines[i] = NEVER;
+  --m_heap_size;
+  if (pos == m_heap_size)
+    return;
+
+  // Fill the hole with the last event, which can belong either above or below it
+  swap(pos, m_heap_size);
+  sift_up(pos);
+  sift_down(pos);
+}
+
+void Scheduler::sift_up(u32 pos) {
+  while (pos > 0) {
+    const auto parent = (pos - 1) / 2;
+    if (!is_earlier(pos, parent))
+      return;
+    swap(pos, parent);
+    pos = parent;
+  }
+}
+
+void Scheduler::sift_down(u32 pos) {
+  while (true) {
+    const auto left = pos * 2 + 1;
+    const auto right = left + 1;
+
+    auto earliest = pos;
+    if (left < m_heap_size && is_earlier(left, earliest))
+      earliest = left;
+    if (right < m_heap_size && is_earlier(right, earliest))
+      earliest = right;
+    if (earliest == pos)
+      return;
+
+    swap(pos, earliest);
+    pos = earliest;
+  }
+}
+
+void Scheduler::swap(u32 a, u32 b) {
+  std::swap(m_heap[a], m_heap[b]);
+  m_heap_pos[index(m_heap[a])] = a;
+  m_heap_pos[index(m_heap[b])] = b;
+}
+
+bool Scheduler::is_earlier(u32 a, u32 b) const {
+  // Events due at the same cycle run in declaration order
+  const auto deadline_a = m_deadlines[index(m_heap[a])];
+  const auto deadline_b = m_deadlines[index(m_heap[b])];
+  return deadline_a < deadline_b || (deadline_a == deadline_b && m_heap[a] < m_heap[b]);
+}
+
+}  // namespace cpu
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <util/serializer.hpp>
+#include <util/types.hpp>
+
+#include <array>
+
+namespace cpu {
+
+class Cpu;
+
+// Things devices need to happen at a given cycle
+enum class Event : u8 {
+  Vblank,       // Gpu: end of the frame
+  Timers,       // Timers: a counter reaches its target or 0xFFFF
+  DmaIrq,       // Dma: a transfer finished
+  CdromIrq,     // CdromDrive: the first queued response is delivered
+  CdromSector,  // CdromDrive: the next sector is read
+  JoypadAck,    // Joypad: the selected device acknowledges the last byte
+
+  Count,
+};
+constexpr u32 EVENT_COUNT = static_cast<u32>(Event::Count);
+
+const char* event_to_str(Event event);
+
+// Keeps the cycle (of the Cpu's clock) each pending event is due at, in a min-heap indexed by event so
+// that rescheduling is cheap. The Cpu runs until the earliest one (see Cpu::step), then those that are
+// due are run, and it resumes until the next.
+// Devices schedule their events when what they depend on changes, e.g. when a command or register write
+// starts something. Scheduling an event before the end of the current Cpu step shortens it.
+class Scheduler {
+ public:
+  static constexpr u64 NEVER = ~0ull;
+
+  void init(Cpu* cpu) { m_cpu = cpu; }
+
+  // Cycles elapsed since reset, as far as the Cpu has gotten
+  u64 now() const;
+
+  // Makes event happen at cycle (or right away if it's in the past), replacing its previous deadline
+  void schedule(Event event, u64 cycle);
+  void schedule_in(Event event, u64 cycles) { schedule(event, now() + cycles); }
+  void cancel(Event event);
+
+  bool is_scheduled(Event event) const { return deadline(event) != NEVER; }
+  u64 deadline(Event event) const { return m_deadlines[index(event)]; }
+  // Of the earliest pending event, NEVER if there's none
+  u64 next_deadline() const { return m_heap_size ? m_deadlines[index(m_heap[0])] : NEVER; }
+
+  // Removes the earliest event that's due by now() and returns true, false if there's none
+  bool pop_due(Event& event);
+
+  void serialize(util::Serializer& s);
+
+ private:
+  static u32 index(Event event) { return static_cast<u32>(event); }
+
+  void remove(Event event);
+  void sift_up(u32 pos);
+  void sift_down(u32 pos);
+  void swap(u32 a, u32 b);
+  bool is_earlier(u32 a, u32 b) const;
+
+ private:
+  std::array<u64, EVENT_COUNT> m_deadlines = [] {
+    std::array<u64, EVENT_COUNT> deadlines{};
+    deadlines.fill(NEVER);
+    return deadlines;
+  }();
+
+  std::array<Event, EVENT_COUNT> m_heap{};    // Pending events, earliest first
+  std::array<u32, EVENT_COUNT> m_heap_pos{};  // Of each pending event in m_heap
+  u32 m_heap_size{};
+
+  Cpu* m_cpu{};
+};
+
+}  // namespace cpu
@@ -0,0 +1,46 @@
+#include <cpu/trace.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace cpu {
+
+std::vector<TraceEntry> TraceBuffer::copy_entries() const {
+  if (!m_entries)
+    return {};
+
+  const u64 end = written();
+  const u64 begin = end > CAPACITY ? end - CAPACITY : 0;
+
+  std::vector<TraceEntry> entries;
+  entries.reserve(end - begin);
+  for (u64 i = begin; i < end; ++i)
+    entries.push_back((*m_entries)[i & (CAPACITY - 1)]);
+
+  // The writer may have lapped us while copying, the oldest entries could be newer ones by now. The
+  // slot after the last written entry may be mid-write too.
+  const u64 end_after = written() + 1;
+  const u64 overwritten = end_after > begin + CAPACITY ? end_after - (begin + CAPACITY) : 0;
+  entries.erase(entries.begin(), entries.begin() + std::min<u64>(overwritten, entries.size()));
+
+  return entries;
+}
+
+bool TraceBuffer::save(const fs::path& path, bool has_regs) const {
+  const auto entries = copy_entries();
+
+  TraceFileHeader header{};
+  std::memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+  header.version = TRACE_FILE_VERSION;
+  header.has_regs = has_regs;
+  header.entry_count = entries.size();
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs.write((const char*)&header, sizeof(header));
+  ofs.write((const char*)entries.data(), entries.size() * sizeof(TraceEntry));
+
+  return bool(ofs);
+}
+
+}  // namespace cpu
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <util/fs.hpp>
+#include <util/types.hpp>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace cpu {
+
+// One executed instruction
+struct TraceEntry {
+  u32 pc;
+  u32 word;
+  // Registers written while executing it (including a delayed load landing), 0 if none. Only
+  // recorded when tracing registers.
+  std::array<u8, 2> reg_index;
+  std::array<u32, 2> reg_value;
+};
+static_assert(sizeof(TraceEntry) == 20, "TraceEntry is saved as-is");
+
+struct TraceFileHeader {
+  char magic[8];  // "PCTTRACE"
+  u32 version;
+  u32 has_regs;
+  u64 entry_count;
+};
+
+constexpr char TRACE_FILE_MAGIC[8] = { 'P', 'C', 'T', 'T', 'R', 'A', 'C', 'E' };
+constexpr u32 TRACE_FILE_VERSION = 1;
+
+// Fixed-size ring of the most recently executed instructions, in binary form. Written by the emulation
+// thread only, it can be read from another one without locking (see copy_entries).
+class TraceBuffer {
+ public:
+  static constexpr u32 CAPACITY = 1 << 20;  // Entries, must be a power of 2
+
+  // The buffer is big, so it's only allocated once tracing is first enabled
+  void allocate() {
+    if (!m_entries)
+      m_entries = std::make_unique<std::array<TraceEntry, CAPACITY>>();
+  }
+
+  void push(const TraceEntry& entry) {
+    const u64 written = m_written.load(std::memory_order_relaxed);
+    (*m_entries)[written & (CAPACITY - 1)] = entry;
+    m_written.store(written + 1, std::memory_order_release);
+  }
+
+  void clear() { m_written.store(0, std::memory_order_release); }
+  u64 written() const { return m_written.load(std::memory_order_acquire); }
+
+  // Oldest to newest. Entries overwritten by the writer while copying are dropped.
+  std::vector<TraceEntry> copy_entries() const;
+  // Saves a trace file, for tools/trace_decoder. Returns false on failure.
+  bool save(const fs::path& path, bool has_regs) const;
+
+ private:
+  std::unique_ptr<std::array<TraceEntry, CAPACITY>> m_entries;
+  std::atomic<u64> m_written{};  // Total entries pushed since the last clear
+};
+
+}  // namespace cpu
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <util/types.hpp>
+
+#include <gsl-lite.hpp>
+
+#include <cstring>
+
+// Minimal x86-64 machine code emitter, only implements what cpu::Recompiler needs.
+// Context memory operands are always [rbx + disp32], rbx holds the guest context (the cpu::Cpu
+// instance).
+// Guest memory operands are [base + index], with base pointing to the memory::Fastmem region.
+
+namespace cpu {
+namespace x64 {
+
+enum Reg : u8 {
+  RAX = 0,
+  RCX = 1,
+  RDX = 2,
+  RBX = 3,
+  RSP = 4,
+  RBP = 5,
+  RSI = 6,
+  RDI = 7,
+};
+
+enum Condition : u8 {
+  CC_B = 0x2,   // Below (unsigned <)
+  CC_AE = 0x3,  // Above or equal (unsigned >=)
+  CC_E = 0x4,   // Equal
+  CC_NE = 0x5,  // Not equal
+  CC_S = 0x8,   // Sign
+  CC_NS = 0x9,  // Not sign
+  CC_L = 0xC,   // Less (signed <)
+  CC_GE = 0xD,  // Greater or equal (signed >=)
+  CC_LE = 0xE,  // Less or equal (signed <=)
+  CC_G = 0xF,   // Greater (signed >)
+};
+
+enum AluOp : u8 {
+  ALU_ADD = 0,
+  ALU_OR = 1,
+  ALU_AND = 4,
+  ALU_SUB = 5,
+  ALU_XOR = 6,
+  ALU_CMP = 7,
+};
+
+enum ShiftOp : u8 {
+  SHIFT_SHL = 4,
+  SHIFT_SHR = 5,
+  SHIFT_SAR = 7,
+};
+
+class Emitter {
+ public:
+  Emitter(u8* code, u32 capacity) : m_begin(code), m_cur(code), m_end(code + capacity) {}
+
+  u8* begin() const { return m_begin; }
+  u8* cursor() const { return m_cur; }
+  u32 size() const { return static_cast<u32>(m_cur - m_begin); }
+
+  //
+  // Context memory operands
+  //
+
+  // mov dst, dword [rbx + disp]
+  void mov_r32_mem(Reg dst, s32 disp) { op_mem(0x8B, dst, disp); }
+  // mov dword [rbx + disp], src
+  void mov_mem_r32(s32 disp, Reg src) { op_mem(0x89, src, disp); }
+  // mov dword [rbx + disp], imm
+  void mov_mem_imm32(s32 disp, u32 imm) {
+    op_mem(0xC7, 0, disp);
+    emit32(imm);
+  }
+  // mov byte [rbx + disp], src
+  void mov_mem_r8(s32 disp, Reg src) { op_mem(0x88, src, disp); }
+  // mov byte [rbx + disp], imm
+  void mov_mem_imm8(s32 disp, u8 imm) {
+    op_mem(0xC6, 0, disp);
+    emit8(imm);
+  }
+  // movzx dst, byte [rbx + disp]
+  void movzx_r32_mem8(Reg dst, s32 disp) {
+    emit8(0x0F);
+    op_mem(0xB6, dst, disp);
+  }
+  // or dst, byte [rbx + disp]
+  void or_r8_mem8(Reg dst, s32 disp) { op_mem(0x0A, dst, disp); }
+  // or byte [rbx + disp], imm
+  void or_mem8_imm8(s32 disp, u8 imm) {
+    op_mem(0x80, 1, disp);
+    emit8(imm);
+  }
+  // cmp byte [rbx + disp], imm
+  void cmp_mem8_imm8(s32 disp, u8 imm) {
+    op_mem(0x80, 7, disp);
+    emit8(imm);
+  }
+  // mov dst, qword [rbx + disp]
+  void mov_r64_mem(Reg dst, s32 disp) {
+    emit8(0x48);
+    op_mem(0x8B, dst, disp);
+  }
+  // cmp src, qword [rbx + disp]
+  void cmp_r64_mem(Reg src, s32 disp) {
+    emit8(0x48);
+    op_mem(0x3B, src, disp);
+  }
+  // add qword [rbx + disp], imm (sign-extended)
+  void add_mem64_imm32(s32 disp, u32 imm) {
+    emit8(0x48);
+    op_mem(0x81, 0, disp);
+    emit32(imm);
+  }
+  // add qword [rbx + disp], src
+  void add_mem64_r64(s32 disp, Reg src) {
+    emit8(0x48);
+    op_mem(0x01, src, disp);
+  }
+
+  //
+  // Guest memory operands. memory::Fastmem decodes these when they fault, it has to understand any new
+  // form.
+  //
+
+  // mov dst, dword [base + index]
+  void mov_r32_guest(Reg dst, Reg base, Reg index) { op_guest(0x8B, dst, base, index); }
+  // movzx dst, byte [base + index]
+  void movzx_r32_guest8(Reg dst, Reg base, Reg index) {
+    emit8(0x0F);
+    op_guest(0xB6, dst, base, index);
+  }
+  // movzx dst, word [base + index]
+  void movzx_r32_guest16(Reg dst, Reg base, Reg index) {
+    emit8(0x0F);
+    op_guest(0xB7, dst, base, index);
+  }
+  // movsx dst, byte [base + index]
+  void movsx_r32_guest8(Reg dst, Reg base, Reg index) {
+    emit8(0x0F);
+    op_guest(0xBE, dst, base, index);
+  }
+  // movsx dst, word [base + index]
+  void movsx_r32_guest16(Reg dst, Reg base, Reg index) {
+    emit8(0x0F);
+    op_guest(0xBF, dst, base, index);
+  }
+  // mov dword [base + index], src
+  void mov_guest_r32(Reg base, Reg index, Reg src) { op_guest(0x89, src, base, index); }
+  // mov word [base + index], src
+  void mov_guest_r16(Reg base, Reg index, Reg src) {
+    emit8(0x66);
+    op_guest(0x89, src, base, index);
+  }
+  // mov byte [base + index], src (al, cl, dl or bl)
+  void mov_guest_r8(Reg base, Reg index, Reg src) {
+    Expects(src < RSP);
+    op_guest(0x88, src, base, index);
+  }
+
+  //
+  // Register operands
+  //
+
+  void mov_r32_imm32(Reg dst, u32 imm) {
+    emit8(0xB8 + dst);
+    emit32(imm);
+  }
+  void mov_r64_imm64(Reg dst, u64 imm) {
+    emit8(0x48);
+    emit8(0xB8 + dst);
+    emit64(imm);
+  }
+  void mov_r64_r64(Reg dst, Reg src) {
+    emit8(0x48);
+    emit8(0x89);
+    modrm_reg(src, dst);
+  }
+  // <op> dst, src
+  void alu_r32_r32(AluOp op, Reg dst, Reg src) {
+    emit8((op << 3) | 0x1);
+    modrm_reg(src, dst);
+  }
+  // <op> dst, imm
+  void alu_r32_imm32(AluOp op, Reg dst, u32 imm) {
+    emit8(0x81);
+    modrm_reg(op, dst);
+    emit32(imm);
+  }
+  void xor_r32_r32(Reg dst, Reg src) { alu_r32_r32(ALU_XOR, dst, src); }
+  void test_r32_r32(Reg a, Reg b) {
+    emit8(0x85);
+    modrm_reg(b, a);
+  }
+  void test_r32_imm32(Reg r, u32 imm) {
+    emit8(0xF7);
+    modrm_reg(0, r);
+    emit32(imm);
+  }
+  void not_r32(Reg r) {
+    emit8(0xF7);
+    modrm_reg(2, r);
+  }
+  // <op> r, imm
+  void shift_r32_imm8(ShiftOp op, Reg r, u8 imm) {
+    emit8(0xC1);
+    modrm_reg(op, r);
+    emit8(imm);
+  }
+  // <op> r, cl
+  void shift_r32_cl(ShiftOp op, Reg r) {
+    emit8(0xD3);
+    modrm_reg(op, r);
+  }
+  // set<cc> r (low byte), then zero-extend it to 32 bits
+  void setcc_r32(Condition cc, Reg r) {
+    emit8(0x0F);
+    emit8(0x90 + cc);
+    modrm_reg(0, r);
+    emit8(0x0F);
+    emit8(0xB6);
+    modrm_reg(r, r);
+  }
+
+  //
+  // Control flow
+  //
+
+  // Forward jumps, returns the location to patch with bind()
+  u8* jcc_short(Condition cc) {
+    emit8(0x70 + cc);
+    emit8(0);
+    return m_cur;
+  }
+  u8* jcc_near(Condition cc) {
+    emit8(0x0F);
+    emit8(0x80 + cc);
+    emit32(0);
+    return m_cur;
+  }
+  u8* jmp_near() {
+    emit8(0xE9);
+    emit32(0);
+    return m_cur;
+  }
+  // Points a forward short jump to the current location
+  void bind_short(u8* jump_end) {
+    const auto rel = m_cur - jump_end;
+    Expects(rel <= 127);
+    jump_end[-1] = static_cast<u8>(rel);
+  }
+  // Points a forward near jump (or conditional jump) to the current location
+  void bind_near(u8* jump_end) {
+    const s32 rel = static_cast<s32>(m_cur - jump_end);
+    std::memcpy(jump_end - 4, &rel, sizeof(rel));
+  }
+  void call_r64(Reg r) {
+    emit8(0xFF);
+    modrm_reg(2, r);
+  }
+  void push_r64(Reg r) { emit8(0x50 + r); }
+  void pop_r64(Reg r) { emit8(0x58 + r); }
+  void sub_rsp_imm8(u8 imm) {
+    emit8(0x48);
+    emit8(0x83);
+    modrm_reg(5, RSP);
+    emit8(imm);
+  }
+  void add_rsp_imm8(u8 imm) {
+    emit8(0x48);
+    emit8(0x83);
+    modrm_reg(0, RSP);
+    emit8(imm);
+  }
+  void ret() { emit8(0xC3); }
+
+ private:
+  void emit8(u8 v) {
+    Expects(m_cur < m_end);
+    *m_cur++ = v;
+  }
+  void emit32(u32 v) {
+    Expects(m_cur + sizeof(v) <= m_end);
+    std::memcpy(m_cur, &v, sizeof(v));
+    m_cur += sizeof(v);
+  }
+  void emit64(u64 v) {
+    Expects(m_cur + sizeof(v) <= m_end);
+    std::memcpy(m_cur, &v, sizeof(v));
+    m_cur += sizeof(v);
+  }
+  // ModRM with a register direct operand
+  void modrm_reg(u8 reg, Reg rm) { emit8(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+  // Opcode followed by ModRM for [rbx + disp32]
+  void op_mem(u8 opcode, u8 reg, s32 disp) {
+    emit8(opcode);
+    emit8(0x80 | ((reg & 7) << 3) | RBX);
+    emit32(static_cast<u32>(disp));
+  }
+  // Opcode followed by ModRM and SIB for [base + index]
+  void op_guest(u8 opcode, u8 reg, Reg base, Reg index) {
+    Expects(base != RBP && index != RSP);  // Those would need a displacement or mean no index
+    emit8(opcode);
+    emit8(((reg & 7) << 3) | 0x4);
+    emit8(((index & 7) << 3) | (base & 7));
+  }
+
+  u8* m_begin;
+  u8* m_cur;
+  u8* m_end;
+};
+
+}  // namespace x64
+}  // namespace cpu
@@ -1,27 +1,59 @@
 #include <emulator/emulator.hpp>
 
 #include <util/fs.hpp>
+#include <util/load_file.hpp>
+#include <util/log.hpp>
 
 #include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <system_error>
 #include <tuple>
 
 namespace emulator {
 
+constexpr auto CPU_TRACE_FILENAME = "pctation_cpu.trace";  // Decode with tools/trace_decoder
+constexpr auto CPU_PROFILE_FILENAME = "pctation_cpu.folded";  // Folded stacks, for flame graphs
+constexpr auto BUS_STATS_FILENAME = "pctation_bus_stats.json";
+constexpr auto BOOT_SNAPSHOT_DIR = "data/snapshots";
+constexpr char BOOT_SNAPSHOT_MAGIC[8] = { 'P', 'C', 'T', 'S', 'N', 'A', 'P', '\0' };
+constexpr u32 BOOT_SNAPSHOT_VERSION = 2;  // Bump when any serialize() method changes
+
+static_assert(memory::VRAM_SIZE == gpu::VRAM_WIDTH * gpu::VRAM_HEIGHT * sizeof(u16),
+              "The arena's VRAM must fit the GPU's");
+
+// FNV-1a. Chain hashes by passing the previous one as hash.
+static u64 hash_bytes(const byte* data, size_t size, u64 hash = 0xCBF29CE484222325) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 0x100000001B3;
+  }
+  return hash;
+}
+
 Emulator::Emulator(const fs::path& bios_path,
                    const fs::path& psx_exe_path,
                    const fs::path& bootstrap_path,
-                   const fs::path& cdrom_path)
+                   const fs::path& cdrom_path,
+                   bool headless,
+                   bool huge_pages,
+                   bool boot_snapshot)
     : m_settings(),
-      m_bios(bios_path),
-      m_expansion(bootstrap_path),
+      m_arena(huge_pages),
+      m_bios(bios_path, m_arena.bios()),
+      m_expansion(bootstrap_path, m_arena.expansion()),
       m_interrupts(),
-      m_ram(psx_exe_path),
-      m_gpu(),
-      m_spu(),
+      m_scheduler(),
+      m_scratchpad(m_arena.scratchpad()),
+      m_ram(psx_exe_path, m_arena.ram()),
+      m_gpu(m_arena.vram()),
+      m_spu(m_arena.spu()),
       m_cdrom(),
       m_timers(),
-      m_dma(m_ram, m_gpu, m_interrupts, m_cdrom),
-      m_bus(m_bios,
+      m_dma(m_ram, m_gpu, m_interrupts, m_scheduler, m_cdrom),
+      m_bus(m_arena,
+            m_bios,
             m_expansion,
             m_interrupts,
             m_scratchpad,
@@ -34,40 +66,263 @@ Emulator::Emulator(const fs::path& bios_path,
             m_timers),
       m_cpu(m_bus, m_settings) {
   m_interrupts.init(&m_cpu);
-  m_joypad.init(&m_interrupts);
-  m_timers.init(&m_interrupts);
-  m_cdrom.init(&m_interrupts);
+  m_scheduler.init(&m_cpu);
+  m_gpu.init(&m_scheduler);
+  m_joypad.init(&m_interrupts, &m_scheduler);
+  m_timers.init(&m_interrupts, &m_scheduler);
+  m_cdrom.init(&m_interrupts, &m_scheduler);
 
   if (!cdrom_path.empty())
     m_cdrom.insert_disk_file(cdrom_path);
 
-  m_screen_renderer.set_texture_size(gpu::VRAM_WIDTH, gpu::VRAM_HEIGHT);
+  if (!headless) {
+    m_screen_renderer = std::make_unique<renderer::ScreenRenderer>();
+    m_screen_renderer->set_texture_size(gpu::VRAM_WIDTH, gpu::VRAM_HEIGHT);
+  }
+
+  // The executable's code might have been translated ahead of time, and built next to it
+  if (!psx_exe_path.empty()) {
+    auto aot_module_path = psx_exe_path;
+    aot_module_path.replace_extension(cpu::AOT_MODULE_EXTENSION);
+    if (fs::exists(aot_module_path))
+      m_cpu.load_aot_module(aot_module_path);
+  }
+
+  // The expansion ROM can run code during the boot, and its cheat switch changes how the BIOS boots
+  m_boot_hash = hash_bytes(m_bios.data().data(), m_bios.data().size());
+  m_boot_hash = hash_bytes(m_expansion.data_ptr(), memory::EXPANSION_1_SIZE, m_boot_hash);
+
+  m_use_boot_snapshot = boot_snapshot;
+  m_boot_snapshot_loaded = m_use_boot_snapshot && load_boot_snapshot();
+  if (m_boot_snapshot_loaded) {
+    LOG_INFO("Loaded boot snapshot {}", boot_snapshot_path().string());
+    on_shell_entry();
+  } else
+    m_cpu.stop_at_shell_entry();
+}
+
+Emulator::~Emulator() {
+  if (m_bus_stats.total() == 0)
+    return;
+
+  if (m_bus_stats.save_json(BUS_STATS_FILENAME))
+    LOG_INFO("Saved bus access statistics to {}", BUS_STATS_FILENAME);
+  else
+    LOG_WARN("Couldn't save bus access statistics to {}", BUS_STATS_FILENAME);
+}
+
+void Emulator::serialize(util::Serializer& s) {
+  m_interrupts.serialize(s);
+  m_scheduler.serialize(s);
+  m_scratchpad.serialize(s);
+  m_ram.serialize(s);
+  m_gpu.serialize(s);
+  m_spu.serialize(s);
+  m_joypad.serialize(s);
+  m_cdrom.serialize(s);
+  m_timers.serialize(s);
+  m_dma.serialize(s);
+  m_bus.serialize(s);
+  m_cpu.serialize(s);
+}
+
+fs::path Emulator::boot_snapshot_path() const {
+  return fs::path(BOOT_SNAPSHOT_DIR) / fmt::format("{:016X}.state", m_boot_hash);
+}
+
+bool Emulator::load_boot_snapshot() {
+  const auto path = boot_snapshot_path();
+  if (!fs::exists(path))
+    return false;
+
+  buffer buf = util::load_file(path);
+
+  // The trailer (see save_boot_snapshot) has to match, or the file was cut short or mangled
+  u64 trailer[2]{};
+  const bool has_trailer = buf.size() >= sizeof(trailer);
+  if (has_trailer) {
+    std::memcpy(trailer, buf.data() + buf.size() - sizeof(trailer), sizeof(trailer));
+    buf.resize(buf.size() - sizeof(trailer));
+  }
+  if (!has_trailer || trailer[0] != buf.size() || trailer[1] != hash_bytes(buf.data(), buf.size())) {
+    LOG_WARN("Boot snapshot {} is corrupt, deleting it", path.string());
+    discard_boot_snapshot();
+    return false;
+  }
+
+  util::Serializer s(util::Serializer::Mode::Load, buf);
+
+  char magic[sizeof(BOOT_SNAPSHOT_MAGIC)]{};
+  u32 version{};
+  u64 boot_hash{};
+  s.value(magic);
+  s.value(version);
+  s.value(boot_hash);
+
+  if (!s.ok() || std::memcmp(magic, BOOT_SNAPSHOT_MAGIC, sizeof(magic)) != 0 ||
+      version != BOOT_SNAPSHOT_VERSION || boot_hash != m_boot_hash) {
+    LOG_WARN("Ignoring stale boot snapshot {}", path.string());
+    return false;
+  }
+
+  // Keep the power-on state, to go back to it if the snapshot doesn't fit the components
+  buffer cold_state;
+  util::Serializer cold_save(util::Serializer::Mode::Save, cold_state);
+  serialize(cold_save);
+
+  serialize(s);
+
+  if (!s.ok()) {
+    LOG_ERROR("Boot snapshot {} doesn't match the saved state, deleting it", path.string());
+    util::Serializer cold_load(util::Serializer::Mode::Load, cold_state);
+    serialize(cold_load);
+    discard_boot_snapshot();
+    return false;
+  }
+  return true;
+}
+
+void Emulator::discard_boot_snapshot() {
+  std::error_code ec;
+  fs::remove(boot_snapshot_path(), ec);
+}
+
+void Emulator::save_boot_snapshot() {
+  buffer buf;
+  util::Serializer s(util::Serializer::Mode::Save, buf);
+
+  char magic[sizeof(BOOT_SNAPSHOT_MAGIC)];
+  std::memcpy(magic, BOOT_SNAPSHOT_MAGIC, sizeof(magic));
+  auto version = BOOT_SNAPSHOT_VERSION;
+  s.value(magic);
+  s.value(version);
+  s.value(m_boot_hash);
+  serialize(s);
+
+  // Trailer: payload size and hash, checked before anything is restored
+  const u64 trailer[2] = { buf.size(), hash_bytes(buf.data(), buf.size()) };
+  const auto trailer_bytes = reinterpret_cast<const byte*>(trailer);
+  buf.insert(buf.end(), trailer_bytes, trailer_bytes + sizeof(trailer));
+
+  const auto path = boot_snapshot_path();
+  fs::create_directories(path.parent_path());
+
+  // Written to a file of our own and renamed over the snapshot, so that a crash or another emulator
+  // saving at the same time never leaves a partial one behind
+  std::random_device random;
+  const auto temp_name =
+      fmt::format("{}.{:08X}{:08X}.tmp", path.filename().string(), random(), random());
+  const auto temp_path = path.parent_path() / temp_name;
+  {
+    std::ofstream ofs(temp_path, std::ios::binary | std::ios::trunc);
+    if (!ofs.write((const char*)buf.data(), buf.size()) || !ofs.flush()) {
+      LOG_WARN("Couldn't write boot snapshot {}", temp_path.string());
+      ofs.close();
+      std::error_code ec;
+      fs::remove(temp_path, ec);
+      return;
+    }
+  }
+
+  std::error_code ec;
+  fs::rename(temp_path, path, ec);
+  if (ec) {
+    LOG_WARN("Couldn't save boot snapshot {}: {}", path.string(), ec.message());
+    fs::remove(temp_path, ec);
+    return;
+  }
+  LOG_INFO("Saved boot snapshot {}", path.string());
+}
+
+void Emulator::on_shell_entry() {
+  // Sideload the executable now that the kernel is set up, instead of letting the shell run
+  memory::PSEXELoadInfo psx_exe_load_info;
+  if (m_ram.load_executable(psx_exe_load_info))
+    m_cpu.sideload_executable(psx_exe_load_info);
+
+  m_booted = true;
+}
+
+bool Emulator::unshare_memory() {
+  auto& fastmem = m_bus.fastmem();
+  const bool keep_memfd =
+      fastmem.base() && m_settings.fastmem && m_settings.cpu_engine == CpuEngine::Recompiler;
+
+  if (!keep_memfd) {
+    // Its views are of the shared memfd
+    m_ram.set_fastmem(nullptr);
+    fastmem.release();
+  }
+
+  if (!m_arena.unshare(keep_memfd)) {
+    LOG_ERROR("Couldn't unshare emulated memory");
+    return false;
+  }
+
+  if (keep_memfd) {
+    if (!fastmem.remap(m_arena)) {
+      m_ram.set_fastmem(nullptr);
+      return true;
+    }
+    m_ram.set_fastmem(&fastmem);  // Protects pages again
+  }
+  return true;
 }
 
 void Emulator::advance_frame() {
-  // Run in 300 cycle chunks
-  // Estimate that the CPU effectively runs at a 1/3 of the system clock (due to memory delays etc)
-  const u32 system_cycle_quantum = 300;
-  const u32 cpu_cycle_quantum = system_cycle_quantum / 3;
+  // Emulation stays stopped while a breakpoint has paused it
+  if (m_cpu.debugger().paused())
+    return;
+
+  // Settings and breakpoints only change between frames
+  m_cpu.select_step_variant();
 
   while (true) {
-    m_cpu.step(cpu_cycle_quantum);
+    // Nothing else happens until the next event, the Cpu runs undisturbed until then
+    m_cpu.step(m_scheduler.next_deadline());
 
-    m_dma.step();
-    m_cdrom.step();
-    m_timers.step(system_cycle_quantum);
-    m_joypad.step();
+    if (m_cpu.debugger().paused())
+      return;
 
-    if (m_gpu.step(system_cycle_quantum)) {
-      m_bus.m_interrupts.trigger(cpu::IrqType::VBLANK);
-      // Frame emulated, return to render it
+    if (m_cpu.reached_shell_entry()) {
+      if (m_use_boot_snapshot)
+        save_boot_snapshot();
+      on_shell_entry();
+    }
+
+    // Frame emulated, return to render it
+    if (run_events())
       return;
+  }
+}
+
+bool Emulator::run_events() {
+  bool frame_done = false;
+
+  cpu::Event event;
+  while (m_scheduler.pop_due(event)) {
+    switch (event) {
+      case cpu::Event::Vblank:
+        m_gpu.on_vblank();
+        m_bus.m_interrupts.trigger(cpu::IrqType::VBLANK);
+        // Counters are otherwise only brought up to date when accessed, keep the debug view current
+        m_timers.sync();
+        frame_done = true;
+        break;
+      case cpu::Event::Timers: m_timers.on_event(); break;
+      case cpu::Event::DmaIrq: m_dma.on_irq_event(); break;
+      case cpu::Event::CdromIrq: m_cdrom.on_irq_event(); break;
+      case cpu::Event::CdromSector: m_cdrom.on_sector_event(); break;
+      case cpu::Event::JoypadAck: m_joypad.on_ack_event(); break;
+      default: LOG_ERROR("Unhandled event {}", cpu::event_to_str(event)); break;
     }
   }
+  return frame_done;
 }
 
 void Emulator::render() {
-  m_screen_renderer.render((const void*)m_gpu.vram().data());
+  if (m_screen_renderer)
+    m_screen_renderer->render((const void*)m_gpu.vram().data());
 }
 
 void Emulator::set_view(View view) {
@@ -84,7 +339,8 @@ void Emulator::set_view(View view) {
       break;
   }
 
-  m_screen_renderer.set_texture_size(m_settings.res_width, m_settings.res_height);
+  if (m_screen_renderer)
+    m_screen_renderer->set_texture_size(m_settings.res_width, m_settings.res_height);
 }
 
 void Emulator::update_settings() {
@@ -93,6 +349,31 @@ void Emulator::update_settings() {
     // We leave screen_view_changed to true so that the GUI code can pick it up and change the window
     // size too
   }
+
+  if (m_settings.trace_cpu != m_trace_cpu_old) {
+    if (m_settings.trace_cpu)
+      m_cpu.trace().clear();
+    else if (m_cpu.trace().save(CPU_TRACE_FILENAME, m_settings.trace_cpu_regs))
+      LOG_INFO("Saved CPU trace to {}", CPU_TRACE_FILENAME);
+    else
+      LOG_WARN("Couldn't save CPU trace to {}", CPU_TRACE_FILENAME);
+    m_trace_cpu_old = m_settings.trace_cpu;
+  }
+
+  if (m_settings.profile_cpu != m_profile_cpu_old) {
+    if (m_settings.profile_cpu)
+      m_cpu.profiler().reset(m_cpu.cycles());
+    else if (m_cpu.profiler().save_folded(CPU_PROFILE_FILENAME))
+      LOG_INFO("Saved CPU profile to {}", CPU_PROFILE_FILENAME);
+    else
+      LOG_WARN("Couldn't save CPU profile to {}", CPU_PROFILE_FILENAME);
+    m_profile_cpu_old = m_settings.profile_cpu;
+  }
+
+  if (m_settings.bus_stats != m_bus_stats_old) {
+    m_bus.set_stats(m_settings.bus_stats ? &m_bus_stats : nullptr);
+    m_bus_stats_old = m_settings.bus_stats;
+  }
 }
 
 }  // namespace emulator
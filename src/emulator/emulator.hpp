@@ -4,11 +4,13 @@
 #include <bus/bus.hpp>
 #include <cpu/cpu.hpp>
 #include <cpu/interrupt.hpp>
+#include <cpu/scheduler.hpp>
 #include <emulator/settings.hpp>
 #include <gpu/gpu.hpp>
 #include <io/cdrom_drive.hpp>
 #include <io/joypad.hpp>
 #include <io/timers.hpp>
+#include <memory/arena.hpp>
 #include <memory/dma.hpp>
 #include <memory/expansion.hpp>
 #include <memory/ram.hpp>
@@ -17,18 +19,32 @@
 
 #include <util/fs.hpp>
 
+#include <memory>
+
 namespace gui {
 class Gui;
 }
 
 namespace emulator {
 
+class LockstepChecker;
+
 class Emulator {
+  friend class LockstepChecker;
+
  public:
+  // Headless emulators don't render, and don't need a graphics context. Emulated memory is backed by
+  // transparent huge pages if huge_pages is set (and the system allows it). Unless boot_snapshot is
+  // cleared, the BIOS boot is skipped when a snapshot of it was saved (see load_boot_snapshot), which
+  // leaves nothing of it to run, debug or lockstep-check.
   explicit Emulator(const fs::path& bios_path,
                     const fs::path& psx_exe_path,
                     const fs::path& bootstrap_path,
-                    const fs::path& cdrom_path);
+                    const fs::path& cdrom_path,
+                    bool headless = false,
+                    bool huge_pages = true,
+                    bool boot_snapshot = true);
+  ~Emulator();  // Saves the bus access statistics, if any were counted
 
   // Advances the emulator state approximately one frame
   void advance_frame();
@@ -40,15 +56,55 @@ class Emulator {
   const memory::Ram& ram() const { return m_ram; }
   const gpu::Gpu& gpu() const { return m_gpu; }
   io::Joypad& joypad() { return m_joypad; }
+  cpu::Debugger& debugger() { return m_cpu.debugger(); }
   const io::Timers& timers() const { return m_timers; }
   Settings& settings() { return m_settings; }
+  const memory::Arena& arena() const { return m_arena; }
+  const bus::AccessStats& bus_stats() const { return m_bus_stats; }
   void update_settings();
 
+  // Past the BIOS shell handoff, with the executable (if any) loaded
+  bool booted() const { return m_booted; }
+
+  // Gives a fork()ed child emulated memory of its own, see memory::Arena::unshare. It stays shared
+  // with its parent otherwise. Native code needs it in a memfd to access it directly, so it's copied
+  // when the recompiler might do that, and copy-on-write otherwise. Returns false on failure, the
+  // emulator mustn't run then.
+  bool unshare_memory();
+
+ private:
+  // Boot snapshot cache. The machine state at the BIOS shell handoff is the same for every launch
+  // with a given BIOS and expansion ROM, so it's saved the first time and restored to skip the BIOS
+  // boot afterwards.
+  void serialize(util::Serializer& s);
+  fs::path boot_snapshot_path() const;
+  // Falls back to a cold boot (deleting the snapshot) if it's stale, corrupt or doesn't fit
+  bool load_boot_snapshot();
+  void save_boot_snapshot();
+  void discard_boot_snapshot();
+  void on_shell_entry();
+
+  // Runs the device events that are due (see cpu::Scheduler), returns true once a frame is done
+  bool run_events();
+
+  u64 m_boot_hash{};  // Of the BIOS and expansion ROM, which the boot snapshot is only valid for
+  bool m_use_boot_snapshot{};
+  bool m_boot_snapshot_loaded{};
+  bool m_booted{};
+
+  bool m_trace_cpu_old{};    // To save the CPU trace when it's turned off
+  bool m_profile_cpu_old{};  // To save the CPU profile when it's turned off
+  bool m_bus_stats_old{};
+
+  bus::AccessStats m_bus_stats;  // Kept across toggling, saved at exit
+
  private:
   // Emulator core components
+  memory::Arena m_arena;  // Backs all emulated memory, comes first
   bios::Bios m_bios;
   memory::Expansion m_expansion;
   cpu::Interrupts m_interrupts;
+  cpu::Scheduler m_scheduler;
   memory::Scratchpad m_scratchpad;
   memory::Ram m_ram;
   gpu::Gpu m_gpu;
@@ -63,7 +119,7 @@ class Emulator {
 
  private:
   // Host fields
-  renderer::ScreenRenderer m_screen_renderer;
+  std::unique_ptr<renderer::ScreenRenderer> m_screen_renderer;  // Null if headless
   emulator::Settings m_settings{};
 };
 
@@ -0,0 +1,85 @@
+#include <emulator/fork_server.hpp>
+
+#include <util/log.hpp>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+
+namespace emulator {
+
+ForkServer::ForkServer(const fs::path& bios_path,
+                       const fs::path& psx_exe_path,
+                       const fs::path& cdrom_path,
+                       CpuEngine engine,
+                       bool fastmem)
+    : m_emulator(std::make_unique<Emulator>(bios_path, psx_exe_path, "", cdrom_path, true)) {
+  m_emulator->settings().cpu_engine = engine;
+  m_emulator->settings().fastmem = fastmem;
+}
+
+ForkServer::~ForkServer() {
+  wait_all();
+}
+
+void ForkServer::boot(u32 frame_count) {
+  while (!m_emulator->booted())
+    m_emulator->advance_frame();
+
+  for (u32 frame = 0; frame < frame_count; ++frame)
+    m_emulator->advance_frame();
+}
+
+s32 ForkServer::spawn(const std::function<s32(Emulator&)>& job) {
+  reap(false);
+
+  // Buffered output would be written by both processes otherwise
+  std::fflush(stdout);
+  std::fflush(stderr);
+
+  const pid_t pid = fork();
+  if (pid < 0) {
+    LOG_ERROR("Couldn't fork a worker: errno {}", errno);
+    return -1;
+  }
+
+  if (pid == 0) {
+    const s32 status = m_emulator->unshare_memory() ? job(*m_emulator) : 1;
+
+    // Skip the destructors and exit handlers, they belong to the server
+    std::fflush(stdout);
+    std::fflush(stderr);
+    _exit(status);
+  }
+
+  m_children.push_back(pid);
+  return pid;
+}
+
+u32 ForkServer::wait_all() {
+  reap(true);
+  return m_failed;
+}
+
+void ForkServer::reap(bool block) {
+  for (auto it = m_children.begin(); it != m_children.end();) {
+    s32 status = 0;
+    pid_t result;
+    do
+      result = waitpid(*it, &status, block ? 0 : WNOHANG);
+    while (result < 0 && errno == EINTR);
+
+    if (result == 0) {  // Still running
+      ++it;
+      continue;
+    }
+
+    if (result < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      ++m_failed;
+    it = m_children.erase(it);
+  }
+}
+
+}  // namespace emulator
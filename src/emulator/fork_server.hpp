@@ -0,0 +1,48 @@
+#pragma once
+
+#include <emulator/emulator.hpp>
+#include <util/fs.hpp>
+#include <util/types.hpp>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace emulator {
+
+// Boots an emulator once, then fork()s workers off it that all start from the booted state, for running
+// many jobs (e.g. regression tests) without paying for the boot each time. Children share the server's
+// memory copy-on-write, so each one only costs the pages it writes.
+// Recompiled code can only access memory directly (Settings::fastmem) if it's in a memfd of its own, so
+// children would have to copy all of it up front. Fastmem is off unless asked for, for that reason.
+// The server's emulator doesn't run anymore once children are spawned, as their memory can be backed by
+// its (see Emulator::unshare_memory). POSIX only.
+class ForkServer {
+ public:
+  ForkServer(const fs::path& bios_path,
+             const fs::path& psx_exe_path,
+             const fs::path& cdrom_path,
+             CpuEngine engine,
+             bool fastmem = false);
+  ~ForkServer();
+
+  // Runs until the BIOS shell handoff (which the boot snapshot can skip), then frame_count more frames
+  void boot(u32 frame_count);
+
+  // Runs job on a copy of the booted emulator, in a child process that exits with the code it returns.
+  // Returns the child's pid, or -1 if it couldn't be started.
+  s32 spawn(const std::function<s32(Emulator&)>& job);
+
+  // Waits for all children to exit, returns how many have failed so far (non-zero exit code, or killed)
+  u32 wait_all();
+
+ private:
+  // Collects the children that exited, waiting for all of them if block is set
+  void reap(bool block);
+
+  std::unique_ptr<Emulator> m_emulator;
+  std::vector<s32> m_children;  // Still running
+  u32 m_failed{};
+};
+
+}  // namespace emulator
@@ -0,0 +1,154 @@
+#include <emulator/lockstep_checker.hpp>
+
+#include <cpu/cpu.hpp>
+#include <util/log.hpp>
+
+#include <algorithm>
+
+namespace emulator {
+
+// Most RAM writes listed in a divergence report, from each emulator
+constexpr size_t MAX_REPORTED_WRITES = 32;
+
+LockstepChecker::LockstepChecker(const fs::path& bios_path,
+                                 const fs::path& psx_exe_path,
+                                 const fs::path& cdrom_path,
+                                 CpuEngine engine,
+                                 bool boot_snapshot)
+    : m_test(std::make_unique<Emulator>(bios_path, psx_exe_path, "", cdrom_path, true, true,
+                                        boot_snapshot)),
+      m_reference(std::make_unique<Emulator>(bios_path, psx_exe_path, "", cdrom_path, true, true,
+                                             boot_snapshot)) {
+  m_test->m_settings.cpu_engine = engine;
+  m_reference->m_settings.cpu_engine = CpuEngine::Interpreter;
+
+  m_test->m_ram.set_write_log(&m_test_writes);
+  m_reference->m_ram.set_write_log(&m_reference_writes);
+
+  m_test->m_cpu.set_lockstep(true);
+  m_reference->m_cpu.set_lockstep(true);
+}
+
+LockstepChecker::~LockstepChecker() {
+  m_test->m_ram.set_write_log(nullptr);
+  m_reference->m_ram.set_write_log(nullptr);
+}
+
+bool LockstepChecker::run_frame() {
+  while (true) {
+    // Both run to the test emulator's next event, they only differ in their Cpu engines
+    if (!step_until(m_test->m_scheduler.next_deadline()))
+      return false;
+
+    // Same as Emulator::advance_frame, minus saving the boot snapshot
+    if (m_test->m_cpu.reached_shell_entry()) {
+      m_test->on_shell_entry();
+      m_reference->on_shell_entry();
+    }
+
+    m_reference->run_events();
+    if (m_test->run_events())
+      return true;
+  }
+}
+
+bool LockstepChecker::step_until(u64 cycles_end) {
+  auto& test = m_test->m_cpu;
+  auto& reference = m_reference->m_cpu;
+
+  // In lockstep, each step() runs a single block (or instruction, when interpreting). The later ones
+  // keep the end the first one set (or that devices brought forward since).
+  m_block_pc = test.m_pc;
+  test.step(cycles_end);
+  reference.step(cycles_end);
+
+  while (true) {
+    // Catch up to the end of the block
+    while (reference.m_instructions < test.m_instructions &&
+           reference.m_cycles < reference.m_cycles_end && !reference.reached_shell_entry())
+      reference.step(reference.m_cycles_end);
+
+    if (!compare())
+      return false;
+
+    if (test.m_cycles >= test.m_cycles_end || test.reached_shell_entry())
+      return true;
+
+    m_block_pc = test.m_pc;
+    test.step(test.m_cycles_end);
+  }
+}
+
+bool LockstepChecker::compare() {
+  const auto& test = m_test->m_cpu;
+  const auto& reference = m_reference->m_cpu;
+
+  std::string differences;
+  const auto check = [&differences](const std::string& name, u64 test_val, u64 reference_val) {
+    if (test_val != reference_val)
+      differences +=
+          fmt::format("  {:<14} test 0x{:08X}, reference 0x{:08X}\n", name, test_val, reference_val);
+  };
+
+  check("pc", test.m_pc, reference.m_pc);
+  check("pc_next", test.m_pc_next, reference.m_pc_next);
+  check("cycles", test.m_cycles, reference.m_cycles);
+  check("instructions", test.m_instructions, reference.m_instructions);
+  for (u8 i = 0; i < 32; ++i)
+    check(cpu::register_to_str(i), test.m_gpr[i], reference.m_gpr[i]);
+  check("hi", test.m_hi, reference.m_hi);
+  check("lo", test.m_lo, reference.m_lo);
+  check("branch_flags", test.m_branch_flags, reference.m_branch_flags);
+  check("load_slot", test.m_slot_current.reg, reference.m_slot_current.reg);
+  check("cop0_status", test.m_cop0_status.word, reference.m_cop0_status.word);
+  check("cop0_cause", test.m_cop0_cause.word, reference.m_cop0_cause.word);
+  check("cop0_epc", test.m_cop0_epc, reference.m_cop0_epc);
+  check("cop0_badvaddr", test.m_cop0_bad_vaddr, reference.m_cop0_bad_vaddr);
+  check("cop0_bpc", test.m_cop0_bpc, reference.m_cop0_bpc);
+  check("cop0_bda", test.m_cop0_bda, reference.m_cop0_bda);
+  check("cop0_bpcm", test.m_cop0_bpcm, reference.m_cop0_bpcm);
+  check("cop0_bdam", test.m_cop0_bdam, reference.m_cop0_bdam);
+  check("cop0_dcic", test.m_cop0_dcic, reference.m_cop0_dcic);
+  check("cop0_jumpdest", test.m_cop0_jumpdest, reference.m_cop0_jumpdest);
+
+  const auto write_mismatch =
+      std::mismatch(m_test_writes.begin(), m_test_writes.end(), m_reference_writes.begin(),
+                    m_reference_writes.end());
+  const bool writes_match =
+      write_mismatch.first == m_test_writes.end() && write_mismatch.second == m_reference_writes.end();
+  if (!writes_match)
+    differences += fmt::format("  RAM writes differ from write #{}\n",
+                               std::distance(m_test_writes.begin(), write_mismatch.first));
+
+  if (differences.empty()) {
+    m_test_writes.clear();
+    m_reference_writes.clear();
+    ++m_blocks_checked;
+    return true;
+  }
+
+  // Dump both states
+  auto& report = m_divergence_report;
+  report = fmt::format("Diverged after the block at 0x{:08X} ({} blocks matched before it)\n",
+                       m_block_pc, m_blocks_checked);
+  report += differences;
+
+  report += "\nRegisters (test / reference):\n";
+  for (u8 i = 0; i < 32; ++i) {
+    report += fmt::format("  {:<5} {:08X} / {:08X}{}", cpu::register_to_str(i), test.m_gpr[i],
+                          reference.m_gpr[i], (i % 4 == 3) ? "\n" : "  ");
+  }
+
+  const auto dump_writes = [&report](const char* name, const std::vector<memory::RamWrite>& writes) {
+    report += fmt::format("\nRAM writes during the block ({}, {} total):\n", name, writes.size());
+    for (size_t i = 0; i < std::min(writes.size(), MAX_REPORTED_WRITES); ++i)
+      report += fmt::format("  #{:<3} [{:08X}] = {:0{}X}\n", i, writes[i].addr, writes[i].val,
+                            writes[i].size * 2);
+  };
+  dump_writes("test", m_test_writes);
+  dump_writes("reference", m_reference_writes);
+
+  return false;
+}
+
+}  // namespace emulator
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <emulator/emulator.hpp>
+#include <emulator/settings.hpp>
+#include <memory/ram.hpp>
+#include <util/fs.hpp>
+#include <util/types.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace emulator {
+
+// Proves a Cpu engine matches the interpreter, by running two emulators in lockstep: one with the engine
+// under test, and one interpreting as a reference. Each has its own bus, RAM and devices, which get the
+// same inputs, so their states only differ if the engines do.
+// They're compared after every block the one under test runs: PC, GPRs, HI/LO, COP0 registers, cycle
+// and instruction counts, and the RAM writes made during the block. Checking stops at the first
+// divergence, with a dump of both states.
+// Both start from the boot snapshot, if any, unless boot_snapshot is cleared to check the BIOS boot too.
+class LockstepChecker {
+ public:
+  LockstepChecker(const fs::path& bios_path,
+                  const fs::path& psx_exe_path,
+                  const fs::path& cdrom_path,
+                  CpuEngine engine,
+                  bool boot_snapshot = true);
+  ~LockstepChecker();
+
+  // Runs until a frame is emulated. Returns false if the states diverged, see divergence_report().
+  bool run_frame();
+
+  u64 blocks_checked() const { return m_blocks_checked; }
+  const std::string& divergence_report() const { return m_divergence_report; }
+
+ private:
+  bool step_until(u64 cycles_end);  // Returns false if the states diverged
+  bool compare();
+
+  std::unique_ptr<Emulator> m_test;
+  std::unique_ptr<Emulator> m_reference;
+
+  // RAM writes since the last comparison
+  std::vector<memory::RamWrite> m_test_writes;
+  std::vector<memory::RamWrite> m_reference_writes;
+
+  address m_block_pc{};  // Start of the block that was last run
+  u64 m_blocks_checked{};
+  std::string m_divergence_report;
+};
+
+}  // namespace emulator
@@ -13,6 +13,11 @@ enum class View : s32 {
 
 enum class ScreenScale : s32 { x1, x1_5, x2, x3, x4 };
 
+enum class CpuEngine : s32 {
+  Interpreter,  // Decode and execute one instruction at a time
+  Recompiler,   // Translate blocks to native code (x86-64 only, falls back to the interpreter elsewhere)
+};
+
 struct Settings {
   View screen_view{ View::Vram };
   bool window_size_changed{ true };
@@ -29,8 +34,16 @@ struct Settings {
   bool limit_framerate{};
   bool limit_framerate_changed{ true };
 
-  // Logging
-  bool log_trace_cpu{};
+  CpuEngine cpu_engine{ CpuEngine::Interpreter };
+  bool fastmem{ true };  // Recompiled code accesses memory directly (see memory/fastmem.hpp)
+  bool hle_bios{};  // Run some BIOS functions natively instead of their code (see bios/hle.hpp)
+
+  // Logging. These are compiled into Cpu::step variants, so the ones that are off cost nothing.
+  bool log_bios_calls{ true };  // Also logs TTY output
+  bool trace_cpu{};       // Record executed instructions (see cpu/trace.hpp), saved when turned off
+  bool trace_cpu_regs{};  // Also record the registers they write
+  bool profile_cpu{};     // Sample guest code (see cpu/profiler.hpp), saved when turned off
+  bool bus_stats{};       // Count bus accesses (see bus/stats.hpp), saved at exit
 
   bool fullscreen{};
   bool fullscreen_changed{};
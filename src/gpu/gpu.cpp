@@ -5,15 +5,16 @@
 
 #include <gsl-lite.hpp>
 
+#include <algorithm>
 #include <bitset>
+#include <cstring>
 #include <functional>
 #include <unordered_map>
 #include <utility>
 
 namespace gpu {
 
-Gpu::Gpu() {
-  m_vram = std::make_unique<std::array<u16, VRAM_WIDTH * VRAM_HEIGHT>>();
+Gpu::Gpu(byte* vram) : m_vram(reinterpret_cast<std::array<u16, VRAM_WIDTH * VRAM_HEIGHT>*>(vram)) {
   m_gp0_cmd.reserve(MAX_GP0_CMD_LEN);
 }
 
@@ -50,23 +51,24 @@ void Gpu::set_vram_idx(u32 vram_idx, u16 val) {
   vram()[vram_idx] = val;
 }
 
-bool Gpu::step(u32 cycles_to_emulate) {
-  m_vblank_cycles_left -= cycles_to_emulate;
+void Gpu::init(cpu::Scheduler* scheduler) {
+  m_scheduler = scheduler;
 
-  bool trigger_vblank = (m_vblank_cycles_left <= 0);
+  m_vblank_cycle = m_scheduler->now() + CPU_CYCLES_PER_FRAME;
+  m_scheduler->schedule(cpu::Event::Vblank, m_vblank_cycle);
+}
 
-  if (trigger_vblank) {
-    m_vblank_cycles_left += CPU_CYCLES_PER_FRAME;
-    ++m_frames;
+void Gpu::on_vblank() {
+  // From when this one was due, so that frames don't drift when the Cpu overshoots
+  m_vblank_cycle += CPU_CYCLES_PER_FRAME;
+  m_scheduler->schedule(cpu::Event::Vblank, m_vblank_cycle);
+  ++m_frames;
 
-    if (GP0_DEBUG_RECORD) {
-      if (m_gp0_cmds_record.size() == 5000)  // Cull at 5000 records
-        m_gp0_cmds_record.clear();
-      m_gp0_cmds_record.emplace_back(std::move(m_gp0_cmds_cur_frame));
-    }
+  if (GP0_DEBUG_RECORD) {
+    if (m_gp0_cmds_record.size() == 5000)  // Cull at 5000 records
+      m_gp0_cmds_record.clear();
+    m_gp0_cmds_record.emplace_back(std::move(m_gp0_cmds_cur_frame));
   }
-
-  return trigger_vblank;
 }
 
 u32 Gpu::setup_vram_transfer(u32 pos_word, u32 size_word) {
@@ -91,6 +93,24 @@ void Gpu::advance_vram_transfer_pos() {
     m_vram_transfer_x++;
 }
 
+void Gpu::advance_vram_transfer_pos(u32 pixel_count) {
+  const auto rect_x = m_vram_transfer_x - m_vram_transfer_x_start;
+  if (rect_x + pixel_count == m_vram_transfer_width) {
+    m_vram_transfer_x = m_vram_transfer_x_start;
+    m_vram_transfer_y++;
+  } else
+    m_vram_transfer_x += pixel_count;
+}
+
+u32 Gpu::vram_transfer_run(u32 pixel_count) const {
+  const u32 row_left = m_vram_transfer_width - (m_vram_transfer_x - m_vram_transfer_x_start);
+  const u32 run = std::min(pixel_count, row_left);
+
+  if (m_vram_transfer_x + run > VRAM_WIDTH || m_vram_transfer_y >= VRAM_HEIGHT)
+    return 0;
+  return run;
+}
+
 DisplayResolution Gpu::get_resolution() const {
   DisplayResolution res;
 
@@ -111,6 +131,30 @@ DisplayResolution Gpu::get_resolution() const {
   return res;
 }
 
+void Gpu::serialize(util::Serializer& s) {
+  s.value(m_gpustat);
+  s.value(m_tex_window);
+  s.value(m_drawing_area_top_left);
+  s.value(m_drawing_area_bottom_right);
+  s.value(m_drawing_offset);
+  s.value(m_draw_mode);
+  s.value(m_display_area);
+  s.value(m_hdisplay_range);
+  s.value(m_vdisplay_range);
+  s.value(*m_vram);
+  s.value(m_vram_transfer_x);
+  s.value(m_vram_transfer_y);
+  s.value(m_vram_transfer_x_start);
+  s.value(m_vram_transfer_width);
+  s.value(m_vram_transfer_height);
+  s.value(m_frames);
+  s.value(m_gp0_cmd_type);
+  s.value(m_gp0_arg_count);
+  s.value(m_gp0_arg_index);
+  s.container(m_gp0_cmd);
+  s.value(m_vblank_cycle);
+}
+
 void Gpu::gp0(u32 cmd) {
   if (m_gp0_cmd_type == Gp0CommandType::None) {
     m_gp0_cmd.clear();
@@ -192,42 +236,73 @@ void Gpu::gp0(u32 cmd) {
       if (cmd == 0x55555555 || cmd == 0x50005000)
         command_issued = true;
 
-  if (command_issued) {
-    if (GP0_DEBUG_RECORD)
-      m_gp0_cmds_cur_frame.push_back({ m_gp0_cmd_type, m_gp0_cmd });
+  if (command_issued)
+    gp0_run_command();
+}
+
+void Gpu::gp0_run_command() {
+  if (GP0_DEBUG_RECORD)
+    m_gp0_cmds_cur_frame.push_back({ m_gp0_cmd_type, m_gp0_cmd });
 
-    // Save temporary and reset it here instead of at the end, because following
-    // handlers might change it themselves type and we wouldn't want to override that
-    const auto cmd_type = m_gp0_cmd_type;
-    m_gp0_cmd_type = Gp0CommandType::None;
+  // Save temporary and reset it here instead of at the end, because following
+  // handlers might change it themselves type and we wouldn't want to override that
+  const auto cmd_type = m_gp0_cmd_type;
+  m_gp0_cmd_type = Gp0CommandType::None;
 
-    // We have all the arguments, we can run the command
-    switch (cmd_type) {
-      case Gp0CommandType::DrawPolygon: {
-        const u8 opcode = m_gp0_cmd[0] >> 24;
-        auto polygon = renderer::rasterizer::DrawCommand{ opcode }.polygon;
-        m_rasterizer.draw_polygon(polygon);
-        break;
-      }
-      case Gp0CommandType::DrawLine: {
-        const u8 opcode = m_gp0_cmd[0] >> 24;
-        auto line = renderer::rasterizer::DrawCommand{ opcode }.line;
-        // TODO:
-        LOG_WARN("Unimplemented rendering of {} line (op: {:02X})", line.is_poly() ? "poly" : "single",
-                 opcode);
-        break;
-      }
-      case Gp0CommandType::DrawRectangle: {
-        const u8 opcode = m_gp0_cmd[0] >> 24;
-        auto rectangle = renderer::rasterizer::DrawCommand{ opcode }.rectangle;
-        m_rasterizer.draw_rectangle(rectangle);
-        break;
-      }
-      case Gp0CommandType::FillRectangleInVram: gp0_fill_rect_in_vram(); break;
-      case Gp0CommandType::CopyCpuToVram: gp0_copy_rect_cpu_to_vram(); break;
-      case Gp0CommandType::CopyVramToCpu: gp0_copy_rect_vram_to_cpu(); break;
-      case Gp0CommandType::CopyVramToVram: gp0_copy_rect_vram_to_vram(); break;
-      case Gp0CommandType::Invalid: break;
+  // We have all the arguments, we can run the command
+  switch (cmd_type) {
+    case Gp0CommandType::DrawPolygon: {
+      const u8 opcode = m_gp0_cmd[0] >> 24;
+      auto polygon = renderer::rasterizer::DrawCommand{ opcode }.polygon;
+      m_rasterizer.draw_polygon(polygon);
+      break;
+    }
+    case Gp0CommandType::DrawLine: {
+      const u8 opcode = m_gp0_cmd[0] >> 24;
+      auto line = renderer::rasterizer::DrawCommand{ opcode }.line;
+      // TODO:
+      LOG_WARN("Unimplemented rendering of {} line (op: {:02X})", line.is_poly() ? "poly" : "single",
+               opcode);
+      break;
+    }
+    case Gp0CommandType::DrawRectangle: {
+      const u8 opcode = m_gp0_cmd[0] >> 24;
+      auto rectangle = renderer::rasterizer::DrawCommand{ opcode }.rectangle;
+      m_rasterizer.draw_rectangle(rectangle);
+      break;
+    }
+    case Gp0CommandType::FillRectangleInVram: gp0_fill_rect_in_vram(); break;
+    case Gp0CommandType::CopyCpuToVram: gp0_copy_rect_cpu_to_vram(); break;
+    case Gp0CommandType::CopyVramToCpu: gp0_copy_rect_vram_to_cpu(); break;
+    case Gp0CommandType::CopyVramToVram: gp0_copy_rect_vram_to_vram(); break;
+    case Gp0CommandType::Invalid: break;
+  }
+}
+
+void Gpu::gp0_batch(gsl::span<const u32> words) {
+  for (size_t i = 0; i < words.size();) {
+    if (m_gp0_cmd_type == Gp0CommandType::CopyCpuToVramTransferring) {
+      // As much image data as is left of the transfer
+      const auto count = std::min<size_t>(words.size() - i, m_gp0_arg_count - m_gp0_arg_index);
+      do_cpu_to_vram_transfer(words.subspan(i, count));
+      i += count;
+      continue;
+    }
+
+    const bool starts_command = (m_gp0_cmd_type == Gp0CommandType::None);
+    gp0(words[i++]);
+
+    // The arguments of a command that was just started are taken at once, if they're all here.
+    // Polylines only end at their terminator, they go through gp0() a word at a time.
+    const size_t arg_count = m_gp0_arg_count;
+    const bool takes_args = m_gp0_cmd_type != Gp0CommandType::None &&
+                            m_gp0_cmd_type != Gp0CommandType::CopyCpuToVramTransferring;
+    const bool has_args = arg_count < MAX_GP0_CMD_LEN - 1 && words.size() - i >= arg_count;
+    if (starts_command && takes_args && has_args) {
+      m_gp0_cmd.insert(m_gp0_cmd.end(), words.begin() + i, words.begin() + i + arg_count);
+      m_gp0_arg_index = m_gp0_arg_count;
+      i += arg_count;
+      gp0_run_command();
     }
   }
 }
@@ -362,6 +437,37 @@ void Gpu::do_cpu_to_vram_transfer(u32 cmd) {
   }
 }
 
+void Gpu::do_cpu_to_vram_transfer(gsl::span<const u32> words) {
+  auto src = reinterpret_cast<const byte*>(words.data());
+  auto pixel_count = static_cast<u32>(words.size()) * 2;
+
+  while (pixel_count > 0) {
+    const auto run = vram_transfer_run(pixel_count);
+
+    // Wraps around VRAM, one pixel at a time
+    if (run == 0) {
+      u16 pixel;
+      std::memcpy(&pixel, src, sizeof(pixel));
+      set_vram_pos<true>(m_vram_transfer_x, m_vram_transfer_y, pixel);
+      advance_vram_transfer_pos();
+      src += sizeof(pixel);
+      --pixel_count;
+      continue;
+    }
+
+    std::memcpy(&vram()[m_vram_transfer_x + m_vram_transfer_y * VRAM_WIDTH], src, run * sizeof(u16));
+    advance_vram_transfer_pos(run);
+    src += run * sizeof(u16);
+    pixel_count -= run;
+  }
+
+  m_gp0_arg_index += static_cast<u32>(words.size());
+  if (m_gp0_arg_index == m_gp0_arg_count) {
+    // Transfer done, start processing new commands
+    m_gp0_cmd_type = Gp0CommandType::None;
+  }
+}
+
 u32 Gpu::dma_read_vram() {
   u32 word = get_vram_pos(m_vram_transfer_x, m_vram_transfer_y);
   advance_vram_transfer_pos();
@@ -371,6 +477,29 @@ u32 Gpu::dma_read_vram() {
   return word;
 }
 
+void Gpu::dma_read_vram(gsl::span<u32> words) {
+  auto dest = reinterpret_cast<byte*>(words.data());
+  auto pixel_count = static_cast<u32>(words.size()) * 2;
+
+  while (pixel_count > 0) {
+    const auto run = vram_transfer_run(pixel_count);
+
+    if (run == 0) {
+      const u16 pixel = get_vram_pos(m_vram_transfer_x, m_vram_transfer_y);
+      std::memcpy(dest, &pixel, sizeof(pixel));
+      advance_vram_transfer_pos();
+      dest += sizeof(pixel);
+      --pixel_count;
+      continue;
+    }
+
+    std::memcpy(dest, &vram()[m_vram_transfer_x + m_vram_transfer_y * VRAM_WIDTH], run * sizeof(u16));
+    advance_vram_transfer_pos(run);
+    dest += run * sizeof(u16);
+    pixel_count -= run;
+  }
+}
+
 void Gpu::gp0_texture_window(u32 cmd) {
   m_tex_window.word = cmd;
 }
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cpu/scheduler.hpp>
 #include <gpu/colors.hpp>
 #include <renderer/rasterizer.hpp>
+#include <util/serializer.hpp>
 #include <util/types.hpp>
 
 #include <gsl-lite.hpp>
@@ -174,7 +176,10 @@ struct DisplayResolution {
 class Gpu {
   friend class gui::Gui;  // for debug info
  public:
-  Gpu();
+  // vram (VRAM_WIDTH * VRAM_HEIGHT pixels, usually a view of the memory::Arena) has to outlive this
+  explicit Gpu(byte* vram);
+  // Schedules the first VBLANK
+  void init(cpu::Scheduler* scheduler);
 
   // GPUSTAT register
   GpuStatus m_gpustat{};
@@ -192,7 +197,7 @@ class Gpu {
   Gp1VDisplayRange m_vdisplay_range;
 
   // VRAM
-  std::unique_ptr<std::array<u16, VRAM_WIDTH * VRAM_HEIGHT>> m_vram;
+  std::array<u16, VRAM_WIDTH * VRAM_HEIGHT>* m_vram;
 
   // VRAM transfers
   u16 m_vram_transfer_x{};
@@ -203,8 +208,8 @@ class Gpu {
 
   u32 m_frames{};
 
-  std::array<u16, VRAM_WIDTH * VRAM_HEIGHT> const& vram() const { return *m_vram.get(); }
-  std::array<u16, VRAM_WIDTH * VRAM_HEIGHT>& vram() { return *m_vram.get(); }
+  std::array<u16, VRAM_WIDTH * VRAM_HEIGHT> const& vram() const { return *m_vram; }
+  std::array<u16, VRAM_WIDTH * VRAM_HEIGHT>& vram() { return *m_vram; }
 
   GpuStatus gpustat() const {
     auto gpustat = static_cast<u32>(m_gpustat.word);
@@ -244,24 +249,40 @@ class Gpu {
   }
   void set_vram_idx(u32 vram_idx, u16 val);
   u32 dma_read_vram();
+  // Same as a dma_read_vram() for each word, copies a row of the transfer's rectangle at a time
+  void dma_read_vram(gsl::span<u32> words);
 
   DisplayResolution get_resolution() const;
 
+  // GP0 command debug records aren't saved
+  void serialize(util::Serializer& s);
+
  private:
   // Returns size of image in 16-bit pixels, rounded up to nearest 32-bit value
   u32 setup_vram_transfer(u32 pos_word, u32 size_word);
   void advance_vram_transfer_pos();
+  // By pixel_count pixels, which don't go past the end of the row
+  void advance_vram_transfer_pos(u32 pixel_count);
+  // Pixels (up to pixel_count) from the transfer position to the end of its row, 0 if they'd wrap
+  // around VRAM
+  u32 vram_transfer_run(u32 pixel_count) const;
   void do_cpu_to_vram_transfer(u32 cmd);
+  void do_cpu_to_vram_transfer(gsl::span<const u32> words);
 
 public:
-  // Returns true to signals that a frame is ready for presenting (VBLANK)
-  bool step(u32 cycles_to_emualate);
+  // Runs the VBLANK event: a frame is ready for presenting. Schedules the next one.
+  void on_vblank();
 
   std::vector<u32> const& gp0_cmd() const { return m_gp0_cmd; }
 
   void gp0(u32 cmd);
+  // Same as a gp0() for each word, for whole packets (e.g. straight from RAM). Commands take all of
+  // their arguments at once, and CPU -> VRAM transfer image data is copied a row at a time.
+  void gp0_batch(gsl::span<const u32> words);
 
  private:
+  // Runs the command in m_gp0_cmd, once it has all of its arguments
+  void gp0_run_command();
   void gp0_mono_polyline_opaque(u32 cmd);
   void gp0_draw_mode(u32 cmd);
   void gp0_mask_bit(u32 cmd);
@@ -294,7 +315,8 @@ public:
   std::vector<u32> m_gp0_cmd;  // All words comprising a GP0 command
 
   // VBLANK
-  s32 m_vblank_cycles_left{ CPU_CYCLES_PER_FRAME };
+  cpu::Scheduler* m_scheduler{};
+  u64 m_vblank_cycle{};  // The next one happens at
 
   // Debugging
   struct Gp0CmdDebugRecord {
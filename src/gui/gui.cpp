@@ -191,6 +191,10 @@ void Gui::set_joypad(io::Joypad* joypad) {
   m_joypad = joypad;
 }
 
+void Gui::set_debugger(cpu::Debugger* debugger) {
+  m_debugger = debugger;
+}
+
 void Gui::set_settings(emulator::Settings* settings) {
   m_settings = settings;
 }
@@ -380,12 +384,16 @@ void Gui::imgui_draw(const emulator::Emulator& emulator) {
   if (m_settings->show_gui) {
     if (ImGui::BeginMainMenuBar()) {
       if (ImGui::BeginMenu("Debug")) {
-        ImGui::MenuItem("TTY Output", "Ctrl+T", &m_draw_tty, LOG_TTY_OUTPUT_WITH_HOOK || LOG_BIOS_CALLS);
-        ImGui::MenuItem("BIOS Function Calls", "Ctrl+B", &m_draw_bios_calls, LOG_BIOS_CALLS);
+        ImGui::MenuItem("TTY Output", "Ctrl+T", &m_draw_tty,
+                        LOG_TTY_OUTPUT_WITH_HOOK || m_settings->log_bios_calls);
+        ImGui::MenuItem("BIOS Function Calls", "Ctrl+B", &m_draw_bios_calls, m_settings->log_bios_calls);
         ImGui::MenuItem("RAM Contents", "Ctrl+R", &m_draw_ram);
         ImGui::MenuItem("GPU Registers", "Ctrl+U", &m_draw_gpu_registers);
         ImGui::MenuItem("CPU Registers", "Ctrl+C", &m_draw_cpu_registers);
         ImGui::MenuItem("Timers", "Ctrl+I", &m_draw_timers);
+        ImGui::MenuItem("CPU Profiler", nullptr, &m_draw_profiler);
+        ImGui::MenuItem("Bus Statistics", nullptr, &m_draw_bus_stats);
+        ImGui::MenuItem("Breakpoints", nullptr, &m_draw_breakpoints);
         ImGui::MenuItem("GP0 Commands", "Ctrl+C", &m_draw_cpu_registers, gpu::GP0_DEBUG_RECORD);
         ImGui::EndMenu();
       }
@@ -424,7 +432,22 @@ void Gui::imgui_draw(const emulator::Emulator& emulator) {
         // Gui visibility
         ImGui::MenuItem("Show GUI", "Ctrl+G", &m_settings->show_gui);
 
-        ImGui::MenuItem("Trace CPU", "Ctrl+P", &m_settings->log_trace_cpu);
+        // CPU engine
+        const char* const items_cpu_engine[] = { "Interpreter", "Recompiler" };
+        ImGui::Text("CPU  ");
+        ImGui::SameLine();
+        ImGui::Combo("##cpu_engine", (s32*)&m_settings->cpu_engine, items_cpu_engine,
+                     ARRAYSIZE(items_cpu_engine));
+        ImGui::MenuItem("Fastmem", nullptr, &m_settings->fastmem,
+                        m_settings->cpu_engine == emulator::CpuEngine::Recompiler);
+
+        ImGui::MenuItem("HLE BIOS functions", nullptr, &m_settings->hle_bios);
+
+        ImGui::MenuItem("Log BIOS calls", nullptr, &m_settings->log_bios_calls);
+        ImGui::MenuItem("Trace CPU", "Ctrl+P", &m_settings->trace_cpu);
+        ImGui::MenuItem("Trace CPU registers", nullptr, &m_settings->trace_cpu_regs);
+        ImGui::MenuItem("Profile CPU", nullptr, &m_settings->profile_cpu);
+        ImGui::MenuItem("Count bus accesses", nullptr, &m_settings->bus_stats);
 
         ImGui::PopItemWidth();
         ImGui::EndMenu();
@@ -432,11 +455,17 @@ void Gui::imgui_draw(const emulator::Emulator& emulator) {
       ImGui::EndMainMenuBar();
     }
 
-    if (m_draw_tty && (LOG_TTY_OUTPUT_WITH_HOOK || LOG_BIOS_CALLS))
-      draw_window_log("TTY Output", m_draw_tty, m_tty_autoscroll, emulator.cpu().m_tty_out_log.c_str());
-    if (m_draw_bios_calls && LOG_BIOS_CALLS)
+    const auto& bios_log = emulator.cpu().m_bios_log;
+    if (m_draw_tty && (LOG_TTY_OUTPUT_WITH_HOOK || m_settings->log_bios_calls))
+      draw_window_log("TTY Output", m_draw_tty, m_tty_autoscroll, bios_log.tty_line_count(),
+                      [&bios_log](u32 line) {
+                        const auto& tty_line = bios_log.tty_line(line);
+                        return std::string(tty_line.text.data(), tty_line.length);
+                      });
+    if (m_draw_bios_calls && m_settings->log_bios_calls)
       draw_window_log("BIOS Function Calls", m_draw_bios_calls, m_bios_calls_autoscroll,
-                      emulator.cpu().m_bios_calls_log.c_str());
+                      bios_log.call_count(),
+                      [&bios_log](u32 line) { return bios_log.format_call(line); });
     if (m_draw_ram)
       draw_window_ram(emulator.ram().data());
     if (m_draw_gpu_registers)
@@ -447,13 +476,20 @@ void Gui::imgui_draw(const emulator::Emulator& emulator) {
       draw_window_gp0_commands(emulator.gpu());
     if (m_draw_timers)
       draw_window_timers(emulator.timers());
+    if (m_draw_profiler)
+      draw_window_profiler(emulator.cpu().profiler());
+    if (m_draw_bus_stats)
+      draw_window_bus_stats(emulator.bus_stats());
+    if (m_draw_breakpoints)
+      draw_window_breakpoints();
   }
 }
 
 void Gui::draw_window_log(const char* title,
                           bool& should_draw,
                           bool& should_autoscroll,
-                          const char* text_contents) const {
+                          u32 line_count,
+                          const std::function<std::string(u32 line)>& format_line) const {
   // Window style
   ImGui::SetNextWindowSize(ImVec2(470, 300), ImGuiCond_FirstUseEver);
 
@@ -470,9 +506,16 @@ void Gui::draw_window_log(const char* title,
   ImGui::Spacing();
   ImGui::Separator();
 
-  // Text contents
+  // Text contents, only the visible lines are formatted
   ImGui::BeginChild(title, ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
-  ImGui::TextUnformatted(text_contents);
+  ImGuiListClipper clipper;
+  clipper.Begin(static_cast<s32>(line_count));
+  while (clipper.Step()) {
+    for (s32 line = clipper.DisplayStart; line < clipper.DisplayEnd; ++line) {
+      const auto text = format_line(static_cast<u32>(line));
+      ImGui::TextUnformatted(text.data(), text.data() + text.size());
+    }
+  }
 
   if (should_autoscroll)
     ImGui::SetScrollHere(1.0f);
@@ -929,6 +972,181 @@ void Gui::draw_window_timers(const io::Timers& timers) {
   ImGui::End();
 }
 
+void Gui::draw_window_profiler(const cpu::Profiler& profiler) {
+  if (!ImGui::Begin("CPU Profiler", &m_draw_profiler)) {
+    ImGui::End();
+    return;
+  }
+
+  const u64 sample_count = profiler.sample_count();
+  ImGui::Text("%llu samples (enable in Settings > Profile CPU)", (unsigned long long)sample_count);
+
+  if (sample_count == 0) {
+    ImGui::End();
+    return;
+  }
+  const auto percent = [sample_count](u64 samples) { return 100.f * samples / sample_count; };
+
+  if (ImGui::CollapsingHeader("Instruction classes", ImGuiTreeNodeFlags_DefaultOpen)) {
+    const auto& class_samples = profiler.opcode_class_samples();
+    for (size_t i = 0; i < class_samples.size(); ++i)
+      ImGui::Text("%-12s %5.1f%%", cpu::opcode_class_to_str(static_cast<cpu::OpcodeClass>(i)),
+                  percent(class_samples[i]));
+  }
+
+  if (ImGui::CollapsingHeader("Functions", ImGuiTreeNodeFlags_DefaultOpen)) {
+    // Only the hottest functions are shown, the rest are in the folded stacks file
+    constexpr size_t MAX_ROWS = 100;
+
+    ImGui::Columns(3, "profiler functions");
+    ImGui::Text("Function");
+    ImGui::NextColumn();
+    ImGui::Text("Self");
+    ImGui::NextColumn();
+    ImGui::Text("Total");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    const auto hotspots = profiler.hotspots();
+    for (size_t i = 0; i < std::min(hotspots.size(), MAX_ROWS); ++i) {
+      const auto& hotspot = hotspots[i];
+      ImGui::Text("%s", cpu::function_name(hotspot.function).c_str());
+      ImGui::NextColumn();
+      ImGui::Text("%5.1f%%", percent(hotspot.self_samples));
+      ImGui::NextColumn();
+      ImGui::Text("%5.1f%%", percent(hotspot.total_samples));
+      ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+  }
+
+  ImGui::End();
+}
+
+void Gui::draw_window_bus_stats(const bus::AccessStats& stats) {
+  if (!ImGui::Begin("Bus Statistics", &m_draw_bus_stats)) {
+    ImGui::End();
+    return;
+  }
+
+  const u64 total = stats.total();
+  ImGui::Text("%llu accesses (enable in Settings > Count bus accesses)", (unsigned long long)total);
+
+  if (total == 0) {
+    ImGui::End();
+    return;
+  }
+
+  constexpr const char* COLUMNS[] = { "Region", "R8", "R16", "R32", "W8", "W16", "W32", "Share" };
+  ImGui::Columns(ARRAYSIZE(COLUMNS), "bus stats");
+  for (const auto column : COLUMNS) {
+    ImGui::Text("%s", column);
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+
+  for (size_t i = 0; i < bus::STATS_REGION_COUNT; ++i) {
+    const auto region = static_cast<bus::StatsRegion>(i);
+
+    u64 region_total = 0;
+    ImGui::Text("%s", bus::stats_region_to_str(region));
+    ImGui::NextColumn();
+    for (u32 width = 0; width < bus::AccessStats::WIDTH_COUNT; ++width) {
+      ImGui::Text("%llu", (unsigned long long)stats.reads(region, width));
+      ImGui::NextColumn();
+      region_total += stats.reads(region, width);
+    }
+    for (u32 width = 0; width < bus::AccessStats::WIDTH_COUNT; ++width) {
+      ImGui::Text("%llu", (unsigned long long)stats.writes(region, width));
+      ImGui::NextColumn();
+      region_total += stats.writes(region, width);
+    }
+    ImGui::Text("%5.1f%%", 100.f * region_total / total);
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+
+  ImGui::End();
+}
+
+void Gui::draw_window_breakpoints() {
+  if (!ImGui::Begin("Breakpoints", &m_draw_breakpoints)) {
+    ImGui::End();
+    return;
+  }
+
+  if (m_debugger->paused()) {
+    ImGui::Text("Paused: %s", m_debugger->pause_reason().c_str());
+    ImGui::SameLine();
+    if (ImGui::Button("Continue"))
+      m_debugger->resume();
+  } else
+    ImGui::Text("Running");
+  ImGui::Separator();
+
+  bool changed = false;
+
+  // Execution breakpoints
+  ImGui::InputScalar("##bp_addr", ImGuiDataType_U32, &m_breakpoint_addr, nullptr, nullptr, "%08X",
+                     ImGuiInputTextFlags_CharsHexadecimal);
+  ImGui::SameLine();
+  if (ImGui::Button("Add breakpoint"))
+    m_debugger->add_breakpoint(m_breakpoint_addr);
+
+  auto& breakpoints = m_debugger->breakpoints();
+  for (size_t i = 0; i < breakpoints.size(); ++i) {
+    ImGui::PushID(static_cast<s32>(i));
+    changed |= ImGui::Checkbox("", &breakpoints[i].enabled);
+    ImGui::SameLine();
+    ImGui::Text("Execute 0x%08X", breakpoints[i].addr);
+    ImGui::SameLine();
+    const bool remove = ImGui::SmallButton("Remove");
+    ImGui::PopID();
+
+    if (remove) {
+      m_debugger->remove_breakpoint(i);
+      break;
+    }
+  }
+  ImGui::Separator();
+
+  // Watchpoints
+  const char* const items_watchpoint_size[] = { "8-bit", "16-bit", "32-bit" };
+  ImGui::InputScalar("##wp_addr", ImGuiDataType_U32, &m_watchpoint_addr, nullptr, nullptr, "%08X",
+                     ImGuiInputTextFlags_CharsHexadecimal);
+  ImGui::Combo("##wp_size", &m_watchpoint_size_idx, items_watchpoint_size, ARRAYSIZE(items_watchpoint_size));
+  ImGui::Checkbox("Read", &m_watchpoint_on_read);
+  ImGui::SameLine();
+  ImGui::Checkbox("Write", &m_watchpoint_on_write);
+  ImGui::SameLine();
+  if (ImGui::Button("Add watchpoint"))
+    m_debugger->add_watchpoint(m_watchpoint_addr, 1 << m_watchpoint_size_idx, m_watchpoint_on_read,
+                               m_watchpoint_on_write);
+
+  auto& watchpoints = m_debugger->watchpoints();
+  for (size_t i = 0; i < watchpoints.size(); ++i) {
+    const auto& wp = watchpoints[i];
+
+    ImGui::PushID(static_cast<s32>(breakpoints.size() + i));
+    changed |= ImGui::Checkbox("", &watchpoints[i].enabled);
+    ImGui::SameLine();
+    ImGui::Text("%s%s 0x%08X (%u bytes)", wp.on_read ? "R" : "", wp.on_write ? "W" : "", wp.addr, wp.size);
+    ImGui::SameLine();
+    const bool remove = ImGui::SmallButton("Remove");
+    ImGui::PopID();
+
+    if (remove) {
+      m_debugger->remove_watchpoint(i);
+      break;
+    }
+  }
+
+  if (changed)
+    m_debugger->on_changed();
+
+  ImGui::End();
+}
+
 template <size_t RamSize>
 void Gui::draw_window_ram(const std::array<byte, RamSize>& ram_data) {
   // Window style
@@ -8,6 +8,7 @@
 #include <imgui_memory_editor/imgui_memory_editor.h>
 
 #include <chrono>
+#include <functional>
 #include <string>
 
 namespace emulator {
@@ -15,9 +16,15 @@ class Emulator;
 struct Settings;
 }  // namespace emulator
 
+namespace bus {
+class AccessStats;
+}
+
 namespace cpu {
 class Cpu;
-}
+class Debugger;
+class Profiler;
+}  // namespace cpu
 
 namespace gpu {
 class Gpu;
@@ -40,6 +47,7 @@ class Gui {
  public:
   void init();
   void set_joypad(io::Joypad* joypad);
+  void set_debugger(cpu::Debugger* debugger);
   void set_settings(emulator::Settings* joypad);
   void set_game_title(const std::string& game_title);
   void apply_settings() const;
@@ -66,16 +74,21 @@ class Gui {
   bool draw_window_exe_select(std::string& psxexe_path) const;    // Returns true if a file was selected
   bool draw_window_cdrom_select(std::string& psxexe_path) const;  // Returns true if a file was selected
 
+  // Draws line_count lines, calling format_line only for the ones that are visible
   void draw_window_log(const char* title,
                        bool& should_draw,
                        bool& should_autoscroll,
-                       const char* text_contents) const;
+                       u32 line_count,
+                       const std::function<std::string(u32 line)>& format_line) const;
   template <size_t RamSize>
   void draw_window_ram(const std::array<byte, RamSize>& data);
   void draw_window_gpu_registers(const gpu::Gpu& gpu);
   void draw_window_cpu_registers(const cpu::Cpu& cpu);
   void draw_window_gp0_commands(const gpu::Gpu& gpu);
   void draw_window_timers(const io::Timers& timers);
+  void draw_window_profiler(const cpu::Profiler& profiler);
+  void draw_window_bus_stats(const bus::AccessStats& stats);
+  void draw_window_breakpoints();
 
  private:
   // SDL
@@ -115,9 +128,24 @@ class Gui {
   // Timers window fields
   bool m_draw_timers{ true };
 
+  // CPU Profiler window fields
+  bool m_draw_profiler{};
+
+  // Bus Statistics window fields
+  bool m_draw_bus_stats{};
+
+  // Breakpoints window fields
+  bool m_draw_breakpoints{};
+  u32 m_breakpoint_addr{};
+  u32 m_watchpoint_addr{};
+  s32 m_watchpoint_size_idx{ 2 };  // 1, 2 or 4 bytes
+  bool m_watchpoint_on_read{ true };
+  bool m_watchpoint_on_write{ true };
+
   std::string m_game_title;
 
   io::Joypad* m_joypad;
+  cpu::Debugger* m_debugger;
   emulator::Settings* m_settings;
 };
 
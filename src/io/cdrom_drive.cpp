@@ -1,11 +1,14 @@
 #include <io/cdrom_drive.hpp>
 
 #include <cpu/interrupt.hpp>
+#include <cpu/scheduler.hpp>
 #include <util/fs.hpp>
 #include <util/log.hpp>
 
 #include <gsl-lite.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <utility>
 
@@ -21,11 +24,12 @@ void CdromDrive::insert_disk_file(const fs::path& file_path) {
   m_stat_code.shell_open = false;
 }
 
-void CdromDrive::init(cpu::Interrupts* interrupts) {
+void CdromDrive::init(cpu::Interrupts* interrupts, cpu::Scheduler* scheduler) {
   m_interrupts = interrupts;
+  m_scheduler = scheduler;
 }
 
-void CdromDrive::step() {
+void CdromDrive::on_irq_event() {
   m_reg_status.transmit_busy = false;
 
   if (!m_irq_fifo.empty()) {
@@ -35,42 +39,55 @@ void CdromDrive::step() {
     if (irq_triggered & irq_mask)
       m_interrupts->trigger(cpu::IrqType::CDROM);
   }
+}
 
+void CdromDrive::on_sector_event() {
   constexpr std::array<u8, 12> SYNC_MAGIC = { { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
                                                 0xff, 0xff, 0x00 } };
 
-  if (m_stat_code.reading || m_stat_code.playing) {
-    if (--m_steps_until_read_sect == 0) {
-      m_steps_until_read_sect = READ_SECTOR_DELAY_STEPS;
+  // Stopped since the sector was scheduled
+  if (!m_stat_code.reading && !m_stat_code.playing)
+    return;
 
-      CdromTrack::DataType sector_type;
-      const auto pos_to_read = CdromPosition::from_lba(m_read_sector);
-      m_read_buf = m_disk.read(pos_to_read, sector_type);
+  m_scheduler->schedule_in(cpu::Event::CdromSector, READ_SECTOR_DELAY_CYCLES);
 
-      m_read_sector++;
+  CdromTrack::DataType sector_type;
+  const auto pos_to_read = CdromPosition::from_lba(m_read_sector);
+  m_read_buf = m_disk.read(pos_to_read, sector_type);
 
-      if (sector_type == CdromTrack::DataType::Invalid)
-        return;
+  m_read_sector++;
 
-      const auto sector_has_data = (sector_type == CdromTrack::DataType::Data);
-      const auto sector_has_audio = (sector_type == CdromTrack::DataType::Audio);
+  if (sector_type == CdromTrack::DataType::Invalid)
+    return;
 
-      auto sync_match = std::equal(SYNC_MAGIC.begin(), SYNC_MAGIC.end(), m_read_buf.begin());
+  const auto sector_has_data = (sector_type == CdromTrack::DataType::Data);
+  const auto sector_has_audio = (sector_type == CdromTrack::DataType::Audio);
 
-      if (m_stat_code.playing && sector_has_audio) {  // Reading audio
-        if (sync_match)
-          LOG_ERROR_CDROM("Sync data found in Audio sector");
-      } else if (m_stat_code.reading && sector_has_data) {  // Reading data
-        if (!sync_match)
-          LOG_ERROR_CDROM("Sync data mismach in Data sector");
+  auto sync_match = std::equal(SYNC_MAGIC.begin(), SYNC_MAGIC.end(), m_read_buf.begin());
 
-        // ack more data
-        push_response(SecondInt1, m_stat_code.byte);
-      }
-    }
+  if (m_stat_code.playing && sector_has_audio) {  // Reading audio
+    if (sync_match)
+      LOG_ERROR_CDROM("Sync data found in Audio sector");
+  } else if (m_stat_code.reading && sector_has_data) {  // Reading data
+    if (!sync_match)
+      LOG_ERROR_CDROM("Sync data mismach in Data sector");
+
+    // ack more data
+    push_response(SecondInt1, m_stat_code.byte);
   }
 }
 
+void CdromDrive::schedule_irq() {
+  // A response already on its way goes first
+  if (!m_irq_fifo.empty() && !m_scheduler->is_scheduled(cpu::Event::CdromIrq))
+    m_scheduler->schedule_in(cpu::Event::CdromIrq, IRQ_DELAY_CYCLES);
+}
+
+void CdromDrive::schedule_sector() {
+  if (!m_scheduler->is_scheduled(cpu::Event::CdromSector))
+    m_scheduler->schedule_in(cpu::Event::CdromSector, READ_SECTOR_DELAY_CYCLES);
+}
+
 u8 CdromDrive::read_reg(address addr_rebased) {
   const u8 reg = addr_rebased;
   const u8 reg_index = m_reg_status.index;
@@ -137,6 +154,7 @@ void CdromDrive::write_reg(address addr_rebased, u8 val) {
     m_reg_status.param_fifo_write_ready = (m_param_fifo.size() < MAX_FIFO_SIZE);
   } else if (reg == 2 && reg_index == 1) {  // Interrupt Enable Register
     m_reg_int_enable = val;
+    schedule_irq();
   } else if (reg == 2 && reg_index == 2) {  // Audio Volume for Left-CD-Out to Left-SPU-Input
   } else if (reg == 2 && reg_index == 3) {  // Audio Volume for Right-CD-Out to Left-SPU-Input
   } else if (reg == 3 && reg_index == 0) {  // Request Register
@@ -157,8 +175,10 @@ void CdromDrive::write_reg(address addr_rebased, u8 val) {
       m_reg_status.param_fifo_empty = true;
       m_reg_status.param_fifo_write_ready = true;
     }
-    if (!m_irq_fifo.empty())
+    if (!m_irq_fifo.empty()) {
       m_irq_fifo.pop_front();
+      schedule_irq();  // The next response's
+    }
   } else if (reg == 3 && reg_index == 2) {  // Audio Volume for Left-CD-Out to Right-SPU-Input
   } else if (reg == 3 && reg_index == 3) {  // Audio Volume Apply Changes
   } else {
@@ -198,6 +218,49 @@ u32 CdromDrive::read_word() {
   return data;
 }
 
+void CdromDrive::read_words(gsl::span<u32> words) {
+  const u32 size = static_cast<u32>(words.size()) * 4;
+  const u32 available = is_data_buf_empty() ? 0 : m_mode.sector_size() - m_data_buffer_index;
+  const u32 copied = std::min(size, available);
+
+  if (copied > 0) {
+    const bool data_only = (m_mode.sector_size() == 0x800);
+    const u32 data_offset = data_only ? 24 : 12;
+
+    std::memcpy(words.data(), &m_data_buf[data_offset + m_data_buffer_index], copied);
+    m_data_buffer_index += copied;
+
+    if (is_data_buf_empty())
+      m_reg_status.data_fifo_not_empty = false;
+  }
+
+  if (copied < size) {
+    LOG_WARN_CDROM("Tried to read with an empty buffer");
+    std::memset(reinterpret_cast<byte*>(words.data()) + copied, 0, size - copied);
+  }
+}
+
+void CdromDrive::serialize(util::Serializer& s) {
+  // Whether there's a disk depends on this session, not the saved one
+  const bool shell_open = m_stat_code.shell_open;
+
+  s.value(m_reg_status);
+  s.value(m_stat_code);
+  s.value(m_mode);
+  s.value(m_seek_sector);
+  s.value(m_read_sector);
+  s.container(m_param_fifo);
+  s.container(m_irq_fifo);
+  s.container(m_resp_fifo);
+  s.value(m_reg_int_enable);
+  s.container(m_read_buf);
+  s.container(m_data_buf);
+  s.value(m_data_buffer_index);
+  s.value(m_muted);
+
+  m_stat_code.shell_open = shell_open;
+}
+
 void CdromDrive::execute_command(u8 cmd) {
   m_irq_fifo.clear();
   m_resp_fifo.clear();
@@ -228,6 +291,7 @@ void CdromDrive::execute_command(u8 cmd) {
       m_read_sector = m_seek_sector;
 
       m_stat_code.set_state(CdromReadState::Playing);
+      schedule_sector();
 
       push_response_stat(FirstInt3);
       break;
@@ -235,6 +299,7 @@ void CdromDrive::execute_command(u8 cmd) {
       m_read_sector = m_seek_sector;
 
       m_stat_code.set_state(CdromReadState::Reading);
+      schedule_sector();
 
       push_response_stat(FirstInt3);
       break;
@@ -348,6 +413,7 @@ void CdromDrive::execute_command(u8 cmd) {
       m_read_sector = m_seek_sector;
 
       m_stat_code.set_state(CdromReadState::Reading);
+      schedule_sector();
 
       push_response_stat(FirstInt3);
       break;
@@ -399,6 +465,7 @@ u8 CdromDrive::get_param() {
 void CdromDrive::push_response(CdromResponseType type, std::initializer_list<u8> bytes) {
   // First we write the type (INT value) in the Interrupt FIFO
   m_irq_fifo.push_back(type);
+  schedule_irq();
 
   // Then we write the response's data (args) to the Response FIFO
   for (auto response_byte : bytes) {
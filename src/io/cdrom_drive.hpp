@@ -2,18 +2,23 @@
 
 #include <io/cdrom_disk.hpp>
 #include <util/fs.hpp>
+#include <util/serializer.hpp>
 #include <util/types.hpp>
 
+#include <gsl-lite.hpp>
+
 #include <deque>
 #include <initializer_list>
 
 namespace cpu {
 class Interrupts;
+class Scheduler;
 }
 
 namespace io {
 
-constexpr auto READ_SECTOR_DELAY_STEPS = 1150;  // IRQ delay in CD-ROM steps (each one is 100 CPU cycles)
+constexpr u32 READ_SECTOR_DELAY_CYCLES = 1150 * 300;  // Between sectors, while reading or playing
+constexpr u32 IRQ_DELAY_CYCLES = 300;  // From a response getting to the front of the queue to its IRQ
 constexpr size_t MAX_FIFO_SIZE = 16;
 
 enum CdromResponseType : u8 {
@@ -101,13 +106,21 @@ union CdromStatusCode {
 
 class CdromDrive {
  public:
-  void init(cpu::Interrupts* interrupts);
+  void init(cpu::Interrupts* interrupts, cpu::Scheduler* scheduler);
   void insert_disk_file(const fs::path& file_path);
-  void step();
+  // Runs the CdromIrq event: delivers the response at the front of the queue
+  void on_irq_event();
+  // Runs the CdromSector event: reads the next sector, and schedules the one after it
+  void on_sector_event();
   u8 read_reg(address addr_rebased);
   void write_reg(address addr_rebased, u8 val);
   u8 read_byte();
   u32 read_word();
+  // Same as a read_word() for each word, copied straight from the sector
+  void read_words(gsl::span<u32> words);
+
+  // The inserted disk isn't saved, restoring keeps the current one
+  void serialize(util::Serializer& s);
 
  private:
   void execute_command(u8 cmd);
@@ -115,6 +128,10 @@ class CdromDrive {
   void push_response(CdromResponseType type, u8 byte);
   void push_response_stat(CdromResponseType type);
   void command_error();
+  // Schedules the IRQ of the response at the front of the queue, if any
+  void schedule_irq();
+  // Schedules the first sector of a read (or play), unless one is on the way
+  void schedule_sector();
   u8 get_param();
   bool is_data_buf_empty();
 
@@ -136,7 +153,6 @@ class CdromDrive {
   std::deque<u8> m_resp_fifo{};
 
   u8 m_reg_int_enable{};
-  u32 m_steps_until_read_sect{ READ_SECTOR_DELAY_STEPS };
 
   buffer m_read_buf{};
   buffer m_data_buf{};
@@ -145,6 +161,7 @@ class CdromDrive {
   bool m_muted{ false };
 
   cpu::Interrupts* m_interrupts{};
+  cpu::Scheduler* m_scheduler{};
 };
 
 }  // namespace io
@@ -1,12 +1,14 @@
 #include <io/joypad.hpp>
 
 #include <cpu/interrupt.hpp>
+#include <cpu/scheduler.hpp>
 #include <util/log.hpp>
 
 namespace io {
 
-void Joypad::init(cpu::Interrupts* interrupts) {
+void Joypad::init(cpu::Interrupts* interrupts, cpu::Scheduler* scheduler) {
   m_interrupts = interrupts;
+  m_scheduler = scheduler;
 }
 
 u8 Joypad::read8(address addr_rebased) {
@@ -76,17 +78,10 @@ void Joypad::write8(address addr_rebased, u8 val) {
     *((u8*)&m_reg_baud + reg_byte) = val;
 }
 
-void Joypad::step() {
-  if (m_irq_timer > 0) {
-    m_irq_timer--;
-    if (m_irq_timer == 0) {
-      m_irq = true;  // trigger IRQ
-      m_ack = false;
-    }
-  }
-
-  if (m_irq)
-    m_interrupts->trigger(cpu::IrqType::CONTROLLER);
+void Joypad::on_ack_event() {
+  m_irq = true;  // trigger IRQ
+  m_ack = false;
+  m_interrupts->trigger(cpu::IrqType::CONTROLLER);
 }
 
 void Joypad::update_button(u8 button_index, bool was_pressed) {
@@ -94,6 +89,19 @@ void Joypad::update_button(u8 button_index, bool was_pressed) {
   m_digital_controllers[0].update_button(button_index, was_pressed);
 }
 
+void Joypad::serialize(util::Serializer& s) {
+  s.value(m_reg_mode);
+  s.value(m_reg_ctrl);
+  s.value(m_reg_baud);
+  s.value(m_rx_has_data);
+  s.value(m_rx_data);
+  s.value(m_irq);
+  s.value(m_ack);
+  s.value(m_device_selected);
+  for (auto& controller : m_digital_controllers)
+    s.value(controller.m_read_idx);
+}
+
 const char* Joypad::addr_to_reg_name(address addr_rebased) {
   address reg_byte;
 
@@ -130,7 +138,7 @@ void Joypad::do_tx_transfer(u8 val) {
     m_rx_data = m_digital_controllers[port].read(val);
     m_ack = m_digital_controllers[port].ack();
     if (m_ack)
-      m_irq_timer = 5;
+      m_scheduler->schedule_in(cpu::Event::JoypadAck, ACK_IRQ_DELAY_CYCLES);
     if (m_digital_controllers[port].m_read_idx == 0)
       m_device_selected = Device::None;
   }
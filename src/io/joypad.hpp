@@ -1,12 +1,14 @@
 #pragma once
 
 #include <io/digital_controller.hpp>
+#include <util/serializer.hpp>
 #include <util/types.hpp>
 
 #include <memory/range.hpp>
 
 namespace cpu {
 class Interrupts;
+class Scheduler;
 }
 
 namespace io {
@@ -18,6 +20,9 @@ static constexpr memory::Range JOY_MODE{ 0x8, 2 };
 static constexpr memory::Range JOY_CTRL{ 0xA, 2 };
 static constexpr memory::Range JOY_BAUD{ 0xE, 2 };
 
+// From a byte being transferred to the device's /ACK, and its IRQ
+static constexpr u32 ACK_IRQ_DELAY_CYCLES = 1500;
+
 static constexpr u8 BTN_INVALID = 0xFF;
 static constexpr u8 BTN_SELECT = 0;
 static constexpr u8 BTN_L3 = 1;
@@ -38,13 +43,17 @@ static constexpr u8 BTN_SQUARE = 15;
 
 class Joypad {
  public:
-  void init(cpu::Interrupts* interrupts);
+  void init(cpu::Interrupts* interrupts, cpu::Scheduler* scheduler);
   u8 read8(address addr_rebased);
   void write8(address addr_rebased, u8 val);
 
-  void step();
+  // Runs the JoypadAck event, the IRQ of the last byte's /ACK
+  void on_ack_event();
   void update_button(u8 button_index, bool was_pressed);
 
+  // Button state is host input, it isn't saved
+  void serialize(util::Serializer& s);
+
   static const char* addr_to_reg_name(address addr_rebased);
 
  private:
@@ -65,7 +74,6 @@ class Joypad {
   u8 m_rx_data{};
 
   bool m_irq{};
-  u8 m_irq_timer{};
   bool m_ack{};
 
   Device m_device_selected{ Device::None };
@@ -73,6 +81,7 @@ class Joypad {
   DigitalController m_digital_controllers[2];
 
   cpu::Interrupts* m_interrupts;
+  cpu::Scheduler* m_scheduler;
 };
 
 }  // namespace io
@@ -1,59 +1,151 @@
 #include <cpu/interrupt.hpp>
+#include <cpu/scheduler.hpp>
 #include <gsl-lite.hpp>
 #include <io/timers.hpp>
 #include <util/log.hpp>
 
+#include <algorithm>
+
 namespace io {
 
 static cpu::IrqType timer_index_to_irq(TimerIndex i);
 
-void Timers::init(cpu::Interrupts* interrupts) {
+void Timers::init(cpu::Interrupts* interrupts, cpu::Scheduler* scheduler) {
   m_interrupts = interrupts;
+  m_scheduler = scheduler;
+  m_sync_cycle = m_scheduler->now();
 }
 
-void Timers::step(u32 cycles) {
-  const u16 timer_increment[3] = { source0() ? cycles : cycles,  // TODO
-                                   source1() ? cycles : cycles,  // TODO
-                                   source2() ? cycles / 8 : cycles };
+void Timers::sync() {
+  const auto now = m_scheduler->now();
 
+  // Dotclock and HBLANK sources aren't emulated, they count at the system clock  TODO
   for (auto i = Timer0; i < TimerMax; i = (TimerIndex)((u16)i + 1)) {
     if (m_timer_paused[i])
       continue;
 
-    // Shorthands
-    auto& value = m_timer_value[i];
-    auto& mode = m_timer_mode[i];
-    auto& target = m_timer_target[i];
+    const auto ticks = is_divided(i) ? (now / 8) - (m_sync_cycle / 8) : now - m_sync_cycle;
+    advance(i, ticks);
+  }
+  m_sync_cycle = now;
+}
 
-    value += timer_increment[i];
+void Timers::on_event() {
+  sync();
+  schedule_next();
+}
 
-    bool could_irq = false;
+void Timers::advance(TimerIndex i, u64 ticks) {
+  // Shorthands
+  auto& value = m_timer_value[i];
+  const auto& mode = m_timer_mode[i];
+  const u32 target = m_timer_target[i];
 
-    if (value > target) {
-      mode.reached_target = true;
-      if (mode.irq_on_target)
-        could_irq = true;
-      if (mode.reset_on_target)
-        value = 0;  // if reset on target
-    }
+  if (ticks == 0)
+    return;
 
-    if (value > 0xFFFF) {
-      mode.reached_max = true;
-      if (mode.irq_on_max)
-        could_irq = true;
-      if (!mode.reset_on_target)
-        value = 0;  // if reset on max
+  // Computed rather than stepped through, as syncs can be many periods apart. Whether the counter went
+  // through its target or 0xFFFF is all that matters, not how many times.
+  bool reached_target = false;
+  bool reached_max = false;
+
+  // Reset on target, but already past it: runs up to 0xFFFF and wraps around to 0 first
+  if (mode.reset_on_target && value > target) {
+    const u32 ticks_to_zero = 0x10000 - value;
+    if (ticks < ticks_to_zero) {
+      value += static_cast<u32>(ticks);
+      if (value == 0xFFFF)
+        on_match(i, false, true);
+      return;
     }
 
-    if (could_irq)
-      step_irq(i);
+    reached_max = value != 0xFFFF;
+    reached_target = target == 0;
+    value = 0;
+    ticks -= ticks_to_zero;
+  }
 
-    // Handle possible overflow (we use u32 but counter value is u16)
-    value = static_cast<u16>(value);
+  // The counter goes back to 0 after the target if reset on target, or after 0xFFFF
+  const u32 period = mode.reset_on_target ? target + 1 : 0x10000;
+  const auto ticks_until = [&](u32 to) -> u32 {
+    const u32 distance = (to + period - value) % period;
+    return distance ? distance : period;
+  };
+
+  if (ticks >= ticks_until(target))
+    reached_target = true;
+  if (period == 0x10000 && ticks >= ticks_until(0xFFFF))
+    reached_max = true;
+  value = static_cast<u32>((value + ticks) % period);
+
+  if (reached_target || reached_max)
+    on_match(i, reached_target, reached_max);
+}
+
+void Timers::on_match(TimerIndex i, bool reached_target, bool reached_max) {
+  auto& mode = m_timer_mode[i];
+
+  bool could_irq = false;
+
+  if (reached_target) {
+    mode.reached_target = true;
+    if (mode.irq_on_target)
+      could_irq = true;
   }
+
+  if (reached_max) {
+    mode.reached_max = true;
+    if (mode.irq_on_max)
+      could_irq = true;
+  }
+
+  if (could_irq)
+    step_irq(i);
+}
+
+u32 Timers::ticks_until_match(TimerIndex i) const {
+  const auto& mode = m_timer_mode[i];
+  const u32 value = m_timer_value[i];
+  const u32 target = m_timer_target[i];
+  const u32 wrap = (mode.reset_on_target && value <= target) ? target : 0xFFFF;
+
+  // Stuck at a target of 0. IRQs on every tick couldn't be serviced anyway, check once per period.
+  if (wrap == 0)
+    return 0x10000;
+
+  if (value < target)
+    return target - value;
+  if (value < wrap)
+    return wrap - value;
+  return target + 1;  // Wraps around to 0 first
+}
+
+void Timers::schedule_next() {
+  auto next = cpu::Scheduler::NEVER;
+
+  for (auto i = Timer0; i < TimerMax; i = (TimerIndex)((u16)i + 1)) {
+    const auto& mode = m_timer_mode[i];
+
+    // Only IRQs need the counter to be up to date in time, flags are updated when read
+    const bool one_shot_done =
+        mode.irq_repeat_mode() == TimerMode::RepeatMode::Once && m_timer_irq_occured[i];
+    if (m_timer_paused[i] || one_shot_done || !(mode.irq_on_target || mode.irq_on_max))
+      continue;
+
+    const u64 ticks = ticks_until_match(i);
+    const auto cycle = is_divided(i) ? ((m_sync_cycle / 8) + ticks) * 8 : m_sync_cycle + ticks;
+    next = std::min(next, cycle);
+  }
+
+  if (next == cpu::Scheduler::NEVER)
+    m_scheduler->cancel(cpu::Event::Timers);
+  else
+    m_scheduler->schedule(cpu::Event::Timers, next);
 }
 
 u16 Timers::read_reg(address addr) {
+  sync();
+
   u8 timer_select = timer_from_addr(addr);
   u8 reg = addr & 0xF;
 
@@ -69,6 +161,8 @@ u16 Timers::read_reg(address addr) {
 }
 
 void Timers::write_reg(address addr, u16 val) {
+  sync();
+
   u8 timer_select = timer_from_addr(addr);
   u8 reg = addr & 0xF;
 
@@ -102,6 +196,8 @@ void Timers::write_reg(address addr, u16 val) {
       break;
     default: LOG_ERROR("Invalid Timer register access"); break;
   }
+
+  schedule_next();
 }
 
 void Timers::step_irq(TimerIndex i) {
@@ -122,6 +218,15 @@ void Timers::step_irq(TimerIndex i) {
   mode.irq_not = true;
 }
 
+void Timers::serialize(util::Serializer& s) {
+  s.value(m_sync_cycle);
+  s.value(m_timer_value);
+  s.value(m_timer_mode);
+  s.value(m_timer_target);
+  s.value(m_timer_irq_occured);
+  s.value(m_timer_paused);
+}
+
 u8 Timers::timer_from_addr(address addr) {
   const auto timer_select = (addr & 0xF0) >> 4;
   Expects(timer_select <= 2);
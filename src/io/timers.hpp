@@ -1,9 +1,11 @@
 #pragma once
 
+#include <util/serializer.hpp>
 #include <util/types.hpp>
 
 namespace cpu {
 class Interrupts;
+class Scheduler;
 }
 
 namespace gui {
@@ -58,19 +60,35 @@ enum TimerIndex : u16 {
   TimerMax,
 };
 
+// Counters are brought up to date when they're accessed, and the Timers event is scheduled for the next
+// time one reaches its target or 0xFFFF, for the IRQs.
 class Timers {
   friend class gui::Gui;  // for debug info
 
  public:
-  void init(cpu::Interrupts* interrupts);
-  void step(u32 cpu_cycles);
+  void init(cpu::Interrupts* interrupts, cpu::Scheduler* scheduler);
+  // Advances the counters to the current cycle, setting flags and triggering IRQs on the way
+  void sync();
+  // Runs the Timers event, and schedules the next one
+  void on_event();
 
   u16 read_reg(address addr);
   void write_reg(address addr, u16 val);
 
+  void serialize(util::Serializer& s);
+
  private:
+  void advance(TimerIndex i, u64 ticks);
+  // Called when the counter reaches its target and/or 0xFFFF. IRQs at most once, however many periods
+  // were advanced through.
+  void on_match(TimerIndex i, bool reached_target, bool reached_max);
+  // Until the counter next reaches its target or 0xFFFF
+  u32 ticks_until_match(TimerIndex i) const;
+  void schedule_next();
   void step_irq(TimerIndex i);  // Returns whether an IRQ should occur
   static u8 timer_from_addr(address addr);
+  // Counts every 8 cycles, instead of every cycle
+  bool is_divided(TimerIndex i) const { return i == Timer2 && source2(); }
 
   bool source0() const;
   bool source1() const;
@@ -78,8 +96,10 @@ class Timers {
 
  private:
   cpu::Interrupts* m_interrupts{};
+  cpu::Scheduler* m_scheduler{};
+  u64 m_sync_cycle{};  // Counters are up to date as of this cycle
 
-  u32 m_timer_value[3]{};  // Use u32 instead of u16 to handle u16 overflow
+  u32 m_timer_value[3]{};
   TimerMode m_timer_mode[3]{};
   u16 m_timer_target[3]{};
 
@@ -52,6 +52,7 @@ s32 main(s32 argc, char** argv) {
 
     // Link GUI with Emulator
     gui.set_joypad(&emulator->joypad());
+    gui.set_debugger(&emulator->debugger());
     gui.set_settings(&emulator->settings());
 
     // Main loop
@@ -1,33 +1,37 @@
 #pragma once
 
+#include <util/serializer.hpp>
 #include <util/types.hpp>
 
-#include <algorithm>
 #include <array>
-#include <memory>
 
 namespace memory {
 
 template <size_t MemorySize>
 class Addressable {
  public:
-  Addressable() {
-    m_data = std::make_unique<std::array<byte, MemorySize>>();
-    std::fill(m_data->begin(), m_data->end(), 0xDE);
-  }
+  // storage (MemorySize bytes, usually a view of the Arena) has to outlive this
+  explicit Addressable(byte* storage)
+      : m_data(reinterpret_cast<std::array<byte, MemorySize>*>(storage)) {}
 
   template <typename ValueType>
   ValueType read(address addr) const {
-    return *(ValueType*)(m_data.get()->data() + addr);
+    return *(ValueType*)(m_data->data() + addr);
   }
 
   template <typename ValueType>
   void write(address addr, ValueType val) {
-    *(ValueType*)(m_data.get()->data() + addr) = val;
+    *(ValueType*)(m_data->data() + addr) = val;
   }
 
+  void serialize(util::Serializer& s) { s.value(*m_data); }
+
+  // Backing memory, for direct accesses through a PageTable
+  byte* data_ptr() { return m_data->data(); }
+  const byte* data_ptr() const { return m_data->data(); }
+
  protected:
-  std::unique_ptr<std::array<byte, MemorySize>> m_data;
+  std::array<byte, MemorySize>* m_data;
 };
 
 }  // namespace memory
@@ -0,0 +1,106 @@
+#include <memory/arena.hpp>
+
+#include <util/log.hpp>
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+
+namespace memory {
+
+Arena::Arena(bool huge_pages) {
+#if defined(__linux__)
+  m_fd = memfd_create("pctation-memory", MFD_CLOEXEC);
+  if (m_fd >= 0 && ftruncate(m_fd, SIZE) == 0) {
+    void* data = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data != MAP_FAILED)
+      m_data = static_cast<byte*>(data);
+  }
+
+  if (!m_data) {
+    LOG_WARN("Arena: couldn't create shared memory, using private memory");
+    if (m_fd >= 0)
+      close(m_fd);
+    m_fd = -1;
+
+    void* data = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data != MAP_FAILED)
+      m_data = static_cast<byte*>(data);
+  }
+
+  // Just a hint, whether it's honored depends on the system's THP settings
+  if (m_data && huge_pages)
+    madvise(m_data, SIZE, MADV_HUGEPAGE);
+#else
+  (void)huge_pages;
+#endif
+
+  if (!m_data) {
+    m_fallback = std::make_unique<byte[]>(SIZE + ALIGNMENT);
+    const uintptr_t mask = ALIGNMENT - 1;
+    m_data = reinterpret_cast<byte*>((reinterpret_cast<uintptr_t>(m_fallback.get()) + mask) & ~mask);
+    std::memset(m_data, 0, SIZE);
+  }
+}
+
+bool Arena::unshare(bool keep_memfd) {
+#if defined(__linux__)
+  if (m_fd < 0)
+    return true;  // Private memory is already copy-on-write after fork()
+
+  if (!keep_memfd) {
+    if (mmap(m_data, SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, m_fd, 0) == MAP_FAILED)
+      return false;
+    close(m_fd);
+    m_fd = -1;
+    return true;
+  }
+
+  const s32 fd = memfd_create("pctation-memory", MFD_CLOEXEC);
+  if (fd < 0 || ftruncate(fd, SIZE) != 0) {
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+
+  // Fill the new memfd from the current mapping, then swap it in underneath
+  for (u32 written = 0; written < SIZE;) {
+    const auto count = pwrite(fd, m_data + written, SIZE - written, written);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count <= 0) {
+      close(fd);
+      return false;
+    }
+    written += static_cast<u32>(count);
+  }
+  if (mmap(m_data, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  close(m_fd);
+  m_fd = fd;
+  return true;
+#else
+  (void)keep_memfd;
+  return true;
+#endif
+}
+
+Arena::~Arena() {
+#if defined(__linux__)
+  if (!m_fallback)
+    munmap(m_data, SIZE);
+  if (m_fd >= 0)
+    close(m_fd);
+#endif
+}
+
+}  // namespace memory
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory/map.hpp>
+#include <util/types.hpp>
+
+#include <memory>
+
+namespace memory {
+
+// Size of the GPU's VRAM, 1024x512 16-bit pixels
+constexpr u32 VRAM_SIZE = 1024 * 512 * 2;
+
+// All of the emulated memory (RAM, scratchpad, BIOS, expansion, SPU and VRAM) in a single page-aligned
+// allocation, which devices get views of. It starts zeroed.
+// On Linux it's backed by a memfd, so that Fastmem can map views of it, and can use transparent huge
+// pages.
+class Arena {
+ public:
+  // Layout, each part is page-aligned
+  static constexpr u32 ALIGNMENT = 4 * 1024;
+  static constexpr u32 RAM_OFFSET = 0;
+  static constexpr u32 SCRATCHPAD_OFFSET = RAM_OFFSET + RAM_SIZE;  // Takes a whole page
+  static constexpr u32 BIOS_OFFSET = SCRATCHPAD_OFFSET + ALIGNMENT;
+  static constexpr u32 EXPANSION_OFFSET = BIOS_OFFSET + BIOS_SIZE;
+  static constexpr u32 SPU_OFFSET = EXPANSION_OFFSET + EXPANSION_1_SIZE;  // Takes a whole page
+  static constexpr u32 VRAM_OFFSET = SPU_OFFSET + ALIGNMENT;
+  static constexpr u32 SIZE = VRAM_OFFSET + VRAM_SIZE;
+  static_assert(SCRATCHPAD_SIZE <= ALIGNMENT && SPU_SIZE <= ALIGNMENT, "They only take a page");
+
+  explicit Arena(bool huge_pages);
+  ~Arena();
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  byte* ram() { return m_data + RAM_OFFSET; }
+  byte* scratchpad() { return m_data + SCRATCHPAD_OFFSET; }
+  byte* bios() { return m_data + BIOS_OFFSET; }
+  byte* expansion() { return m_data + EXPANSION_OFFSET; }
+  byte* spu() { return m_data + SPU_OFFSET; }
+  byte* vram() { return m_data + VRAM_OFFSET; }
+
+  // The whole arena, snapshots of all emulated memory can copy it at once
+  byte* data() { return m_data; }
+  const byte* data() const { return m_data; }
+
+  // File descriptor of the memfd backing the arena, -1 if there isn't one
+  s32 fd() const { return m_fd; }
+
+  // A fork()ed child shares the memfd with its parent (and siblings), this gives it memory of its own,
+  // at the same address and with the same contents. With keep_memfd it's copied to a new memfd (which
+  // Fastmem can map), otherwise it becomes a copy-on-write mapping of the old one, so only the pages
+  // written from now on cost memory. The old memfd mustn't be written to anymore in that case.
+  // Views of the old memfd have to be unmapped first. Returns false on failure, the arena is unchanged.
+  bool unshare(bool keep_memfd);
+
+ private:
+  byte* m_data{};
+  s32 m_fd{ -1 };
+  std::unique_ptr<byte[]> m_fallback;  // Without mmap, m_data is aligned within it
+};
+
+}  // namespace memory
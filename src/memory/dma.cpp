@@ -1,6 +1,7 @@
 #include <memory/dma.hpp>
 
 #include <cpu/interrupt.hpp>
+#include <cpu/scheduler.hpp>
 #include <gpu/gpu.hpp>
 #include <io/cdrom_drive.hpp>
 #include <memory/dma_channel.hpp>
@@ -9,10 +10,25 @@
 
 #include <gsl-lite.hpp>
 
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#endif
+
 namespace memory {
 
 constexpr u32 RAM_ADDR_MASK = 0x1FFFFC;
 
+// Hints the host to start loading the cache line at ptr
+static void prefetch(const void* ptr) {
+#ifdef _MSC_VER
+  _mm_prefetch(static_cast<const char*>(ptr), _MM_HINT_T0);
+#else
+  __builtin_prefetch(ptr);
+#endif
+}
+
 DmaChannel const& Dma::channel_control(DmaPort port) const {
   const auto port_index = (u32)port;
   Expects(port_index < 7);
@@ -25,11 +41,18 @@ DmaChannel& Dma::channel_control(DmaPort port) {
   return m_channels[port_index];
 }
 
-void Dma::step() {
-  if (m_irq_pending) {
-    m_irq_pending = false;
-    m_interrupts.trigger(cpu::IrqType::DMA);
-  }
+void Dma::on_irq_event() {
+  m_interrupts.trigger(cpu::IrqType::DMA);
+}
+
+void Dma::serialize(util::Serializer& s) {
+  s.value(m_reg_control);
+  s.value(m_reg_interrupt);
+  s.value(m_channels);
+}
+
+u32* Dma::ram_words(address addr) {
+  return reinterpret_cast<u32*>(m_ram.data_ptr() + addr);
 }
 
 void Dma::do_transfer(DmaPort port) {
@@ -56,7 +79,10 @@ void Dma::do_block_transfer(DmaPort port) {
   LOG_DEBUG("Starting DMA block transfer: {} {} RAM, sync mode: {}", dma_port_to_str(port),
             channel.to_ram() ? "to" : "from", channel.sync_mode_str());
 
-  // TODO: optimize for the few combinations that are actually used
+  if (do_bulk_block_transfer(port, channel.to_ram(), addr_step > 0, addr, transfer_word_count)) {
+    transfer_finished(channel, port);
+    return;
+  }
 
   while (transfer_word_count > 0) {
     const auto addr_cur = addr & RAM_ADDR_MASK;
@@ -119,6 +145,50 @@ void Dma::do_block_transfer(DmaPort port) {
   transfer_finished(channel, port);
 }
 
+bool Dma::do_bulk_block_transfer(DmaPort port, bool to_ram, bool forward, address addr, u32 word_count) {
+  addr &= RAM_ADDR_MASK;
+
+  if (port == DmaPort::Otc) {
+    // Written backwards from addr, as long as the table doesn't wrap around RAM
+    if (!to_ram || forward || word_count == 0 || addr < (word_count - 1) * 4)
+      return false;
+
+    // Each entry points to the previous one, the first one is the end of the table
+    const address start = addr - (word_count - 1) * 4;
+    u32* entries = ram_words(start);
+    entries[0] = 0xFFFFFF;
+    for (u32 i = 1; i < word_count; ++i)
+      entries[i] = start + (i - 1) * 4;
+
+    m_ram.on_bulk_write(start, word_count * 4);
+    return true;
+  }
+
+  const bool supported = (port == DmaPort::Cdrom && to_ram) || port == DmaPort::Gpu;
+  if (!forward || !supported)
+    return false;
+
+  // Runs up to the end of RAM, the transfer wraps around it
+  while (word_count > 0) {
+    const u32 run = std::min(word_count, (RAM_SIZE - addr) / 4);
+    const gsl::span<u32> words(ram_words(addr), run);
+
+    if (port == DmaPort::Cdrom)
+      m_cdrom.read_words(words);
+    else if (to_ram)
+      m_gpu.dma_read_vram(words);
+    else
+      m_gpu.gp0_batch(words);
+
+    if (to_ram)
+      m_ram.on_bulk_write(addr, run * 4);
+
+    addr = (addr + run * 4) & RAM_ADDR_MASK;
+    word_count -= run;
+  }
+  return true;
+}
+
 void Dma::do_linked_list_transfer(DmaPort port) {
   auto& channel = channel_control(port);
 
@@ -133,24 +203,32 @@ void Dma::do_linked_list_transfer(DmaPort port) {
     const u32 packet_header = m_ram.read<u32>(addr);
     auto packet_word_count = packet_header >> 24;
 
+    // Only check the top bit instead of the whole marker, that's what the hardware does
+    const bool is_last = (packet_header & 0x800000) != 0;
+    const address next_addr = packet_header & RAM_ADDR_MASK;
+
+    // Get the next node on its way to the cache while this packet is processed
+    if (!is_last)
+      prefetch(ram_words(next_addr));
+
     if (packet_word_count > 0)
       LOG_DEBUG("GPU packet at {:08X} (words: {})", addr, packet_word_count);
 
+    // Send the packet (GP0 commands) to the GPU straight from RAM, in runs up to its end as packets wrap
+    // around it
+    address data_addr = (addr + 4) & RAM_ADDR_MASK;
     while (packet_word_count > 0) {
-      addr = (addr + 4) & RAM_ADDR_MASK;
-      const u32 packet_data = m_ram.read<u32>(addr);
+      const u32 run = std::min(packet_word_count, (RAM_SIZE - data_addr) / 4);
+      m_gpu.gp0_batch(gsl::span<const u32>(ram_words(data_addr), run));
 
-      // Send packet (which is a GP0 command) to the GPU
-      m_gpu.gp0(packet_data);
-
-      packet_word_count -= 1;
+      data_addr = (data_addr + run * 4) & RAM_ADDR_MASK;
+      packet_word_count -= run;
     }
 
-    // Only check the top bit instead of the whole marker, that's what the hardware does
-    if ((packet_header & 0x800000) != 0)
+    if (is_last)
       break;
 
-    addr = packet_header & RAM_ADDR_MASK;
+    addr = next_addr;
   }
   transfer_finished(channel, port);
 }
@@ -162,7 +240,10 @@ void Dma::transfer_finished(DmaChannel& channel, DmaPort port) {
 
   if (is_enabled) {
     m_reg_interrupt.set_port_flags(port, true);
-    m_irq_pending = m_reg_interrupt.get_irq_master_flag();
+
+    // Raised once the Cpu is done with the access that started the transfer
+    if (m_reg_interrupt.get_irq_master_flag())
+      m_scheduler.schedule(cpu::Event::DmaIrq, m_scheduler.now());
   }
 }
 
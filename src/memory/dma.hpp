@@ -2,6 +2,7 @@
 
 #include <memory/dma_channel.hpp>
 #include <util/log.hpp>
+#include <util/serializer.hpp>
 #include <util/types.hpp>
 
 #include <array>
@@ -17,6 +18,7 @@ class Gpu;
 
 namespace cpu {
 class Interrupts;
+class Scheduler;
 }
 
 namespace io {
@@ -90,10 +92,15 @@ union DmaInterruptRegister {
 
 class Dma {
  public:
-  explicit Dma(memory::Ram& ram, gpu::Gpu& gpu, cpu::Interrupts& interrupts, io::CdromDrive& cdrom)
+  explicit Dma(memory::Ram& ram,
+               gpu::Gpu& gpu,
+               cpu::Interrupts& interrupts,
+               cpu::Scheduler& scheduler,
+               io::CdromDrive& cdrom)
       : m_ram(ram),
         m_gpu(gpu),
         m_interrupts(interrupts),
+        m_scheduler(scheduler),
         m_cdrom(cdrom) {}
 
   template <typename ValueType>
@@ -190,24 +197,31 @@ class Dma {
 
   DmaChannel const& channel_control(DmaPort port) const;
   DmaChannel& channel_control(DmaPort port);
-  void step();
+  // Runs the DmaIrq event, scheduled when a transfer finishes
+  void on_irq_event();
+  void serialize(util::Serializer& s);
 
  private:
+  // RAM at (masked, word-aligned) addr, for transferring straight to or from it
+  u32* ram_words(address addr);
   void do_transfer(DmaPort port);
   void do_block_transfer(DmaPort port);
+  // The combinations games actually use, a run of RAM at a time. Returns false for the rest, which have
+  // to be transferred word by word.
+  bool do_bulk_block_transfer(DmaPort port, bool to_ram, bool forward, address addr, u32 word_count);
   void transfer_finished(DmaChannel& channel, DmaPort port);
   void do_linked_list_transfer(DmaPort port);
 
  private:
   u32 m_reg_control{ 0x07654321 };
   DmaInterruptRegister m_reg_interrupt;
-  bool m_irq_pending{};
 
   std::array<DmaChannel, 7> m_channels{};
 
   memory::Ram& m_ram;
   gpu::Gpu& m_gpu;
   cpu::Interrupts& m_interrupts;
+  cpu::Scheduler& m_scheduler;
   io::CdromDrive& m_cdrom;
 };
 
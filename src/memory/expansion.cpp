@@ -10,11 +10,7 @@
 
 namespace memory {
 
-Expansion::Expansion(fs::path const& bootstrap_path) {
-  // Init Expansion memory with 0xFF
-  m_data = std::make_unique<std::array<byte, memory::EXPANSION_1_SIZE>>();
-  std::fill(m_data->begin(), m_data->end(), 0);
-
+Expansion::Expansion(fs::path const& bootstrap_path, byte* storage) : Addressable(storage) {
   // Load bootstrap
   if (!bootstrap_path.empty()) {
     auto buf = util::load_file(bootstrap_path);
@@ -23,7 +19,7 @@ Expansion::Expansion(fs::path const& bootstrap_path) {
   }
 
   // Set cheat (Action Replay) switch to ON
-  (*m_data.get())[0x20018] = 1;
+  (*m_data)[0x20018] = 1;
 }
 
 }  // namespace memory
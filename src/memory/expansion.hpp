@@ -12,7 +12,7 @@ namespace memory {
 
 class Expansion : public memory::Addressable<memory::EXPANSION_1_SIZE> {
  public:
-  explicit Expansion(fs::path const& path);
+  explicit Expansion(fs::path const& path, byte* storage);
 };
 
 }  // namespace memory
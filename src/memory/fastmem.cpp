@@ -0,0 +1,328 @@
+#include <memory/fastmem.hpp>
+
+#include <memory/arena.hpp>
+#include <memory/map.hpp>
+#include <memory/page_table.hpp>
+#include <util/log.hpp>
+
+#if FASTMEM_SUPPORTED
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#endif
+
+namespace memory {
+
+#if FASTMEM_SUPPORTED
+
+namespace {
+
+static_assert(Arena::ALIGNMENT == PageTable::PAGE_SIZE, "Views of the arena must be page-aligned");
+
+// Segments memory is visible through: KUSEG, KSEG0 and KSEG1
+constexpr address SEGMENT_BASES[] = { 0x00000000, 0x80000000, 0xA0000000 };
+
+// Instances the SIGSEGV handler looks faults up in (one per Emulator)
+constexpr u32 MAX_INSTANCES = 8;
+std::array<std::atomic<Fastmem*>, MAX_INSTANCES> g_instances{};
+
+std::mutex g_install_mutex;
+bool g_handler_installed{};
+struct sigaction g_previous_action {};
+
+// Host register numbers (as encoded in instructions) to their index in the signal context
+constexpr s32 CONTEXT_REGISTERS[16] = {
+  REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+  REG_R8,  REG_R9,  REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15,
+};
+
+// A guest memory access, as done by a host instruction
+struct HostAccess {
+  u8 length;       // Of the instruction, in bytes
+  u8 reg;          // Register loaded or stored
+  u8 size;         // Of the memory operand, in bytes
+  u8 reg_size;     // Of the register operand, in bytes
+  bool is_store;
+  bool sign_extend;
+  bool high_byte;  // reg is AH, CH, DH or BH (reg - 4)
+};
+
+// Decodes the plain mov, movzx and movsx forms native code accesses memory with
+bool decode_host_access(const u8* code, HostAccess& out) {
+  const u8* p = code;
+
+  const bool operand16 = (*p == 0x66);
+  if (operand16)
+    ++p;
+  const u8 rex = ((*p & 0xF0) == 0x40) ? *p++ : 0;
+  if (rex & 0x08)  // REX.W, guest registers are never 64-bit
+    return false;
+
+  const u8 reg_size = operand16 ? 2 : 4;
+
+  switch (*p++) {
+    case 0x88: out = { 0, 0, 1, 1, true, false, false }; break;                // mov m8, r8
+    case 0x89: out = { 0, 0, reg_size, reg_size, true, false, false }; break;  // mov m, r
+    case 0x8B: out = { 0, 0, reg_size, reg_size, false, false, false }; break;  // mov r, m
+    case 0x0F:
+      switch (*p++) {
+        case 0xB6: out = { 0, 0, 1, reg_size, false, false, false }; break;  // movzx r, m8
+        case 0xB7: out = { 0, 0, 2, reg_size, false, false, false }; break;  // movzx r, m16
+        case 0xBE: out = { 0, 0, 1, reg_size, false, true, false }; break;   // movsx r, m8
+        case 0xBF: out = { 0, 0, 2, reg_size, false, true, false }; break;   // movsx r, m16
+        default: return false;
+      }
+      break;
+    default: return false;
+  }
+
+  const u8 modrm = *p++;
+  const u8 mod = modrm >> 6;
+  const u8 rm = modrm & 7;
+  if (mod == 3)
+    return false;
+
+  out.reg = ((modrm >> 3) & 7) | ((rex & 0x04) ? 8 : 0);
+  out.high_byte = (out.reg_size == 1 && !rex && out.reg >= 4);
+  if (out.high_byte)
+    out.reg -= 4;
+
+  // SIB and displacement
+  if (rm == 4) {
+    const u8 sib = *p++;
+    if (mod == 0 && (sib & 7) == 5)
+      p += 4;
+  } else if (mod == 0 && rm == 5) {
+    p += 4;
+  }
+  if (mod == 1)
+    p += 1;
+  else if (mod == 2)
+    p += 4;
+
+  out.length = static_cast<u8>(p - code);
+  return true;
+}
+
+}  // namespace
+
+Fastmem::~Fastmem() {
+  release();
+}
+
+bool Fastmem::init(const Arena& arena) {
+  const auto fd = arena.fd();
+  if (fd < 0) {
+    LOG_WARN("Fastmem: the memory arena isn't shared memory, disabled");
+    return false;
+  }
+
+  void* base = mmap(nullptr, FASTMEM_REGION_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                    -1, 0);
+  m_base = (base == MAP_FAILED) ? nullptr : static_cast<byte*>(base);
+  if (!m_base) {
+    LOG_WARN("Fastmem: couldn't reserve {} bytes of address space, disabled", FASTMEM_REGION_SIZE);
+    release();
+    return false;
+  }
+
+  if (!map_views(fd)) {
+    LOG_WARN("Fastmem: couldn't map guest memory, disabled");
+    release();
+    return false;
+  }
+
+  // Register ourselves with the SIGSEGV handler, installing it if it's the first time
+  {
+    std::lock_guard<std::mutex> lock(g_install_mutex);
+
+    auto slot = std::find_if(g_instances.begin(), g_instances.end(),
+                             [](const std::atomic<Fastmem*>& instance) { return !instance.load(); });
+    if (slot == g_instances.end()) {
+      LOG_WARN("Fastmem: too many instances, disabled");
+      release();
+      return false;
+    }
+
+    if (!g_handler_installed) {
+      struct sigaction action {};
+      action.sa_sigaction = &Fastmem::on_sigsegv;
+      action.sa_flags = SA_SIGINFO | SA_NODEFER;
+      sigemptyset(&action.sa_mask);
+      if (sigaction(SIGSEGV, &action, &g_previous_action) != 0) {
+        LOG_WARN("Fastmem: couldn't install the SIGSEGV handler, disabled");
+        release();
+        return false;
+      }
+      g_handler_installed = true;
+    }
+
+    slot->store(this);
+  }
+
+  return true;
+}
+
+bool Fastmem::remap(const Arena& arena) {
+  if (!m_base)
+    return false;
+  if (arena.fd() >= 0 && map_views(arena.fd()))
+    return true;
+
+  LOG_WARN("Fastmem: couldn't map guest memory, disabled");
+  release();
+  return false;
+}
+
+bool Fastmem::map_views(s32 fd) {
+  const auto map_view = [this, fd](address addr, u32 arena_offset, u32 size, s32 prot) {
+    const auto view = mmap(m_base + addr, size, prot, MAP_SHARED | MAP_FIXED, fd, arena_offset);
+    return view != MAP_FAILED;
+  };
+
+  bool mapped = true;
+  for (const auto segment : SEGMENT_BASES) {
+    for (u32 mirror = 0; mirror < RAM_MIRROR_COUNT; ++mirror)
+      mapped &= map_view(segment + map::RAM.start() + mirror * RAM_SIZE, Arena::RAM_OFFSET, RAM_SIZE,
+                         PROT_READ | PROT_WRITE);
+    // Pages can't be any smaller, what's past the scratchpad in this one doesn't fault (see Fastmem)
+    mapped &= map_view(segment + map::SCRATCHPAD.start(), Arena::SCRATCHPAD_OFFSET, PageTable::PAGE_SIZE,
+                       PROT_READ | PROT_WRITE);
+    mapped &= map_view(segment + map::BIOS.start(), Arena::BIOS_OFFSET, BIOS_SIZE, PROT_READ);
+  }
+  return mapped;
+}
+
+void Fastmem::release() {
+  {
+    std::lock_guard<std::mutex> lock(g_install_mutex);
+    for (auto& instance : g_instances) {
+      Fastmem* self = this;
+      instance.compare_exchange_strong(self, nullptr);
+    }
+  }
+
+  if (m_base)
+    munmap(m_base, FASTMEM_REGION_SIZE);
+  m_base = nullptr;
+}
+
+void Fastmem::set_writable(address addr, bool writable) {
+  if (!m_base)
+    return;
+
+  const auto offset = addr & (RAM_SIZE - 1) & ~(PageTable::PAGE_SIZE - 1);
+  const s32 prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+
+  for (const auto segment : SEGMENT_BASES) {
+    for (u32 mirror = 0; mirror < RAM_MIRROR_COUNT; ++mirror) {
+      const auto page = m_base + segment + map::RAM.start() + mirror * RAM_SIZE + offset;
+      mprotect(page, PageTable::PAGE_SIZE, prot);
+    }
+  }
+}
+
+void Fastmem::protect_ram() {
+  if (!m_base)
+    return;
+
+  for (const auto segment : SEGMENT_BASES)
+    for (u32 mirror = 0; mirror < RAM_MIRROR_COUNT; ++mirror)
+      mprotect(m_base + segment + map::RAM.start() + mirror * RAM_SIZE, RAM_SIZE, PROT_READ);
+}
+
+void Fastmem::set_handler(FastmemHandler* handler, const u8* code_begin, const u8* code_end) {
+  m_handler = handler;
+  m_code_begin = code_begin;
+  m_code_end = code_end;
+}
+
+void Fastmem::on_sigsegv(int signal, siginfo_t* info, void* context) {
+  const auto fault_addr = static_cast<const byte*>(info->si_addr);
+
+  for (const auto& instance : g_instances) {
+    const Fastmem* fastmem = instance.load(std::memory_order_acquire);
+    if (fastmem && fastmem->handle_fault(fault_addr, context))
+      return;
+  }
+
+  // Not ours, pass it on. Returning with the default action restored faults again and terminates us.
+  if (g_previous_action.sa_flags & SA_SIGINFO) {
+    g_previous_action.sa_sigaction(signal, info, context);
+  } else if (g_previous_action.sa_handler != SIG_DFL && g_previous_action.sa_handler != SIG_IGN) {
+    g_previous_action.sa_handler(signal);
+  } else {
+    struct sigaction action {};
+    action.sa_handler = SIG_DFL;
+    sigaction(SIGSEGV, &action, nullptr);
+  }
+}
+
+bool Fastmem::handle_fault(const byte* fault_addr, void* context) const {
+  if (!m_handler || fault_addr < m_base || fault_addr >= m_base + FASTMEM_REGION_SIZE)
+    return false;
+
+  auto& regs = static_cast<ucontext_t*>(context)->uc_mcontext.gregs;
+  const auto rip = reinterpret_cast<const u8*>(regs[REG_RIP]);
+  if (rip < m_code_begin || rip >= m_code_end)
+    return false;
+
+  HostAccess access;
+  if (!decode_host_access(rip, access))
+    return false;
+
+  const auto addr = static_cast<address>(fault_addr - m_base);
+  auto& reg = regs[CONTEXT_REGISTERS[access.reg]];
+  const u32 shift = access.high_byte ? 8 : 0;
+  const u32 mask = (access.size == 4) ? 0xFFFFFFFF : (1u << (access.size * 8)) - 1;
+
+  if (access.is_store) {
+    m_handler->fastmem_write(addr, static_cast<u32>(reg >> shift) & mask, access.size);
+  } else {
+    u32 val = m_handler->fastmem_read(addr, access.size) & mask;
+    if (access.sign_extend)
+      val = (access.size == 1) ? static_cast<u32>(static_cast<s8>(val))
+                               : static_cast<u32>(static_cast<s16>(val));
+
+    // 32-bit destinations clear the upper half, 16-bit ones leave it alone
+    if (access.reg_size == 4)
+      reg = static_cast<greg_t>(val);
+    else
+      reg = (reg & ~static_cast<greg_t>(0xFFFF)) | (val & 0xFFFF);
+  }
+
+  regs[REG_RIP] += access.length;
+  return true;
+}
+
+#else
+
+Fastmem::~Fastmem() = default;
+
+bool Fastmem::init(const Arena&) {
+  return false;
+}
+
+bool Fastmem::remap(const Arena&) {
+  return false;
+}
+
+void Fastmem::release() {}
+
+void Fastmem::set_writable(address, bool) {}
+
+void Fastmem::protect_ram() {}
+
+void Fastmem::set_handler(FastmemHandler* handler, const u8* code_begin, const u8* code_end) {
+  m_handler = handler;
+  m_code_begin = code_begin;
+  m_code_end = code_end;
+}
+
+#endif
+
+}  // namespace memory
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <util/types.hpp>
+
+#if defined(__linux__) && defined(__x86_64__)
+#define FASTMEM_SUPPORTED 1
+#else
+#define FASTMEM_SUPPORTED 0
+#endif
+
+#if FASTMEM_SUPPORTED
+#include <csignal>
+#endif
+
+namespace memory {
+
+class Arena;
+
+// Performs the accesses of native code that fault in the Fastmem region
+class FastmemHandler {
+ public:
+  virtual u32 fastmem_read(address addr, u32 size) = 0;
+  virtual void fastmem_write(address addr, u32 val, u32 size) = 0;
+
+ protected:
+  ~FastmemHandler() = default;
+};
+
+// Size of the host address space reserved for the guest's, all 32-bit addresses fall in it
+constexpr u64 FASTMEM_REGION_SIZE = 0x100000000;
+
+// Maps RAM (and its mirrors), the scratchpad and the BIOS into a reserved region of the host address
+// space, at all of their KUSEG, KSEG0 and KSEG1 addresses, so that native code can access guest
+// (virtual) address addr at base() + addr with a single mov and no translation.
+// Everything else (MMIO, KSEG2) is left inaccessible. Accesses to it fault, and the SIGSEGV handler
+// decodes the faulting instruction, performs the access through a FastmemHandler and resumes after it.
+// The scratchpad (1KB) is mapped as a whole host page, the rest of which is the arena's padding: native
+// code has to leave accesses to 0x1F800400-0x1F800FFF to the bus itself.
+// Linux x86-64 only, as it relies on memfd and the host's instruction encoding.
+class Fastmem {
+ public:
+  ~Fastmem();
+
+  // Maps views of arena's RAM, scratchpad and BIOS (which has to outlive this). Returns false if that's
+  // not possible, e.g. the arena isn't backed by a memfd, the region isn't used then.
+  bool init(const Arena& arena);
+
+  // Maps views of arena's memfd in place of the current ones, after it changed (see Arena::unshare).
+  // base() stays the same. Writable pages are reset, and have to be set again.
+  bool remap(const Arena& arena);
+  // Unmaps the region, base() is nullptr afterwards
+  void release();
+
+  // Start of the region, nullptr if it isn't available
+  byte* base() const { return m_base; }
+
+  // Makes native writes to the RAM page (physical address) addr fault, so that the handler sees them
+  void set_writable(address addr, bool writable);
+  // Same for all of RAM at once
+  void protect_ram();
+
+  // Faulting accesses from native code in [code_begin, code_end) are performed by handler, nullptr to
+  // stop
+  void set_handler(FastmemHandler* handler, const u8* code_begin, const u8* code_end);
+
+ private:
+#if FASTMEM_SUPPORTED
+  static void on_sigsegv(int signal, siginfo_t* info, void* context);
+  bool handle_fault(const byte* fault_addr, void* context) const;
+  bool map_views(s32 fd);
+#endif
+
+  byte* m_base{};
+
+  FastmemHandler* m_handler{};
+  const u8* m_code_begin{};
+  const u8* m_code_end{};
+};
+
+}  // namespace memory
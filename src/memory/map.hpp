@@ -10,11 +10,13 @@ static constexpr u32 RAM_SIZE = 2 * 1024 * 1024;  // Main RAM, 2 MB
 static constexpr u32 SCRATCHPAD_SIZE = 1024;      // Scratch pad, 1KB
 static constexpr u32 SPU_SIZE = 0x280;
 static constexpr u32 EXPANSION_1_SIZE = 1024 * 1024;
+static constexpr u32 RAM_MIRROR_COUNT = 4;  // RAM is mirrored in the first 8 MB
 
 namespace map {
 
 // Memory map (physical addresses)
 static constexpr Range RAM{ 0x00000000, RAM_SIZE };
+static constexpr Range RAM_MIRRORS{ 0x00000000, RAM_SIZE * RAM_MIRROR_COUNT };
 static constexpr Range BIOS{ 0x1FC00000, BIOS_SIZE };
 static constexpr Range SPU{ 0x1F801C00, SPU_SIZE };
 static constexpr Range MEM_CONTROL1{ 0x1F801000, 0x24 };
@@ -0,0 +1,39 @@
+#include <memory/page_table.hpp>
+
+#include <gsl-lite.hpp>
+
+#include <algorithm>
+
+namespace memory {
+
+PageTable::PageTable()
+    : m_read(std::make_unique<Page<const byte*>[]>(PAGE_COUNT)),
+      m_write(std::make_unique<Page<byte*>[]>(PAGE_COUNT)),
+      m_write_mapped(std::make_unique<Page<byte*>[]>(PAGE_COUNT)) {}
+
+template <typename Pointer>
+void PageTable::map(Page<Pointer>* pages, address addr, u32 size, Pointer host, u32 host_size) {
+  Expects(addr % PAGE_SIZE == 0 && addr + size <= ADDRESS_SPACE_SIZE);
+  Expects(host_size != 0 && (host_size & (host_size - 1)) == 0);
+
+  const auto page_size = std::min(host_size, PAGE_SIZE);
+
+  for (u32 offset = 0; offset < size; offset += PAGE_SIZE)
+    pages[(addr + offset) >> PAGE_SHIFT] = { host + (offset & (host_size - 1)), page_size };
+}
+
+void PageTable::map_read(address addr, u32 size, const byte* host, u32 host_size) {
+  map(m_read.get(), addr, size, host, host_size);
+}
+
+void PageTable::map_write(address addr, u32 size, byte* host, u32 host_size) {
+  map(m_write.get(), addr, size, host, host_size);
+  map(m_write_mapped.get(), addr, size, host, host_size);
+}
+
+void PageTable::set_writable(address addr, bool writable) {
+  const auto page = addr >> PAGE_SHIFT;
+  m_write[page].host = writable ? m_write_mapped[page].host : nullptr;
+}
+
+}  // namespace memory
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <util/types.hpp>
+
+#include <cstring>
+#include <memory>
+
+namespace memory {
+
+// Maps the 4KB pages of the physical address space to the host memory backing them, so that accesses
+// to RAM (and its mirrors), the scratchpad and the BIOS are a single lookup. Pages that aren't mapped
+// are MMIO and have to go through the Bus' device handlers.
+class PageTable {
+ public:
+  static constexpr u32 PAGE_SHIFT = 12;
+  static constexpr u32 PAGE_SIZE = 1 << PAGE_SHIFT;
+  static constexpr u32 ADDRESS_SPACE_SIZE = 0x20000000;  // Physical addresses are 29-bit
+  static constexpr u32 PAGE_COUNT = ADDRESS_SPACE_SIZE / PAGE_SIZE;
+
+  PageTable();
+
+  // Maps size bytes at (page aligned) addr to host, which is mirrored if host_size is smaller.
+  // host_size must be a power of 2. Memory smaller than a page (the scratchpad) only covers its start,
+  // the rest of the page is left to the device handlers like unmapped pages.
+  void map_read(address addr, u32 size, const byte* host, u32 host_size);
+  void map_write(address addr, u32 size, byte* host, u32 host_size);
+  // Makes writes to a page mapped with map_write go through the device handlers (or not anymore), for
+  // when they need to have side effects
+  void set_writable(address addr, bool writable);
+
+  // Host memory backing the physical address addr, nullptr if it's MMIO
+  const byte* read_ptr(address addr) const { return lookup(m_read.get(), addr); }
+  byte* write_ptr(address addr) const { return lookup(m_write.get(), addr); }
+
+  template <typename ValueType>
+  static ValueType load(const byte* host) {
+    ValueType val;
+    std::memcpy(&val, host, sizeof(ValueType));
+    return val;
+  }
+
+  template <typename ValueType>
+  static void store(byte* host, ValueType val) {
+    std::memcpy(host, &val, sizeof(ValueType));
+  }
+
+ private:
+  template <typename Pointer>
+  struct Page {
+    Pointer host;  // nullptr for MMIO
+    u32 size;      // Offsets in the page from there on aren't mapped either
+  };
+
+  template <typename Pointer>
+  static Pointer lookup(const Page<Pointer>* pages, address addr) {
+    if (addr >= ADDRESS_SPACE_SIZE)
+      return nullptr;
+    const auto& page = pages[addr >> PAGE_SHIFT];
+    const auto offset = addr & (PAGE_SIZE - 1);
+    return (page.host && offset < page.size) ? page.host + offset : nullptr;
+  }
+
+  template <typename Pointer>
+  static void map(Page<Pointer>* pages, address addr, u32 size, Pointer host, u32 host_size);
+
+  std::unique_ptr<Page<const byte*>[]> m_read;
+  std::unique_ptr<Page<byte*>[]> m_write;
+  // What write pages map to while they aren't writable
+  std::unique_ptr<Page<byte*>[]> m_write_mapped;
+};
+
+}  // namespace memory
@@ -1,5 +1,8 @@
 #include <memory/ram.hpp>
 
+#include <cpu/block_cache.hpp>
+#include <memory/fastmem.hpp>
+#include <memory/page_table.hpp>
 #include <util/load_file.hpp>
 #include <util/log.hpp>
 
@@ -10,11 +13,13 @@
 
 namespace memory {
 
-Ram::Ram(fs::path psxexe_path) : m_psxexe_path(psxexe_path) {
-  std::fill(m_data->begin(), m_data->end(), 0);
+Ram::Ram(fs::path psxexe_path, byte* storage) : Addressable(storage), m_psxexe_path(psxexe_path) {}
+
+void Ram::init(cpu::BlockCache* block_cache) {
+  m_block_cache = block_cache;
 }
 
-bool Ram::load_executable(PSEXELoadInfo& out_psx_load_info) const {
+bool Ram::load_executable(PSEXELoadInfo& out_psx_load_info) {
   if (m_psxexe_path.empty())
     return false;
 
@@ -23,21 +28,6 @@ bool Ram::load_executable(PSEXELoadInfo& out_psx_load_info) const {
   if (psx_exe_buf.empty())
     return false;
 
-  struct PSXEXEHeader {
-    char magic[8];  // "PS-X EXE"
-    u8 pad0[8];
-    u32 pc;         // initial PC
-    u32 r28;        // initial R28
-    u32 load_addr;  // destination address in RAM
-    u32 filesize;   // excluding header & must be N*0x800
-    u32 unk0[2];
-    u32 memfill_start;
-    u32 memfill_size;
-    u32 r29_r30;         // initial r29 and r30 base
-    u32 r29_r30_offset;  // initial r29 and r30 offset, added to above
-    // etc, we don't care about anything else
-  };
-
   const auto psx_exe = (PSXEXEHeader*)psx_exe_buf.data();
 
   if (std::strcmp(&psx_exe->magic[0], "PS-X EXE")) {
@@ -53,19 +43,136 @@ bool Ram::load_executable(PSEXELoadInfo& out_psx_load_info) const {
   out_psx_load_info.r28 = psx_exe->r28;
   out_psx_load_info.r29_r30 = psx_exe->r29_r30 + psx_exe->r29_r30_offset;
 
-  constexpr auto PSXEXE_HEADER_SIZE = 0x800;
-
   const auto copy_src_begin = psx_exe_buf.data() + PSXEXE_HEADER_SIZE;
   const auto copy_src_end = copy_src_begin + psx_exe->filesize;
-  const auto copy_dest_begin = m_data->data() + (psx_exe->load_addr & 0x7FFFFFFF);
+  const auto copy_dest_offset = psx_exe->load_addr & 0x7FFFFFFF;
+  const auto copy_dest_begin = m_data->data() + copy_dest_offset;
 
   std::copy(copy_src_begin, copy_src_end, copy_dest_begin);
+  invalidate_code_range(copy_dest_offset, psx_exe->filesize);
+  mark_range_written(copy_dest_offset, psx_exe->filesize);
 
   return true;
 }
 
-Scratchpad::Scratchpad() {
-  std::fill(m_data->begin(), m_data->end(), 0);
+void Ram::mark_code_page(u32 page) {
+  if (m_code_pages[page])
+    return;
+  m_code_pages[page] = true;
+  update_page_table(page);
+}
+
+void Ram::set_write_log(std::vector<RamWrite>* log) {
+  m_write_log = log;
+
+  for (u32 page = 0; page < RAM_PAGE_COUNT; ++page)
+    update_page_table(page);
+}
+
+void Ram::set_page_table(PageTable* page_table) {
+  m_page_table = page_table;
+
+  for (u32 page = 0; page < RAM_PAGE_COUNT; ++page)
+    update_page_table(page);
+}
+
+void Ram::set_fastmem(Fastmem* fastmem) {
+  m_fastmem = fastmem;
+
+  for (u32 page = 0; page < RAM_PAGE_COUNT; ++page)
+    update_page_table(page);
+}
+
+void Ram::invalidate_code_page(u32 page) {
+  m_code_pages[page] = false;
+  update_page_table(page);
+
+  if (m_block_cache)
+    m_block_cache->invalidate_page(page);
+}
+
+void Ram::invalidate_code_range(address addr, u32 size) {
+  if (size == 0)
+    return;
+
+  const auto first_page = addr / RAM_PAGE_SIZE;
+  const auto last_page = std::min((addr + size - 1) / RAM_PAGE_SIZE, RAM_PAGE_COUNT - 1);
+
+  for (auto page = first_page; page <= last_page; ++page)
+    if (m_code_pages[page])
+      invalidate_code_page(page);
+}
+
+void Ram::on_bulk_write(address addr, u32 size) {
+  if (m_write_log) {
+    for (u32 offset = 0; offset < size; offset += 4)
+      m_write_log->push_back({ addr + offset, read<u32>(addr + offset), 4 });
+  }
+
+  invalidate_code_range(addr, size);
+  mark_range_written(addr, size);
+}
+
+u64 Ram::start_write_generation() {
+  ++m_write_generation;
+
+  // No page has been written in it yet
+  if (m_page_table) {
+    for (u32 page = 0; page < RAM_PAGE_COUNT; ++page)
+      for (u32 mirror = 0; mirror < RAM_MIRROR_COUNT; ++mirror)
+        m_page_table->set_writable(map::RAM.start() + mirror * RAM_SIZE + page * RAM_PAGE_SIZE, false);
+  }
+  if (m_fastmem)
+    m_fastmem->protect_ram();
+
+  return m_write_generation;
+}
+
+void Ram::pages_written_since(u64 generation, std::vector<u32>& pages) const {
+  for (u32 page = 0; page < RAM_PAGE_COUNT; ++page)
+    if (m_page_generations[page] >= generation)
+      pages.push_back(page);
+}
+
+void Ram::mark_page_written(u32 page) {
+  m_page_generations[page] = m_write_generation;
+  update_page_table(page);
+}
+
+void Ram::mark_range_written(address addr, u32 size) {
+  if (size == 0)
+    return;
+
+  const auto first_page = addr / RAM_PAGE_SIZE;
+  const auto last_page = std::min((addr + size - 1) / RAM_PAGE_SIZE, RAM_PAGE_COUNT - 1);
+
+  for (auto page = first_page; page <= last_page; ++page)
+    mark_page_written(page);
+}
+
+void Ram::serialize(util::Serializer& s) {
+  Addressable::serialize(s);
+
+  if (s.is_loading()) {
+    m_code_pages.fill(false);
+    m_page_generations.fill(m_write_generation);
+    for (u32 page = 0; page < RAM_PAGE_COUNT; ++page)
+      update_page_table(page);
+  }
+}
+
+void Ram::update_page_table(u32 page) {
+  static_assert(RAM_PAGE_SIZE == PageTable::PAGE_SIZE, "RAM pages must match the page table's");
+
+  const bool writable =
+      !m_code_pages[page] && !m_write_log && m_page_generations[page] == m_write_generation;
+
+  if (m_page_table) {
+    for (u32 mirror = 0; mirror < RAM_MIRROR_COUNT; ++mirror)
+      m_page_table->set_writable(map::RAM.start() + mirror * RAM_SIZE + page * RAM_PAGE_SIZE, writable);
+  }
+  if (m_fastmem)
+    m_fastmem->set_writable(page * RAM_PAGE_SIZE, writable);
 }
 
 }  // namespace memory
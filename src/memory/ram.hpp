@@ -7,9 +7,51 @@
 
 #include <array>
 #include <memory>
+#include <vector>
+
+namespace cpu {
+class BlockCache;
+}
 
 namespace memory {
 
+class PageTable;
+class Fastmem;
+
+// RAM is split in pages for tracking writes (to code, and for consumers of write generations)
+static constexpr u32 RAM_PAGE_SIZE = 4 * 1024;
+static constexpr u32 RAM_PAGE_COUNT = RAM_SIZE / RAM_PAGE_SIZE;
+
+struct PSXEXEHeader {
+  char magic[8];  // "PS-X EXE"
+  u8 pad0[8];
+  u32 pc;         // initial PC
+  u32 r28;        // initial R28
+  u32 load_addr;  // destination address in RAM
+  u32 filesize;   // excluding header & must be N*0x800
+  u32 unk0[2];
+  u32 memfill_start;
+  u32 memfill_size;
+  u32 r29_r30;         // initial r29 and r30 base
+  u32 r29_r30_offset;  // initial r29 and r30 offset, added to above
+  // etc, we don't care about anything else
+};
+
+// The code and data to load start after the header, at this offset in the file
+constexpr u32 PSXEXE_HEADER_SIZE = 0x800;
+
+// A write to RAM, as recorded for lockstep checking (see emulator::LockstepChecker)
+struct RamWrite {
+  address addr;
+  u32 val;
+  u8 size;  // In bytes
+
+  bool operator==(const RamWrite& other) const {
+    return addr == other.addr && val == other.val && size == other.size;
+  }
+  bool operator!=(const RamWrite& other) const { return !(*this == other); }
+};
+
 struct PSEXELoadInfo {
   u32 pc;
   u32 r28;
@@ -18,17 +60,77 @@ struct PSEXELoadInfo {
 
 class Ram : public Addressable<memory::RAM_SIZE> {
  public:
-  explicit Ram(fs::path psxexe_path);
-  bool load_executable(PSEXELoadInfo& out_psx_load_info) const;  // Returns true on successful load
+  explicit Ram(fs::path psxexe_path, byte* storage);
+  void init(cpu::BlockCache* block_cache);
+  bool load_executable(PSEXELoadInfo& out_psx_load_info);  // Returns true on successful load
   const std::array<byte, RAM_SIZE>& data() const { return *m_data; }
 
+  template <typename ValueType>
+  void write(address addr, ValueType val) {
+    Addressable::write(addr, val);
+
+    if (m_write_log)
+      m_write_log->push_back({ addr, static_cast<u32>(val), sizeof(ValueType) });
+
+    const auto page = addr / RAM_PAGE_SIZE;
+    if (m_code_pages[page])
+      invalidate_code_page(page);
+    if (m_page_generations[page] != m_write_generation)
+      mark_page_written(page);
+  }
+
+  // For bulk writes straight to data_ptr() (e.g. by DMA): has the side effects of write()ing the size
+  // bytes (whole words) at addr, once they've been written
+  void on_bulk_write(address addr, u32 size);
+
+  // Restoring also forgets which pages contain cached code, the BlockCache is cleared along with it
+  void serialize(util::Serializer& s);
+
+  // Marks a page as containing cached code, so that the next write to it invalidates the code
+  void mark_code_page(u32 page);
+
+  // Records all writes to log from now on, nullptr to stop
+  void set_write_log(std::vector<RamWrite>* log);
+
+  // Writes bypass write() through page_table's mapping of RAM, unless they need to be seen here (code
+  // pages, write log, first write in a generation), so its pages are kept up to date from now on
+  void set_page_table(PageTable* page_table);
+  // Same for native code's direct accesses
+  void set_fastmem(Fastmem* fastmem);
+
+  // Write generations. Every page remembers the generation it was last written in, by any path (CPU
+  // stores, DMA, executable loading, state restores). Consumers (e.g. incremental state saving) start a
+  // new generation, and later ask which pages have been written since it started.
+  // Starting one makes the fast paths of the next write to each page go through write(), nothing is
+  // slowed down when generations aren't used.
+  u64 start_write_generation();
+  bool is_page_written_since(u32 page, u64 generation) const {
+    return m_page_generations[page] >= generation;
+  }
+  // Appends the pages written since generation started to pages
+  void pages_written_since(u64 generation, std::vector<u32>& pages) const;
+
  private:
+  void invalidate_code_page(u32 page);
+  void invalidate_code_range(address addr, u32 size);
+  void mark_page_written(u32 page);
+  void mark_range_written(address addr, u32 size);
+  void update_page_table(u32 page);
+
   fs::path m_psxexe_path;
+
+  std::array<bool, RAM_PAGE_COUNT> m_code_pages{};
+  u64 m_write_generation{};
+  std::array<u64, RAM_PAGE_COUNT> m_page_generations{};  // Generation each page was last written in
+  cpu::BlockCache* m_block_cache{};
+  std::vector<RamWrite>* m_write_log{};
+  PageTable* m_page_table{};
+  Fastmem* m_fastmem{};
 };
 
 class Scratchpad : public Addressable<memory::SCRATCHPAD_SIZE> {
  public:
-  explicit Scratchpad();
+  explicit Scratchpad(byte* storage) : Addressable(storage) {}
 };
 
 }  // namespace memory
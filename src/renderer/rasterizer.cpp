@@ -312,7 +312,7 @@ void Rasterizer::extract_draw_data_polygon(const DrawCommand::Polygon& polygon,
 }
 
 void Rasterizer::draw_polygon(const DrawCommand::Polygon& polygon) {
-  const auto gp0_cmd = m_gpu.gp0_cmd();
+  const auto& gp0_cmd = m_gpu.gp0_cmd();
 
   Position4 positions{};
   Color4 colors{};
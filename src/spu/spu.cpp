@@ -5,9 +5,7 @@
 #include <algorithm>
 
 namespace spu {
-Spu::Spu() {
-  std::fill(m_data->begin(), m_data->end(), 0);
-
+Spu::Spu(byte* storage) : Addressable(storage) {
   write<u16>(0x1AA, 0x8000);  // hard-code SPUCNT
   //  write<u16>(0x1AE, 0x10);  // hard-code SPUCNT
 }
@@ -7,7 +7,7 @@ namespace spu {
 
 class Spu : public memory::Addressable<memory::SPU_SIZE> {
  public:
-  Spu();
+  explicit Spu(byte* storage);
   // TODO
  private:
 };
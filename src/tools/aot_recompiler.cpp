@@ -0,0 +1,462 @@
+// Translates the code of a PS-X EXE to C++ ahead of time, to be built into a module the emulator loads
+// when running it (see cpu/aot_cache.hpp).
+// Functions are found by following calls and branches from the entry point. Their blocks are split the
+// same way the BlockCache splits them at runtime, so that each one can be entered wherever the emulator
+// looks one up. ALU and branch instructions are translated to C++, the rest goes through the emulator's
+// interpreter, just like with the Recompiler. Code that isn't found (jump tables, function pointers) is
+// left to the emulator.
+//
+// Build the output as a shared library named after the executable (game.exe -> game.so/game.dll), with
+// src/ in the include path. pctation_add_aot_module() in this directory's CMakeLists.txt does that.
+
+#include <cpu/aot_abi.hpp>
+#include <cpu/block_cache.hpp>
+#include <cpu/cycles.hpp>
+#include <cpu/instruction.hpp>
+#include <cpu/opcode.hpp>
+#include <memory/ram.hpp>
+#include <util/load_file.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+using cpu::Instruction;
+using cpu::Opcode;
+
+namespace {
+
+struct Executable {
+  address load_addr{};
+  address entry_pc{};
+  std::vector<u32> words;
+
+  bool contains(address addr) const {
+    return addr % 4 == 0 && addr >= load_addr && (addr - load_addr) / 4 < words.size();
+  }
+  Instruction instruction(address addr) const { return Instruction(words[(addr - load_addr) / 4]); }
+};
+
+struct Function {
+  address entry{};
+  std::map<address, u32> blocks;  // Instruction count by start address
+  address start{};                // Range of its code, end is exclusive
+  address end{};
+};
+
+bool load_executable(const char* path, Executable& exe) {
+  const auto buf = util::load_file(path);
+  if (buf.size() < memory::PSXEXE_HEADER_SIZE) {
+    std::fprintf(stderr, "Couldn't read %s\n", path);
+    return false;
+  }
+
+  memory::PSXEXEHeader header;
+  std::memcpy(&header, buf.data(), sizeof(header));
+  if (std::memcmp(header.magic, "PS-X EXE", sizeof(header.magic)) != 0) {
+    std::fprintf(stderr, "%s is not a PS-X EXE\n", path);
+    return false;
+  }
+
+  const auto size = std::min<size_t>(header.filesize, buf.size() - memory::PSXEXE_HEADER_SIZE);
+  exe.load_addr = header.load_addr;
+  exe.entry_pc = header.pc;
+  exe.words.resize(size / 4);
+  std::memcpy(exe.words.data(), buf.data() + memory::PSXEXE_HEADER_SIZE, exe.words.size() * 4);
+  return true;
+}
+
+address branch_target(const Instruction& i, address pc) {
+  return pc + 4 + (i.imm16_se() << 2);
+}
+
+address jump_target(const Instruction& i, address pc) {
+  return ((pc + 8) & 0xF0000000) | (i.imm26() << 2);
+}
+
+// Branches relative to the PC (as opposed to jumps)
+bool is_relative_branch(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::BEQ:
+    case Opcode::BNE:
+    case Opcode::BGTZ:
+    case Opcode::BLEZ:
+    case Opcode::BCONDZ: return true;
+    default: return false;
+  }
+}
+
+// Whether a BCONDZ instruction links (BLTZAL/BGEZAL), see Cpu::execute_instruction
+bool bcondz_links(const Instruction& i) {
+  return (i.rt() & 0x1E) == 0x10;
+}
+
+class Analyzer {
+ public:
+  explicit Analyzer(const Executable& exe) : m_exe(exe) {}
+
+  std::vector<Function> run() {
+    m_function_queue.push_back(m_exe.entry_pc);
+
+    std::vector<Function> functions;
+    while (!m_function_queue.empty()) {
+      const auto entry = m_function_queue.front();
+      m_function_queue.pop_front();
+
+      if (!m_exe.contains(entry) || m_block_owner.count(entry))
+        continue;
+
+      auto function = analyze_function(entry);
+      if (!function.blocks.empty())
+        functions.push_back(std::move(function));
+    }
+    return functions;
+  }
+
+ private:
+  Function analyze_function(address entry) {
+    Function function;
+    function.entry = entry;
+
+    std::deque<address> block_queue{ entry };
+    while (!block_queue.empty()) {
+      const auto start = block_queue.front();
+      block_queue.pop_front();
+
+      if (!m_exe.contains(start) || m_block_owner.count(start))
+        continue;
+
+      const auto instruction_count = analyze_block(start, block_queue);
+      if (instruction_count == 0)
+        continue;
+
+      m_block_owner[start] = entry;
+      function.blocks[start] = instruction_count;
+    }
+
+    if (!function.blocks.empty()) {
+      function.start = function.blocks.begin()->first;
+      for (const auto& block : function.blocks)
+        function.end = std::max(function.end, block.first + block.second * 4);
+    }
+    return function;
+  }
+
+  // Decodes a block like BlockCache::compile_block, and queues the blocks and functions it leads to.
+  // Returns its instruction count, 0 if it can't be translated.
+  u32 analyze_block(address start, std::deque<address>& block_queue) {
+    address addr = start;
+    u32 instruction_count = 0;
+    bool in_delay_slot = false;
+    address branch_addr = 0;
+
+    while (instruction_count < cpu::MAX_BLOCK_INSTRUCTIONS && m_exe.contains(addr)) {
+      const auto instr = m_exe.instruction(addr);
+      ++instruction_count;
+      addr += 4;
+
+      // Likely data, the emulator's interpreter takes care of these
+      if (instr.opcode() == Opcode::INVALID)
+        return 0;
+
+      if (in_delay_slot)
+        break;
+      // Syscalls and breaks return to the next instruction once handled
+      if (instr.opcode() == Opcode::SYSCALL || instr.opcode() == Opcode::BREAK) {
+        block_queue.push_back(addr);
+        return instruction_count;
+      }
+
+      in_delay_slot = cpu::is_branch(instr.opcode());
+      if (in_delay_slot)
+        branch_addr = addr - 4;
+    }
+
+    if (!in_delay_slot) {
+      // Split because it's too long, or the executable ends
+      block_queue.push_back(addr);
+      return instruction_count;
+    }
+
+    const auto branch = m_exe.instruction(branch_addr);
+    const auto return_addr = branch_addr + 8;
+    switch (branch.opcode()) {
+      case Opcode::BEQ:
+      case Opcode::BNE:
+      case Opcode::BGTZ:
+      case Opcode::BLEZ:
+        block_queue.push_back(branch_target(branch, branch_addr));
+        block_queue.push_back(return_addr);
+        break;
+      case Opcode::BCONDZ:
+        if (bcondz_links(branch))
+          m_function_queue.push_back(branch_target(branch, branch_addr));
+        else
+          block_queue.push_back(branch_target(branch, branch_addr));
+        block_queue.push_back(return_addr);
+        break;
+      case Opcode::J: block_queue.push_back(jump_target(branch, branch_addr)); break;
+      case Opcode::JAL:
+        m_function_queue.push_back(jump_target(branch, branch_addr));
+        block_queue.push_back(return_addr);
+        break;
+      case Opcode::JALR: block_queue.push_back(return_addr); break;
+      default: break;  // JR, returns or jump tables
+    }
+    return instruction_count;
+  }
+
+  const Executable& m_exe;
+  std::deque<address> m_function_queue;
+  std::map<address, address> m_block_owner;  // Function entry by block start
+};
+
+class Emitter {
+ public:
+  Emitter(const Executable& exe, FILE* out) : m_exe(exe), m_out(out) {}
+
+  void emit_module(const char* exe_path, const std::vector<Function>& functions) {
+    std::fprintf(m_out, "// Translated from %s by aot_recompiler, don't edit\n\n", exe_path);
+    std::fprintf(m_out, "#include <cpu/aot_abi.hpp>\n\n");
+    std::fprintf(m_out, "using namespace cpu::aot;\n\n");
+
+    for (const auto& function : functions)
+      emit_function(function);
+
+    std::fprintf(m_out, "static const Function FUNCTIONS[] = {\n");
+    for (const auto& function : functions) {
+      std::fprintf(m_out,
+                   "  { 0x%08Xu, %uu, words_%08X, block_starts_%08X, %uu, &function_%08X },\n",
+                   function.start, (function.end - function.start) / 4, function.entry, function.entry,
+                   static_cast<u32>(function.blocks.size()), function.entry);
+    }
+    std::fprintf(m_out, "};\n\n");
+
+    std::fprintf(m_out, "static const Module MODULE = { ABI_VERSION, %uu, FUNCTIONS };\n\n",
+                 static_cast<u32>(functions.size()));
+    std::fprintf(m_out, "PCTATION_AOT_EXPORT const Module* pctation_aot_module() {\n");
+    std::fprintf(m_out, "  return &MODULE;\n");
+    std::fprintf(m_out, "}\n");
+  }
+
+ private:
+  void emit_function(const Function& function) {
+    const auto entry = function.entry;
+
+    std::fprintf(m_out, "// Function at 0x%08X\n\n", entry);
+
+    std::fprintf(m_out, "static const uint32_t words_%08X[] = {", entry);
+    for (address addr = function.start; addr < function.end; addr += 4) {
+      const auto n = (addr - function.start) / 4;
+      std::fprintf(m_out, "%s0x%08Xu,", (n % 8 == 0) ? "\n  " : " ", m_exe.instruction(addr).word());
+    }
+    std::fprintf(m_out, "\n};\n\n");
+
+    std::fprintf(m_out, "static const uint32_t block_starts_%08X[] = {", entry);
+    u32 n = 0;
+    for (const auto& block : function.blocks)
+      std::fprintf(m_out, "%s0x%08Xu,", (n++ % 8 == 0) ? "\n  " : " ", block.first);
+    std::fprintf(m_out, "\n};\n\n");
+
+    std::fprintf(m_out, "static uint32_t function_%08X(Context* c, uint32_t pc) {\n", entry);
+    std::fprintf(m_out, "  const uint32_t invalidation_count = *c->invalidation_count;\n");
+    std::fprintf(m_out, "  uint32_t done = 0;\n\n");
+    std::fprintf(m_out, "dispatch:\n");
+    std::fprintf(m_out, "  switch (pc) {\n");
+    for (const auto& block : function.blocks)
+      std::fprintf(m_out, "    case 0x%08Xu: goto block_%08X;\n", block.first, block.first);
+    std::fprintf(m_out, "    default: return done;\n");
+    std::fprintf(m_out, "  }\n");
+
+    for (const auto& block : function.blocks)
+      emit_block(block.first, block.second);
+
+    std::fprintf(m_out, "}\n\n");
+  }
+
+  void emit_block(address start, u32 instruction_count) {
+    std::fprintf(m_out, "\nblock_%08X:\n", start);
+
+    for (u32 n = 0; n < instruction_count; ++n) {
+      const auto pc = start + n * 4;
+      const auto instr = m_exe.instruction(pc);
+      const bool is_delay_slot = n > 0 && cpu::is_branch(m_exe.instruction(pc - 4).opcode());
+      const bool is_last = n + 1 == instruction_count;
+
+      std::fprintf(m_out, "  // 0x%08X: %s\n", pc, instr.disassemble().c_str());
+
+      // Branches in delay slots compute their target from the previous branch's, leave those to the
+      // interpreter
+      if (!cpu::is_native(instr.opcode()) || (is_delay_slot && cpu::is_branch(instr.opcode()))) {
+        std::fprintf(m_out, "  if (c->interpret(c->cpu, 0x%08Xu))\n", instr.word());
+        std::fprintf(m_out, "    return done + %u;\n", n + 1);
+        continue;
+      }
+
+      if (is_delay_slot)
+        std::fprintf(m_out, "  begin_delay_slot(c);\n");
+      else
+        std::fprintf(m_out, "  begin(c, 0x%08Xu);\n", pc);
+      emit_instruction(instr, pc);
+      std::fprintf(m_out, "  end(c);\n");
+
+      const u32 cycles = cpu::INSTRUCTION_CYCLES[static_cast<u32>(instr.opcode())];
+      if (is_last) {
+        std::fprintf(m_out, "  charge_cycles(c, %u);\n", cycles);
+      } else {
+        std::fprintf(m_out, "  if (charge_cycles(c, %u)) {\n", cycles);
+        std::fprintf(m_out, "    *c->pc_current = 0x%08Xu;\n", pc);
+        std::fprintf(m_out, "    return done + %u;\n", n + 1);
+        std::fprintf(m_out, "  }\n");
+      }
+    }
+
+    const auto last_pc = start + (instruction_count - 1) * 4;
+    std::fprintf(m_out, "  *c->pc_current = 0x%08Xu;\n", last_pc);
+    std::fprintf(m_out, "  done += %u;\n", instruction_count);
+
+    // Idle loops are only detected when they go through Cpu::step, keep them from being chained
+    if (instruction_count >= 2) {
+      const auto branch = m_exe.instruction(start + (instruction_count - 2) * 4);
+      if (is_relative_branch(branch.opcode()) &&
+          branch.imm16_se() == -static_cast<s32>(instruction_count - 1)) {
+        std::fprintf(m_out, "  return done;\n");
+        return;
+      }
+    }
+
+    std::fprintf(m_out, "  if (!can_continue(c, invalidation_count))\n");
+    std::fprintf(m_out, "    return done;\n");
+    std::fprintf(m_out, "  pc = *c->pc;\n");
+    std::fprintf(m_out, "  goto dispatch;\n");
+  }
+
+  // Value of a guest register
+  static std::string reg(cpu::RegisterIndex r) {
+    if (r == 0)
+      return "0u";
+    return "c->gpr[" + std::to_string(r) + "]";
+  }
+
+  void emit_set_gpr(cpu::RegisterIndex r, const std::string& val) {
+    if (r == 0)
+      return;
+    std::fprintf(m_out, "  set_gpr(c, %u, %s);\n", r, val.c_str());
+  }
+
+  void emit_branch_if(const std::string& condition, address target) {
+    std::fprintf(m_out, "  branch(c);\n");
+    std::fprintf(m_out, "  if (%s)\n", condition.c_str());
+    std::fprintf(m_out, "    take_branch(c, 0x%08Xu);\n", target);
+  }
+
+  void emit_instruction(const Instruction& i, address pc) {
+    const auto rs = reg(i.rs());
+    const auto rt = reg(i.rt());
+    const auto rs_signed = "static_cast<int32_t>(" + rs + ")";
+    const auto rt_signed = "static_cast<int32_t>(" + rt + ")";
+    const auto shamt = std::to_string(i.imm5());
+    const auto shamt_reg = "(" + rs + " & 0x1F)";
+    const auto imm_se = hex(static_cast<u32>(static_cast<s32>(i.imm16_se())));
+    const auto imm_ze = hex(i.imm16());
+
+    switch (i.opcode()) {
+      case Opcode::ADDU: emit_set_gpr(i.rd(), rs + " + " + rt); break;
+      case Opcode::SUBU: emit_set_gpr(i.rd(), rs + " - " + rt); break;
+      case Opcode::AND: emit_set_gpr(i.rd(), rs + " & " + rt); break;
+      case Opcode::OR: emit_set_gpr(i.rd(), rs + " | " + rt); break;
+      case Opcode::XOR: emit_set_gpr(i.rd(), rs + " ^ " + rt); break;
+      case Opcode::NOR: emit_set_gpr(i.rd(), "~(" + rs + " | " + rt + ")"); break;
+      case Opcode::ADDIU: emit_set_gpr(i.rt(), rs + " + " + imm_se); break;
+      case Opcode::ANDI: emit_set_gpr(i.rt(), rs + " & " + imm_ze); break;
+      case Opcode::ORI: emit_set_gpr(i.rt(), rs + " | " + imm_ze); break;
+      case Opcode::XORI: emit_set_gpr(i.rt(), rs + " ^ " + imm_ze); break;
+      case Opcode::LUI: emit_set_gpr(i.rt(), hex(i.imm16() << 16)); break;
+      case Opcode::SLT: emit_set_gpr(i.rd(), "(" + rs_signed + " < " + rt_signed + ") ? 1u : 0u"); break;
+      case Opcode::SLTU: emit_set_gpr(i.rd(), "(" + rs + " < " + rt + ") ? 1u : 0u"); break;
+      case Opcode::SLTI:
+        emit_set_gpr(i.rt(), "(" + rs_signed + " < " + std::to_string(i.imm16_se()) + ") ? 1u : 0u");
+        break;
+      case Opcode::SLTIU: emit_set_gpr(i.rt(), "(" + rs + " < " + imm_se + ") ? 1u : 0u"); break;
+      case Opcode::SLL: emit_set_gpr(i.rd(), rt + " << " + shamt); break;
+      case Opcode::SRL: emit_set_gpr(i.rd(), rt + " >> " + shamt); break;
+      case Opcode::SRA:
+        emit_set_gpr(i.rd(), "static_cast<uint32_t>(" + rt_signed + " >> " + shamt + ")");
+        break;
+      case Opcode::SLLV: emit_set_gpr(i.rd(), rt + " << " + shamt_reg); break;
+      case Opcode::SRLV: emit_set_gpr(i.rd(), rt + " >> " + shamt_reg); break;
+      case Opcode::SRAV:
+        emit_set_gpr(i.rd(), "static_cast<uint32_t>(" + rt_signed + " >> " + shamt_reg + ")");
+        break;
+      case Opcode::MTHI: std::fprintf(m_out, "  *c->hi = %s;\n", rs.c_str()); break;
+      case Opcode::MTLO: std::fprintf(m_out, "  *c->lo = %s;\n", rs.c_str()); break;
+      // Link registers are written directly, without going through the load delay logic
+      case Opcode::J:
+      case Opcode::JAL:
+        std::fprintf(m_out, "  branch(c);\n");
+        if (i.opcode() == Opcode::JAL)
+          std::fprintf(m_out, "  c->gpr[31] = 0x%08Xu;\n", pc + 8);
+        std::fprintf(m_out, "  take_branch(c, 0x%08Xu);\n", jump_target(i, pc));
+        break;
+      case Opcode::BEQ: emit_branch_if(rs + " == " + rt, branch_target(i, pc)); break;
+      case Opcode::BNE: emit_branch_if(rs + " != " + rt, branch_target(i, pc)); break;
+      case Opcode::BGTZ: emit_branch_if(rs_signed + " > 0", branch_target(i, pc)); break;
+      case Opcode::BLEZ: emit_branch_if(rs_signed + " <= 0", branch_target(i, pc)); break;
+      case Opcode::BCONDZ: {
+        // rs is read before linking, it might be $ra
+        const bool branch_if_positive = (i.rt() & 1);
+        std::fprintf(m_out, "  {\n");
+        std::fprintf(m_out, "    const int32_t val = %s;\n", rs_signed.c_str());
+        if (bcondz_links(i))
+          std::fprintf(m_out, "    c->gpr[31] = 0x%08Xu;\n", pc + 8);
+        std::fprintf(m_out, "    branch(c);\n");
+        std::fprintf(m_out, "    if (val %s 0)\n", branch_if_positive ? ">=" : "<");
+        std::fprintf(m_out, "      take_branch(c, 0x%08Xu);\n", branch_target(i, pc));
+        std::fprintf(m_out, "  }\n");
+        break;
+      }
+      default: break;
+    }
+  }
+
+  static std::string hex(u32 val) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "0x%08Xu", val);
+    return buf;
+  }
+
+  const Executable& m_exe;
+  FILE* m_out;
+};
+
+}  // namespace
+
+s32 main(s32 argc, char** argv) {
+  if (argc < 3) {
+    std::fprintf(stderr, "Usage: %s <PS-X EXE> <output .cpp>\n", argv[0]);
+    return 1;
+  }
+
+  Executable exe;
+  if (!load_executable(argv[1], exe))
+    return 1;
+
+  const auto functions = Analyzer(exe).run();
+
+  FILE* out = std::fopen(argv[2], "w");
+  if (!out) {
+    std::fprintf(stderr, "Couldn't open %s\n", argv[2]);
+    return 1;
+  }
+  Emitter(exe, out).emit_module(argv[1], functions);
+  std::fclose(out);
+
+  size_t block_count = 0;
+  for (const auto& function : functions)
+    block_count += function.blocks.size();
+  std::printf("Translated %zu functions (%zu blocks)\n", functions.size(), block_count);
+  return 0;
+}
@@ -0,0 +1,78 @@
+// Boots a BIOS (and executable or disc image) once, then runs jobs read from stdin in fork()ed workers
+// that start from the booted state (see emulator/fork_server.hpp).
+// Each line is a job: a number of frames to run. Workers print the job's index, and a hash of all of
+// emulated memory after running it, for comparing against known-good runs.
+// Recompiler workers run without fastmem unless it's asked for, in which case each of them copies all of
+// emulated memory up front instead of sharing it copy-on-write.
+
+#include <emulator/fork_server.hpp>
+#include <memory/arena.hpp>
+#include <util/fs.hpp>
+#include <util/log.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+s32 main(s32 argc, char** argv) {
+  if (argc < 3) {
+    std::fprintf(stderr,
+                 "Usage: %s <BIOS> <PS-X EXE or CD-ROM image, or - for none> [boot frames] "
+                 "[interpreter|recompiler] [fastmem]\n"
+                 "  fastmem: recompiled code accesses memory directly, workers copy all of it\n",
+                 argv[0]);
+    return 1;
+  }
+
+  logging::init();
+
+  const fs::path bios_path = argv[1];
+  const fs::path game_path = (std::strcmp(argv[2], "-") == 0) ? fs::path() : fs::path(argv[2]);
+  const auto boot_frames = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 0;
+  const auto engine = (argc > 4 && std::strcmp(argv[4], "recompiler") == 0)
+                          ? emulator::CpuEngine::Recompiler
+                          : emulator::CpuEngine::Interpreter;
+  const bool fastmem = (argc > 5 && std::strcmp(argv[5], "fastmem") == 0);
+
+  auto extension = game_path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](char c) { return static_cast<char>(std::tolower(c)); });
+  const bool is_exe = extension == ".exe" || extension == ".psx";
+
+  emulator::ForkServer server(bios_path, is_exe ? game_path : fs::path(),
+                              is_exe ? fs::path() : game_path, engine, fastmem);
+  server.boot(static_cast<u32>(boot_frames));
+  std::printf("Booted\n");
+
+  u32 job_index = 0;
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    if (line.empty())
+      continue;
+
+    const auto index = job_index++;
+    const auto frame_count = std::strtoul(line.c_str(), nullptr, 10);
+
+    server.spawn([index, frame_count](emulator::Emulator& emulator) {
+      for (unsigned long frame = 0; frame < frame_count; ++frame)
+        emulator.advance_frame();
+
+      const auto& memory = emulator.arena();
+      const auto hash = std::hash<std::string_view>{}(
+          std::string_view(reinterpret_cast<const char*>(memory.data()), memory::Arena::SIZE));
+      std::printf("%u %lu %016zX\n", index, frame_count, hash);
+      return 0;
+    });
+  }
+
+  const auto failed = server.wait_all();
+  if (failed != 0)
+    std::fprintf(stderr, "%u of %u jobs failed\n", failed, job_index);
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+// Runs an executable or disc image with the recompiler and the interpreter in lockstep, and reports the
+// first point their states differ (see emulator/lockstep_checker.hpp)
+
+#include <emulator/lockstep_checker.hpp>
+#include <util/fs.hpp>
+#include <util/log.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+s32 main(s32 argc, char** argv) {
+  if (argc < 3) {
+    std::fprintf(stderr,
+                 "Usage: %s <BIOS> <PS-X EXE or CD-ROM image> [frames] [cold]\n"
+                 "  cold: check the BIOS boot too, instead of starting from the boot snapshot\n",
+                 argv[0]);
+    return 1;
+  }
+
+  logging::init();
+
+  const fs::path bios_path = argv[1];
+  const fs::path game_path = argv[2];
+  const auto frame_count = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 600;
+  const bool cold_boot = (argc > 4 && std::strcmp(argv[4], "cold") == 0);
+
+  auto extension = game_path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](char c) { return static_cast<char>(std::tolower(c)); });
+  const bool is_exe = extension == ".exe" || extension == ".psx";
+
+  emulator::LockstepChecker checker(bios_path, is_exe ? game_path : fs::path(),
+                                    is_exe ? fs::path() : game_path, emulator::CpuEngine::Recompiler,
+                                    !cold_boot);
+
+  for (unsigned long frame = 0; frame < frame_count; ++frame) {
+    if (!checker.run_frame()) {
+      std::printf("Frame %lu: %s", frame, checker.divergence_report().c_str());
+      return 1;
+    }
+  }
+
+  std::printf("No divergence in %lu frames (%llu blocks)\n", frame_count,
+              static_cast<unsigned long long>(checker.blocks_checked()));
+  return 0;
+}
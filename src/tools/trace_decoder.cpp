@@ -0,0 +1,60 @@
+// Prints a CPU trace saved by the emulator (see cpu/trace.hpp), one instruction per line
+
+#include <cpu/cpu.hpp>
+#include <cpu/instruction.hpp>
+#include <cpu/trace.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+s32 main(s32 argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "Usage: %s <trace file> [last N instructions]\n", argv[0]);
+    return 1;
+  }
+
+  std::ifstream ifs(argv[1], std::ios::binary);
+  if (!ifs) {
+    std::fprintf(stderr, "Couldn't open %s\n", argv[1]);
+    return 1;
+  }
+
+  cpu::TraceFileHeader header{};
+  ifs.read((char*)&header, sizeof(header));
+
+  if (!ifs || std::memcmp(header.magic, cpu::TRACE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != cpu::TRACE_FILE_VERSION) {
+    std::fprintf(stderr, "%s is not a supported trace file\n", argv[1]);
+    return 1;
+  }
+
+  std::vector<cpu::TraceEntry> entries(header.entry_count);
+  ifs.read((char*)entries.data(), entries.size() * sizeof(cpu::TraceEntry));
+  entries.resize(ifs.gcount() / sizeof(cpu::TraceEntry));  // Tolerate truncated files
+
+  size_t first = 0;
+  if (argc > 2) {
+    const auto last_n = std::strtoull(argv[2], nullptr, 10);
+    if (last_n < entries.size())
+      first = entries.size() - last_n;
+  }
+
+  for (size_t idx = first; idx < entries.size(); ++idx) {
+    const auto& entry = entries[idx];
+    const cpu::Instruction instr(entry.word);
+
+    std::printf("[%08X]: %08X %-28s", entry.pc, entry.word, instr.disassemble().c_str());
+
+    if (header.has_regs) {
+      for (size_t reg = 0; reg < entry.reg_index.size(); ++reg)
+        if (entry.reg_index[reg] != 0)
+          std::printf(" %s=%08X", cpu::register_to_str(entry.reg_index[reg]), entry.reg_value[reg]);
+    }
+    std::printf("\n");
+  }
+
+  return 0;
+}
@@ -11,7 +11,6 @@
 
 namespace logging {
 
-std::shared_ptr<spdlog::logger> g_cpu_logger;
 std::shared_ptr<spdlog::logger> g_gte_logger;
 std::shared_ptr<spdlog::logger> g_cdrom_logger;
 std::shared_ptr<spdlog::logger> g_joypad_logger;
@@ -19,7 +18,6 @@ std::shared_ptr<spdlog::logger> g_joypad_logger;
 static constexpr auto ENABLE_FILE_LOGGING = false;
 
 static constexpr auto LOG_FILENAME = "pctation.log";
-static constexpr auto LOG_CPU_FILENAME = "pctation_cpu.log";
 
 static constexpr auto DEFAULT_LOG_PATTERN = "%^[--%L--] %16s:%-3# %v%$";
 
@@ -28,8 +26,6 @@ void init() {
   spdlog::sink_ptr cmd_sink = std::make_shared<spdlog::sinks::stdout_color_sink_st>();
   spdlog::sink_ptr file_sink_main =
       std::make_shared<spdlog::sinks::basic_file_sink_st>(LOG_FILENAME, true);
-  spdlog::sink_ptr file_sink_cpu =
-      std::make_shared<spdlog::sinks::basic_file_sink_st>(LOG_CPU_FILENAME, true);
 
   std::initializer_list<spdlog::sink_ptr> main_sinks;
 
@@ -45,12 +41,6 @@ void init() {
   default_logger->set_pattern(DEFAULT_LOG_PATTERN);
   spdlog::register_logger(default_logger);
 
-  // Set up CPU logger
-  g_cpu_logger = std::make_shared<spdlog::logger>("cpu", file_sink_cpu);
-  g_cpu_logger->set_level(spdlog::level::trace);
-  g_cpu_logger->flush_on(spdlog::level::trace);
-  g_cpu_logger->set_pattern("%v");
-
   // Set up GTE logger
   g_gte_logger = std::make_shared<spdlog::logger>("gte", main_sinks);
   g_gte_logger->set_level(spdlog::level::warn);
@@ -12,9 +12,6 @@
 
 #define LOG_TODO() LOG_WARN(__FUNCTION__ ": TODO")
 
-#define LOG_TRACE_CPU(...) SPDLOG_LOGGER_TRACE(logging::g_cpu_logger, __VA_ARGS__)
-#define LOG_TRACE_CPU_NOFMT(msg) logging::g_cpu_logger->trace(msg)
-
 #define LOG_TRACE_GTE(...) SPDLOG_LOGGER_TRACE(logging::g_gte_logger, __VA_ARGS__)
 #define LOG_DEBUG_GTE(...) SPDLOG_LOGGER_DEBUG(logging::g_gte_logger, __VA_ARGS__)
 #define LOG_INFO_GTE(...) SPDLOG_LOGGER_INFO(logging::g_gte_logger, __VA_ARGS__)
@@ -38,7 +35,6 @@
 
 namespace logging {
 
-extern std::shared_ptr<spdlog::logger> g_cpu_logger;
 extern std::shared_ptr<spdlog::logger> g_gte_logger;
 extern std::shared_ptr<spdlog::logger> g_cdrom_logger;
 extern std::shared_ptr<spdlog::logger> g_joypad_logger;
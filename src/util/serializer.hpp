@@ -0,0 +1,67 @@
+#pragma once
+
+#include <util/types.hpp>
+
+#include <cstring>
+#include <type_traits>
+
+namespace util {
+
+// Saves state to, or restores it from, a buffer. Components list their state once in a
+// serialize(Serializer&) method, which works in both directions.
+class Serializer {
+ public:
+  enum class Mode {
+    Save,
+    Load,
+  };
+
+  // Appends to buf when saving, reads from its start when loading
+  explicit Serializer(Mode mode, buffer& buf) : m_mode(mode), m_buf(buf) {}
+
+  bool is_loading() const { return m_mode == Mode::Load; }
+  // False if a load ran past the end of the buffer, the restored state is garbage in that case
+  bool ok() const { return m_ok; }
+
+  // Plain data, copied as-is
+  template <typename T>
+  void value(T& val) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be copied as-is");
+    bytes(&val, sizeof(T));
+  }
+
+  // Containers of plain data (std::vector, std::deque), along with their size
+  template <typename Container>
+  void container(Container& c) {
+    u32 size = static_cast<u32>(c.size());
+    value(size);
+
+    if (is_loading())
+      c.resize(size);
+    for (auto& elem : c)
+      value(elem);
+  }
+
+  void bytes(void* data, size_t size) {
+    if (m_mode == Mode::Save) {
+      const auto src = static_cast<const byte*>(data);
+      m_buf.insert(m_buf.end(), src, src + size);
+      return;
+    }
+
+    if (!m_ok || m_pos + size > m_buf.size()) {
+      m_ok = false;
+      return;
+    }
+    std::memcpy(data, m_buf.data() + m_pos, size);
+    m_pos += size;
+  }
+
+ private:
+  Mode m_mode;
+  buffer& m_buf;
+  size_t m_pos{};
+  bool m_ok{ true };
+};
+
+}  // namespace util